@@ -0,0 +1,85 @@
+#include "array.h"
+
+#include <string.h>
+
+#include "memory.h"
+
+size_t cw_array_element_size(cwArrayType type)
+{
+    switch (type)
+    {
+    case ARRAY_INT32:   return sizeof(int32_t);
+    case ARRAY_FLOAT32: return sizeof(float);
+    case ARRAY_FLOAT64: return sizeof(double);
+    }
+    return 0;
+}
+
+const char* cw_array_type_name(cwArrayType type)
+{
+    switch (type)
+    {
+    case ARRAY_INT32:   return "int32";
+    case ARRAY_FLOAT32: return "float32";
+    case ARRAY_FLOAT64: return "float64";
+    }
+    return "";
+}
+
+static cwArray* cw_array_alloc(cwObject** objects, uint8_t depth, cwArrayType type, uint32_t cap)
+{
+    cwArray* array;
+    if (objects)
+    {
+        array = (cwArray*)cw_object_alloc(objects, sizeof(cwArray), OBJ_ARRAY);
+    }
+    else
+    {
+        array = cw_reallocate(NULL, 0, sizeof(cwArray));
+        array->obj.type = OBJ_ARRAY;
+        array->obj.frozen = false;
+        array->obj.next = NULL;
+    }
+    array->obj.depth = depth;
+
+    array->type = type;
+    array->data = cap ? cw_reallocate(NULL, 0, cw_array_element_size(type) * cap) : NULL;
+    array->len = 0;
+    array->cap = cap;
+    return array;
+}
+
+cwArray* cw_array_new(cwObject** objects, uint8_t depth, cwArrayType type, uint32_t len)
+{
+    cwArray* array = cw_array_alloc(objects, depth, type, len);
+    if (len) memset(array->data, 0, cw_array_element_size(type) * len);
+    array->len = len;
+    return array;
+}
+
+void cw_array_free(cwArray* array)
+{
+    cw_reallocate(array->data, cw_array_element_size(array->type) * array->cap, 0);
+    cw_reallocate(array, sizeof(cwArray), 0);
+}
+
+cwArray* cw_array_copy(cwObject** objects, uint8_t depth, const cwArray* array)
+{
+    cwArray* copy = cw_array_alloc(objects, depth, array->type, array->len);
+    if (array->len) memcpy(copy->data, array->data, cw_array_element_size(array->type) * array->len);
+    copy->len = array->len;
+    return copy;
+}
+
+void cw_array_push(cwArray* array, cwValue value)
+{
+    /* the capacity doubles, so pushing is amortized constant time */
+    if (array->len == array->cap)
+    {
+        size_t size = cw_array_element_size(array->type);
+        uint32_t cap = CW_GROW_CAPACITY(array->cap);
+        array->data = cw_reallocate(array->data, size * array->cap, size * cap);
+        array->cap = cap;
+    }
+    cw_array_set(array, array->len++, value);
+}
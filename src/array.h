@@ -0,0 +1,72 @@
+#ifndef CLOCKWORK_ARRAY_H
+#define CLOCKWORK_ARRAY_H
+
+#include "common.h"
+
+typedef enum
+{
+    ARRAY_INT32,
+    ARRAY_FLOAT32,
+    ARRAY_FLOAT64
+} cwArrayType;
+
+/*
+ * Typed arrays store their elements unboxed in one contiguous block instead
+ * of as values, so an array of floats takes a quarter of the memory and is
+ * walked without chasing anything. Elements are converted to values when
+ * they are read; float64 elements keep their precision in the array but
+ * are read as float like every other float of the VM.
+ */
+typedef struct
+{
+    cwObject obj;
+    cwArrayType type;
+    void* data;
+    uint32_t len;
+    uint32_t cap;
+} cwArray;
+
+#define IS_ARRAY(value) cw_is_obj_type(value, OBJ_ARRAY)
+#define AS_ARRAY(value) ((cwArray*)AS_OBJECT(value))
+
+/* elements are zeroed, the depth is the fork depth of the runtime that owns objects */
+cwArray* cw_array_new(cwObject** objects, uint8_t depth, cwArrayType type, uint32_t len);
+void     cw_array_free(cwArray* array);
+
+/* the copy is linked into objects, which may be NULL for a detached copy */
+cwArray* cw_array_copy(cwObject** objects, uint8_t depth, const cwArray* array);
+
+void cw_array_push(cwArray* array, cwValue value);
+
+size_t      cw_array_element_size(cwArrayType type);
+const char* cw_array_type_name(cwArrayType type);
+
+/*
+ * Element access without bounds checks. Callers check the index once with
+ * cw_array_in_bounds, for a whole range of indices where they can, and the
+ * value has to be a number.
+ */
+static inline bool cw_array_in_bounds(const cwArray* array, int32_t index) { return (uint32_t)index < array->len; }
+
+static inline cwValue cw_array_get(const cwArray* array, uint32_t index)
+{
+    switch (array->type)
+    {
+    case ARRAY_INT32:   return MAKE_INT(((int32_t*)array->data)[index]);
+    case ARRAY_FLOAT32: return MAKE_FLOAT(((float*)array->data)[index]);
+    case ARRAY_FLOAT64: return MAKE_FLOAT((float)((double*)array->data)[index]);
+    }
+    return MAKE_NULL();
+}
+
+static inline void cw_array_set(cwArray* array, uint32_t index, cwValue value)
+{
+    switch (array->type)
+    {
+    case ARRAY_INT32:   ((int32_t*)array->data)[index] = AS_INT(value); break;
+    case ARRAY_FLOAT32: ((float*)array->data)[index] = AS_FLOAT(value); break;
+    case ARRAY_FLOAT64: ((double*)array->data)[index] = AS_FLOAT(value); break;
+    }
+}
+
+#endif /* !CLOCKWORK_ARRAY_H */
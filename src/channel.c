@@ -0,0 +1,299 @@
+#include "channel.h"
+
+#include <string.h>
+
+#include "array.h"
+#include "debug.h"
+#include "map.h"
+#include "memory.h"
+#include "record.h"
+#include "runtime.h"
+
+cwChannel* cw_channel_new(cwEngine* engine, size_t capacity)
+{
+    size_t size = 1;
+    while (size < capacity) size <<= 1;
+
+    /* the engine's objects are shared by all of its runtimes */
+    cw_mutex_lock(&engine->lock);
+    cwChannel* channel = (cwChannel*)cw_object_alloc(&engine->objects, sizeof(cwChannel), OBJ_CHANNEL);
+    cw_mutex_unlock(&engine->lock);
+
+    channel->cells = CW_ALLOCATE(cwChannelCell, size);
+    channel->mask = size - 1;
+    for (size_t i = 0; i < size; ++i)
+    {
+        channel->cells[i].sequence = i;
+        channel->cells[i].value = MAKE_NULL();
+        channel->cells[i].copied = false;
+    }
+
+    channel->send_pos = 0;
+    channel->recv_pos = 0;
+    return channel;
+}
+
+/* values inside of a copy are copies too unless they are shared by the engine */
+static bool cw_channel_is_copy(cwValue value)
+{
+    return !cw_is_frozen(value) && !IS_CHANNEL(value);
+}
+
+static void cw_channel_release(cwValue value)
+{
+    if (!cw_channel_is_copy(value)) return;
+
+    switch (OBJECT_TYPE(value))
+    {
+    case OBJ_ARRAY:
+        cw_array_free(AS_ARRAY(value));
+        return;
+    case OBJ_MAP:
+    {
+        uint32_t position = 0;
+        cwString* key;
+        cwValue element;
+        while (cw_map_next(AS_MAP(value), &position, &key, &element))
+        {
+            cw_channel_release(MAKE_OBJECT(key));
+            cw_channel_release(element);
+        }
+        cw_map_free(AS_MAP(value));
+        return;
+    }
+    case OBJ_RECORD:
+    {
+        cwRecord* record = AS_RECORD(value);
+        for (int i = 0; i < record->shape->field_count; ++i) cw_channel_release(record->fields[i]);
+        cw_record_free(record);
+        return;
+    }
+    default:
+    {
+        cwString* str = AS_STRING(value);
+        CW_FREE_ARRAY(char, str->raw, str->len + 1);
+        cw_reallocate(str, sizeof(cwString), 0);
+        return;
+    }
+    }
+}
+
+void cw_channel_free(cwChannel* channel)
+{
+    /* copies that were sent but never received */
+    for (size_t pos = channel->recv_pos; pos != channel->send_pos; ++pos)
+    {
+        cwChannelCell* cell = &channel->cells[pos & channel->mask];
+        if (cell->copied) cw_channel_release(cell->value);
+    }
+
+    CW_FREE_ARRAY(cwChannelCell, channel->cells, channel->mask + 1);
+    cw_reallocate(channel, sizeof(cwChannel), 0);
+}
+
+/* --------------------------| copying |------------------------------------------------- */
+/* detaches a copy of values that belong to the runtime of the sender, maps and records deeply */
+static bool cw_channel_copy(cwRuntime* cw, cwValue value, cwValue* packed, int depth)
+{
+    *packed = value;
+    if (cw_is_frozen(value)) return true;
+
+    if (depth >= CW_COPY_DEPTH_MAX)
+    {
+        cw_runtime_error(cw, "Can't send values nested this deep.");
+        return false;
+    }
+
+    /* copies are not linked into any heap until they are received */
+    cwObject* detached = NULL;
+    switch (OBJECT_TYPE(value))
+    {
+    case OBJ_STRING:
+    {
+        cwString* str = AS_STRING(value);
+        cwString* copy = cw_reallocate(NULL, 0, sizeof(cwString));
+        copy->obj.type = OBJ_STRING;
+        copy->obj.frozen = false;
+        copy->obj.next = NULL;
+        copy->raw = cw_reallocate(NULL, 0, str->len + 1);
+        memcpy(copy->raw, str->raw, str->len + 1);
+        copy->len = str->len;
+        copy->hash = str->hash;
+
+        *packed = MAKE_OBJECT(copy);
+        return true;
+    }
+    case OBJ_ARRAY:
+        *packed = MAKE_OBJECT(cw_array_copy(NULL, 0, AS_ARRAY(value)));
+        return true;
+    case OBJ_MAP:
+    {
+        cwMap* map = cw_map_new(&detached, 0);
+        map->obj.next = NULL;
+
+        uint32_t position = 0;
+        cwString* key;
+        cwValue element;
+        while (cw_map_next(AS_MAP(value), &position, &key, &element))
+        {
+            cwValue packed_key, packed_element;
+            cw_channel_copy(cw, MAKE_OBJECT(key), &packed_key, depth + 1);
+            if (!cw_channel_copy(cw, element, &packed_element, depth + 1))
+            {
+                cw_channel_release(packed_key);
+                cw_channel_release(MAKE_OBJECT(map));
+                return false;
+            }
+            cw_map_set(map, AS_STRING(packed_key), packed_element, NULL);
+        }
+
+        *packed = MAKE_OBJECT(map);
+        return true;
+    }
+    case OBJ_RECORD:
+    {
+        cwRecord* source = AS_RECORD(value);
+        cwRecord* record = cw_record_new(&detached, 0, source->shape);
+        record->obj.next = NULL;
+
+        for (int i = 0; i < source->shape->field_count; ++i)
+        {
+            if (!cw_channel_copy(cw, source->fields[i], &record->fields[i], depth + 1))
+            {
+                cw_channel_release(MAKE_OBJECT(record));
+                return false;
+            }
+        }
+
+        *packed = MAKE_OBJECT(record);
+        return true;
+    }
+    case OBJ_CHANNEL:
+        return true;
+    default:
+        cw_runtime_error(cw, "Can't send a value that belongs to a runtime.");
+        return false;
+    }
+}
+
+static bool cw_channel_pack(cwRuntime* cw, cwValue value, cwValue* packed, bool* copied)
+{
+    *copied = cw_channel_is_copy(value);
+    return cw_channel_copy(cw, value, packed, 0);
+}
+
+/* moves a detached copy into the heap of the receiver */
+static cwValue cw_channel_move(cwRuntime* cw, cwValue value)
+{
+    if (!cw_channel_is_copy(value)) return value;
+
+    switch (OBJECT_TYPE(value))
+    {
+    case OBJ_ARRAY:
+        break;
+    case OBJ_MAP:
+    {
+        /* keys keep their hash, so the received keys take the slots of the copies */
+        Table* table = &AS_MAP(value)->table;
+        for (uint32_t i = 0; i < table->capacity; ++i)
+        {
+            if (!table->entries[i].key) continue;
+            table->entries[i].key = AS_STRING(cw_channel_move(cw, MAKE_OBJECT(table->entries[i].key)));
+            table->entries[i].val = cw_channel_move(cw, table->entries[i].val);
+        }
+        break;
+    }
+    case OBJ_RECORD:
+    {
+        cwRecord* record = AS_RECORD(value);
+        for (int i = 0; i < record->shape->field_count; ++i)
+        {
+            record->fields[i] = cw_channel_move(cw, record->fields[i]);
+        }
+        break;
+    }
+    default:
+    {
+        cwString* copy = AS_STRING(value);
+        cwString* str = cw_str_take(cw, copy->raw, copy->len);
+        cw_reallocate(copy, sizeof(cwString), 0);
+        return MAKE_OBJECT(str);
+    }
+    }
+
+    cwObject* object = AS_OBJECT(value);
+    object->depth = cw->depth;
+    object->next = cw->objects;
+    cw->objects = object;
+    return value;
+}
+
+static cwValue cw_channel_unpack(cwRuntime* cw, cwValue value, bool copied)
+{
+    return copied ? cw_channel_move(cw, value) : value;
+}
+
+/* --------------------------| ring |---------------------------------------------------- */
+bool cw_channel_try_send(cwRuntime* cw, cwChannel* channel, cwValue value, bool* sent)
+{
+    *sent = false;
+
+    cwValue packed;
+    bool copied;
+    if (!cw_channel_pack(cw, value, &packed, &copied)) return false;
+
+    cwChannelCell* cell;
+    size_t pos = CW_ATOMIC_LOAD_RELAXED(&channel->send_pos);
+    while (true)
+    {
+        cell = &channel->cells[pos & channel->mask];
+        intptr_t diff = (intptr_t)CW_ATOMIC_LOAD(&cell->sequence) - (intptr_t)pos;
+        if (diff == 0)
+        {
+            if (CW_ATOMIC_CAS(&channel->send_pos, &pos, pos + 1)) break;
+        }
+        else if (diff < 0)
+        {
+            /* full */
+            if (copied) cw_channel_release(packed);
+            return true;
+        }
+        else
+        {
+            pos = CW_ATOMIC_LOAD_RELAXED(&channel->send_pos);
+        }
+    }
+
+    cell->value = packed;
+    cell->copied = copied;
+    CW_ATOMIC_STORE(&cell->sequence, pos + 1);
+    *sent = true;
+    return true;
+}
+
+bool cw_channel_try_recv(cwRuntime* cw, cwChannel* channel, cwValue* value)
+{
+    cwChannelCell* cell;
+    size_t pos = CW_ATOMIC_LOAD_RELAXED(&channel->recv_pos);
+    while (true)
+    {
+        cell = &channel->cells[pos & channel->mask];
+        intptr_t diff = (intptr_t)CW_ATOMIC_LOAD(&cell->sequence) - (intptr_t)(pos + 1);
+        if (diff == 0)
+        {
+            if (CW_ATOMIC_CAS(&channel->recv_pos, &pos, pos + 1)) break;
+        }
+        else if (diff < 0)
+        {
+            return false; /* empty */
+        }
+        else
+        {
+            pos = CW_ATOMIC_LOAD_RELAXED(&channel->recv_pos);
+        }
+    }
+
+    *value = cw_channel_unpack(cw, cell->value, cell->copied);
+    CW_ATOMIC_STORE(&cell->sequence, pos + channel->mask + 1);
+    return true;
+}
@@ -0,0 +1,56 @@
+#ifndef CLOCKWORK_CHANNEL_H
+#define CLOCKWORK_CHANNEL_H
+
+#include "common.h"
+
+#define CW_CHANNEL_CAPACITY_MAX 65536
+#define CW_CACHE_LINE 64
+
+/*
+ * A channel passes values between runtimes that may run on different
+ * threads. It is a bounded lock-free MPMC ring buffer (Vyukov): every cell
+ * carries a sequence number that tells senders and receivers whose turn it
+ * is, so any number of them only contend on the position they claim.
+ *
+ * Channels belong to the engine and can be sent themselves. Frozen values
+ * (numbers, literals, functions, see cw_freeze) are passed as they are,
+ * strings and arrays of a runtime are copied out of the sender's heap and
+ * into the receiver's, so runtimes never share mutable state.
+ */
+typedef struct
+{
+    size_t sequence;
+    cwValue value;
+    bool copied;    /* the value is a detached copy of a runtime string or array */
+} cwChannelCell;
+
+typedef struct
+{
+    cwObject obj;
+    cwChannelCell* cells;
+    size_t mask;
+
+    /* senders and receivers claim positions on different cache lines */
+    char pad0[CW_CACHE_LINE];
+    size_t send_pos;
+    char pad1[CW_CACHE_LINE];
+    size_t recv_pos;
+    char pad2[CW_CACHE_LINE];
+} cwChannel;
+
+#define IS_CHANNEL(value) cw_is_obj_type(value, OBJ_CHANNEL)
+#define AS_CHANNEL(value) ((cwChannel*)AS_OBJECT(value))
+
+/* the capacity is rounded up to a power of two */
+cwChannel* cw_channel_new(cwEngine* engine, size_t capacity);
+void       cw_channel_free(cwChannel* channel);
+
+/*
+ * Non-blocking operations. Sending reports in sent whether there was room and
+ * returns false with an error for values that can not leave their runtime.
+ * Receiving returns false if the channel is empty.
+ */
+bool cw_channel_try_send(cwRuntime* cw, cwChannel* channel, cwValue value, bool* sent);
+bool cw_channel_try_recv(cwRuntime* cw, cwChannel* channel, cwValue* value);
+
+#endif /* !CLOCKWORK_CHANNEL_H */
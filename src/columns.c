@@ -0,0 +1,102 @@
+#include "columns.h"
+
+#include "memory.h"
+
+/* --------------------------| columns |------------------------------------------------- */
+static size_t cw_columns_size(const cwShape* shape)
+{
+    return sizeof(cwColumns) + sizeof(cwArray*) * shape->field_count;
+}
+
+cwColumns* cw_columns_new(cwObject** objects, uint8_t depth, cwShape* shape, cwArrayType type, uint32_t len)
+{
+    cwColumns* columns = (cwColumns*)cw_object_alloc(objects, cw_columns_size(shape), OBJ_COLUMNS);
+    columns->obj.depth = depth;
+    columns->shape = shape;
+    for (int i = 0; i < shape->field_count; ++i) columns->columns[i] = cw_array_new(objects, depth, type, len);
+    return columns;
+}
+
+void cw_columns_free(cwColumns* columns)
+{
+    cw_reallocate(columns, cw_columns_size(columns->shape), 0);
+}
+
+uint32_t cw_columns_len(const cwColumns* columns)
+{
+    if (columns->shape->field_count == 0) return 0;
+
+    uint32_t len = columns->columns[0]->len;
+    for (int i = 1; i < columns->shape->field_count; ++i)
+    {
+        if (columns->columns[i]->len < len) len = columns->columns[i]->len;
+    }
+    return len;
+}
+
+static bool cw_columns_accept(const cwColumns* columns, const cwRecord* record)
+{
+    if (record->shape != columns->shape) return false;
+
+    for (int i = 0; i < record->shape->field_count; ++i)
+    {
+        if (!IS_NUMBER(record->fields[i])) return false;
+    }
+    return true;
+}
+
+bool cw_columns_push(cwColumns* columns, const cwRecord* record)
+{
+    if (!cw_columns_accept(columns, record)) return false;
+
+    /* columns that were pushed to directly stay longer */
+    uint32_t len = cw_columns_len(columns);
+    for (int i = 0; i < record->shape->field_count; ++i)
+    {
+        cwArray* column = columns->columns[i];
+        if (column->len == len) cw_array_push(column, record->fields[i]);
+        else                    cw_array_set(column, len, record->fields[i]);
+    }
+    return true;
+}
+
+bool cw_columns_store(cwColumns* columns, uint32_t index, const cwRecord* record)
+{
+    if (!cw_columns_accept(columns, record) || index >= cw_columns_len(columns)) return false;
+
+    for (int i = 0; i < record->shape->field_count; ++i) cw_array_set(columns->columns[i], index, record->fields[i]);
+    return true;
+}
+
+/* --------------------------| rows |---------------------------------------------------- */
+cwRow* cw_row_new(cwObject** objects, uint8_t depth, cwColumns* columns, uint32_t index)
+{
+    cwRow* row = (cwRow*)cw_object_alloc(objects, sizeof(cwRow), OBJ_ROW);
+    row->obj.depth = depth;
+    row->columns = columns;
+    row->index = index;
+    return row;
+}
+
+void cw_row_free(cwRow* row)
+{
+    cw_reallocate(row, sizeof(cwRow), 0);
+}
+
+bool cw_row_get(const cwRow* row, int slot, cwValue* value)
+{
+    const cwArray* column = row->columns->columns[slot];
+    if (row->index >= column->len) return false;
+
+    *value = cw_array_get(column, row->index);
+    return true;
+}
+
+bool cw_row_set(cwRow* row, int slot, cwValue value)
+{
+    cwArray* column = row->columns->columns[slot];
+    if (row->index >= column->len || !IS_NUMBER(value)) return false;
+
+    cw_array_set(column, row->index, value);
+    return true;
+}
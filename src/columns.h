@@ -0,0 +1,56 @@
+#ifndef CLOCKWORK_COLUMNS_H
+#define CLOCKWORK_COLUMNS_H
+
+#include "array.h"
+#include "record.h"
+
+/*
+ * A collection of records stored as columns: every field of the shape gets
+ * a typed array of its own, so a loop over one field walks one contiguous
+ * block of unboxed numbers and the bulk operations of arrays work on whole
+ * columns. The columns are ordinary arrays of the runtime. Pushing to one
+ * of them directly makes it longer than the others, the collection is as
+ * long as its shortest column.
+ */
+typedef struct
+{
+    cwObject obj;
+    cwShape* shape;
+    cwArray* columns[];     /* by slot */
+} cwColumns;
+
+/*
+ * A row view reads and writes the fields of one row in the columns. A loop
+ * over columns moves one view from row to row instead of creating a view
+ * per row, so a view kept from an earlier iteration follows the loop.
+ */
+typedef struct
+{
+    cwObject obj;
+    cwColumns* columns;
+    uint32_t index;
+} cwRow;
+
+#define IS_COLUMNS(value) cw_is_obj_type(value, OBJ_COLUMNS)
+#define AS_COLUMNS(value) ((cwColumns*)AS_OBJECT(value))
+#define IS_ROW(value)     cw_is_obj_type(value, OBJ_ROW)
+#define AS_ROW(value)     ((cwRow*)AS_OBJECT(value))
+
+/* the columns are linked into objects as well, elements are zeroed */
+cwColumns* cw_columns_new(cwObject** objects, uint8_t depth, cwShape* shape, cwArrayType type, uint32_t len);
+void       cw_columns_free(cwColumns* columns);
+
+uint32_t cw_columns_len(const cwColumns* columns);
+
+/* fields of the record have to be numbers */
+bool cw_columns_push(cwColumns* columns, const cwRecord* record);
+bool cw_columns_store(cwColumns* columns, uint32_t index, const cwRecord* record);
+
+cwRow* cw_row_new(cwObject** objects, uint8_t depth, cwColumns* columns, uint32_t index);
+void   cw_row_free(cwRow* row);
+
+/* false if the row is out of bounds of the column of the slot */
+bool cw_row_get(const cwRow* row, int slot, cwValue* value);
+bool cw_row_set(cwRow* row, int slot, cwValue value);
+
+#endif /* !CLOCKWORK_COLUMNS_H */
@@ -1,7 +1,14 @@
 #include "common.h"
 
 #include "memory.h"
+#include "debug.h"
 #include "runtime.h"
+#include "intern.h"
+#include "channel.h"
+#include "array.h"
+#include "map.h"
+#include "record.h"
+#include "columns.h"
 
 #include <string.h>
 #include <math.h>
@@ -23,7 +30,10 @@ bool cw_values_equal(cwValue a, cwValue b)
         case VAL_BOOL:   return AS_BOOL(a) == AS_BOOL(b);
         case VAL_INT:    return AS_INT(a) == AS_INT(b);
         case VAL_FLOAT:  return AS_FLOAT(a) == AS_FLOAT(b);
-        case VAL_OBJECT: return AS_OBJECT(a) == AS_OBJECT(b);
+        case VAL_OBJECT:
+            /* a runtime string can duplicate a literal that was compiled after it */
+            if (IS_STRING(a) && IS_STRING(b)) return cw_str_equal(AS_STRING(a), AS_STRING(b));
+            return AS_OBJECT(a) == AS_OBJECT(b);
         }
     }
 
@@ -112,6 +122,10 @@ void cw_chunk_init(cwChunk* chunk)
     chunk->constants = NULL;
     chunk->const_len = 0;
     chunk->const_cap = 0;
+    chunk->caches = NULL;
+    chunk->cache_len = 0;
+    chunk->sites = NULL;
+    chunk->site_len = 0;
 }
 
 void cw_chunk_free(cwChunk* chunk)
@@ -119,16 +133,28 @@ void cw_chunk_free(cwChunk* chunk)
     CW_FREE_ARRAY(uint8_t, chunk->bytes, chunk->cap);
     CW_FREE_ARRAY(int, chunk->lines, chunk->cap);
     CW_FREE_ARRAY(cwValue, chunk->constants, chunk->const_cap);
+    CW_FREE_ARRAY(uint32_t, chunk->caches, chunk->cache_len);
+    CW_FREE_ARRAY(cwCallSite, chunk->sites, chunk->site_len);
     cw_chunk_init(chunk);
 }
 
+void cw_call_site_init(cwCallSite* site)
+{
+    for (int i = 0; i < CW_CALL_SITE_ENTRIES; ++i) site->entries[i] = UINT32_MAX;
+    site->hits = 0;
+    site->misses = 0;
+    site->megamorphic = 0;
+}
+
 /* --------------------------| objects |------------------------------------------------- */
-static cwObject* cw_object_alloc(cwRuntime* cw, size_t size, cwObjectType type)
+cwObject* cw_object_alloc(cwObject** objects, size_t size, cwObjectType type)
 {
     cwObject* object = cw_reallocate(NULL, 0, size);
     object->type = type;
-    object->next = cw->objects;
-    cw->objects = object;
+    object->frozen = false;
+    object->depth = 0;
+    object->next = *objects;
+    *objects = object;
     return object;
 }
 
@@ -143,12 +169,52 @@ static void cw_object_free(cwObject* object)
         cw_reallocate(object, sizeof(cwString), 0);
         break;
     }
+    case OBJ_FUNCTION:
+    {
+        cwFunction* function = (cwFunction*)object;
+        cw_chunk_free(&function->chunk);
+        CW_FREE_ARRAY(char, function->source, function->source_len + 1);
+        cw_reallocate(object, sizeof(cwFunction), 0);
+        break;
+    }
+    case OBJ_NATIVE:
+        cw_reallocate(object, sizeof(cwNative), 0);
+        break;
+    case OBJ_COROUTINE:
+    {
+        cwCoroutine* coroutine = (cwCoroutine*)object;
+        CW_FREE_ARRAY(cwValue, coroutine->context.stack, coroutine->context.stack_cap);
+        CW_FREE_ARRAY(cwCallFrame, coroutine->context.frames, coroutine->context.frame_cap);
+        cw_reallocate(object, sizeof(cwCoroutine), 0);
+        break;
+    }
+    case OBJ_CHANNEL:
+        cw_channel_free((cwChannel*)object);
+        break;
+    case OBJ_ARRAY:
+        cw_array_free((cwArray*)object);
+        break;
+    case OBJ_MAP:
+        cw_map_free((cwMap*)object);
+        break;
+    case OBJ_SHAPE:
+        cw_shape_free((cwShape*)object);
+        break;
+    case OBJ_RECORD:
+        cw_record_free((cwRecord*)object);
+        break;
+    case OBJ_COLUMNS:
+        cw_columns_free((cwColumns*)object);
+        break;
+    case OBJ_ROW:
+        cw_row_free((cwRow*)object);
+        break;
     }
 }
 
-void cw_free_objects(cwRuntime* cw)
+void cw_free_objects(cwObject* objects)
 {
-    cwObject* object = cw->objects;
+    cwObject* object = objects;
     while (object != NULL)
     {
         cwObject* next = object->next;
@@ -157,42 +223,191 @@ void cw_free_objects(cwRuntime* cw)
     }
 }
 
+static bool cw_freeze_value(cwRuntime* cw, cwValue value, cwValue* frozen, int depth)
+{
+    *frozen = value;
+    if (cw_is_frozen(value)) return true;
+
+    if (depth >= CW_COPY_DEPTH_MAX)
+    {
+        cw_runtime_error(cw, "Can't freeze values nested this deep.");
+        return false;
+    }
+
+    switch (OBJECT_TYPE(value))
+    {
+    case OBJ_STRING:
+    {
+        /* frozen strings are literals, so they stay interned */
+        cwString* str = AS_STRING(value);
+        if (!cw->engine->atoms) cw_mutex_lock(&cw->engine->lock);
+        *frozen = MAKE_OBJECT(cw_str_intern(cw->engine, str->raw, str->len));
+        if (!cw->engine->atoms) cw_mutex_unlock(&cw->engine->lock);
+        return true;
+    }
+    case OBJ_ARRAY:
+    {
+        cw_mutex_lock(&cw->engine->lock);
+        cwArray* array = cw_array_copy(&cw->engine->objects, 0, AS_ARRAY(value));
+        array->obj.frozen = true;
+        cw_mutex_unlock(&cw->engine->lock);
+
+        *frozen = MAKE_OBJECT(array);
+        return true;
+    }
+    case OBJ_MAP:
+    {
+        /* copies are filled before anyone else can see them, only linking them takes the lock */
+        cw_mutex_lock(&cw->engine->lock);
+        cwMap* map = cw_map_new(&cw->engine->objects, 0);
+        cw_mutex_unlock(&cw->engine->lock);
+
+        uint32_t position = 0;
+        cwString* key;
+        cwValue element;
+        while (cw_map_next(AS_MAP(value), &position, &key, &element))
+        {
+            cwValue frozen_key, frozen_element;
+            if (!cw_freeze_value(cw, MAKE_OBJECT(key), &frozen_key, depth + 1))    return false;
+            if (!cw_freeze_value(cw, element, &frozen_element, depth + 1))          return false;
+            cw_map_set(map, AS_STRING(frozen_key), frozen_element, NULL);
+        }
+
+        map->obj.frozen = true;
+        *frozen = MAKE_OBJECT(map);
+        return true;
+    }
+    case OBJ_RECORD:
+    {
+        cwShape* shape = AS_RECORD(value)->shape;
+        cw_mutex_lock(&cw->engine->lock);
+        cwRecord* record = cw_record_new(&cw->engine->objects, 0, shape);
+        cw_mutex_unlock(&cw->engine->lock);
+
+        for (int i = 0; i < shape->field_count; ++i)
+        {
+            if (!cw_freeze_value(cw, AS_RECORD(value)->fields[i], &record->fields[i], depth + 1)) return false;
+        }
+
+        record->obj.frozen = true;
+        *frozen = MAKE_OBJECT(record);
+        return true;
+    }
+    case OBJ_CHANNEL:
+        /* channels are shared by the engine already */
+        return true;
+    default:
+        cw_runtime_error(cw, "Can't freeze a value that belongs to a runtime.");
+        return false;
+    }
+}
+
+bool cw_freeze(cwRuntime* cw, cwValue value, cwValue* frozen)
+{
+    return cw_freeze_value(cw, value, frozen, 0);
+}
+
+/* --------------------------| functions |----------------------------------------------- */
+cwFunction* cw_function_new(cwEngine* engine)
+{
+    cwFunction* function = (cwFunction*)cw_object_alloc(&engine->objects, sizeof(cwFunction), OBJ_FUNCTION);
+    function->obj.frozen = true;
+    function->name = NULL;
+    function->arity = 0;
+    function->source = NULL;
+    function->source_len = 0;
+    function->line = 0;
+    cw_chunk_init(&function->chunk);
+    return function;
+}
+
+cwNative* cw_native_new(cwEngine* engine, cwString* name, cwNativeFn fn, int arity)
+{
+    cwNative* native = (cwNative*)cw_object_alloc(&engine->objects, sizeof(cwNative), OBJ_NATIVE);
+    native->obj.frozen = true;
+    native->name = name;
+    native->fn = fn;
+    native->arity = arity;
+    return native;
+}
+
 /* --------------------------| strings |------------------------------------------------- */
-static cwString* cw_str_alloc(cwRuntime* cw, char* src, size_t len, uint32_t hash)
+static cwString* cw_str_alloc(Table* strings, cwObject** objects, char* src, size_t len, uint32_t hash)
 {
-    cwString* str = (cwString*)cw_object_alloc(cw, sizeof(cwString), OBJ_STRING);
+    cwString* str = (cwString*)cw_object_alloc(objects, sizeof(cwString), OBJ_STRING);
     str->raw = src;
     str->len = len;
     str->hash = hash;
 
-    cw_table_insert(&cw->strings, str, MAKE_NULL());
+    cw_table_insert(strings, str, MAKE_NULL());
 
     return str;
 }
 
+static char* cw_str_dup(const char* src, size_t len)
+{
+    char* raw = cw_reallocate(NULL, 0, len + 1);
+    memcpy(raw, src, len);
+    raw[len] = '\0';
+    return raw;
+}
+
+/* literals of the engine take precedence over strings created by the runtime or its parents */
+static cwString* cw_str_find(cwRuntime* cw, const char* src, size_t len, uint32_t hash)
+{
+    cwString* interned = NULL;
+    if (cw->engine->atoms)
+    {
+        interned = cw_intern_find(cw->engine->atoms, src, len, hash);
+    }
+    else
+    {
+        /* the engine table can grow while another thread compiles */
+        cw_mutex_lock(&cw->engine->lock);
+        interned = cw_table_find_key(&cw->engine->strings, src, len, hash);
+        cw_mutex_unlock(&cw->engine->lock);
+    }
+
+    for (const cwRuntime* rt = cw; rt && !interned; rt = rt->parent)
+    {
+        interned = cw_table_find_key(&rt->strings, src, len, hash);
+    }
+    return interned;
+}
+
+cwString* cw_str_intern(cwEngine* engine, const char* src, size_t len)
+{
+    uint32_t hash = cw_hash_str(src, len);
+    if (engine->atoms) return cw_intern_insert(engine->atoms, src, len, hash);
+
+    cwString* interned = cw_table_find_key(&engine->strings, src, len, hash);
+    if (interned != NULL) return interned;
+
+    cwString* str = cw_str_alloc(&engine->strings, &engine->objects, cw_str_dup(src, len), len, hash);
+    str->obj.frozen = true;
+    return str;
+}
+
 cwString* cw_str_take(cwRuntime* cw, char* src, size_t len)
 {
     uint32_t hash = cw_hash_str(src, len);
-    cwString* interned = cw_table_find_key(&cw->strings, src, len, hash);
+    cwString* interned = cw_str_find(cw, src, len, hash);
     if (interned != NULL)
     {
         CW_FREE_ARRAY(char, src, len + 1);
         return interned;
     } 
 
-    return cw_str_alloc(cw, src, len, hash);
+    return cw_str_alloc(&cw->strings, &cw->objects, src, len, hash);
 }
 
 cwString* cw_str_copy(cwRuntime* cw, const char* src, size_t len)
 {
     uint32_t hash = cw_hash_str(src, len);
-    cwString* interned = cw_table_find_key(&cw->strings, src, len, hash);
+    cwString* interned = cw_str_find(cw, src, len, hash);
     if (interned != NULL) return interned;
 
-    char* raw = cw_reallocate(NULL, 0, len + 1);
-    memcpy(raw, src, len);
-    raw[len] = '\0';
-    return cw_str_alloc(cw, raw, len, hash);
+    return cw_str_alloc(&cw->strings, &cw->objects, cw_str_dup(src, len), len, hash);
 }
 
 cwString* cw_str_concat(cwRuntime* cw, cwString* a, cwString* b)
@@ -206,6 +421,11 @@ cwString* cw_str_concat(cwRuntime* cw, cwString* a, cwString* b)
     return cw_str_take(cw, raw, len);
 }
 
+bool cw_str_equal(const cwString* a, const cwString* b)
+{
+    return a == b || (a->hash == b->hash && a->len == b->len && memcmp(a->raw, b->raw, a->len) == 0);
+}
+
 uint32_t cw_hash_str(const char* str, size_t len)
 {
     uint32_t hash = 2166136261u;
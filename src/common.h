@@ -6,12 +6,20 @@
 #include <stdint.h>
 #include <stdbool.h>
 
+#include "thread.h"
+
+typedef struct cwEngine cwEngine;
 typedef struct cwRuntime cwRuntime;
+typedef struct cwScheduler cwScheduler;
+typedef struct cwParser cwParser;
+typedef struct cwCompiler cwCompiler;
 typedef struct cwToken cwToken;
 
 typedef struct cwObject cwObject;
 typedef struct cwString cwString;
 typedef struct cwFunction cwFunction;
+typedef struct cwNative cwNative;
+typedef struct cwCoroutine cwCoroutine;
 
 /* value */
 typedef enum
@@ -67,6 +75,22 @@ bool cw_is_falsey(cwValue val);
 bool cw_values_equal(cwValue a, cwValue b);
 
 /* chunk */
+#define CW_CALL_SITE_ENTRIES 4
+
+/*
+ * Polymorphic inline cache of a method call. Every entry packs the id of a
+ * shape and the index of its method, see cw_shape_dispatch. A site with all
+ * entries taken is megamorphic and uses the global method cache instead.
+ * The counters are statistics only and can miss updates from other threads.
+ */
+typedef struct
+{
+    uint32_t entries[CW_CALL_SITE_ENTRIES];
+    uint64_t hits;          /* found in the entries */
+    uint64_t misses;        /* looked up and added to the entries */
+    uint64_t megamorphic;   /* looked up in the global cache */
+} cwCallSite;
+
 typedef struct
 {
     /* byte code with line information */
@@ -79,8 +103,16 @@ typedef struct
     cwValue* constants;
     size_t const_len;
     size_t const_cap;
+
+    /* inline caches of instructions, written by every runtime that runs the chunk */
+    uint32_t* caches;
+    size_t cache_len;
+    cwCallSite* sites;
+    size_t site_len;
 } cwChunk;
 
+void cw_call_site_init(cwCallSite* site);
+
 void cw_chunk_init(cwChunk* chunk);
 void cw_chunk_free(cwChunk* chunk);
 
@@ -88,11 +120,23 @@ void cw_chunk_free(cwChunk* chunk);
 typedef enum
 {
     OBJ_STRING,
+    OBJ_FUNCTION,
+    OBJ_NATIVE,
+    OBJ_COROUTINE,
+    OBJ_CHANNEL,
+    OBJ_ARRAY,
+    OBJ_MAP,
+    OBJ_SHAPE,
+    OBJ_RECORD,
+    OBJ_COLUMNS,
+    OBJ_ROW,
 } cwObjectType;
 
 struct cwObject
 {
     cwObjectType type;
+    bool frozen;    /* immutable and owned by the engine, see cw_freeze */
+    uint8_t depth;  /* fork depth of the runtime a container was created in, see cw_check_write */
     cwObject* next;
 };
 
@@ -102,8 +146,31 @@ struct cwFunction
     cwString* name;
     cwChunk chunk;
     int arity;
+
+    /* source of a body that has not been compiled yet, starting at the parameters */
+    char* source;
+    size_t source_len;
+    int line;
+};
+
+cwFunction* cw_function_new(cwEngine* engine);
+
+/* natives report errors with cw_runtime_error and return false */
+typedef bool (*cwNativeFn)(cwRuntime* cw, int argc, cwValue* args, cwValue* result);
+
+struct cwNative
+{
+    cwObject obj;
+    cwString* name;
+    cwNativeFn fn;
+    int arity;  /* -1 for any number of arguments */
 };
 
+cwNative* cw_native_new(cwEngine* engine, cwString* name, cwNativeFn fn, int arity);
+
+/* the source is released once the chunk is published, see cw_compile_function */
+static inline bool cw_function_compiled(const cwFunction* function) { return CW_ATOMIC_LOAD(&function->source) == NULL; }
+
 static inline bool cw_is_obj_type(cwValue value, cwObjectType type) 
 { 
     return IS_OBJECT(value) && AS_OBJECT(value)->type == type;
@@ -111,11 +178,32 @@ static inline bool cw_is_obj_type(cwValue value, cwObjectType type)
 
 #define OBJECT_TYPE(value)  (AS_OBJECT(value)->type)
 #define IS_STRING(value)    cw_is_obj_type(value, OBJ_STRING)
+#define IS_FUNCTION(value)  cw_is_obj_type(value, OBJ_FUNCTION)
+#define IS_NATIVE(value)    cw_is_obj_type(value, OBJ_NATIVE)
+#define IS_COROUTINE(value) cw_is_obj_type(value, OBJ_COROUTINE)
 
 #define AS_STRING(value)    ((cwString*)AS_OBJECT(value))
+#define AS_FUNCTION(value)  ((cwFunction*)AS_OBJECT(value))
+#define AS_NATIVE(value)    ((cwNative*)AS_OBJECT(value))
+#define AS_COROUTINE(value) ((cwCoroutine*)AS_OBJECT(value))
 #define AS_RAWSTRING(value) (AS_STRING(value)->raw)
 
-void cw_free_objects(cwRuntime* cw);
+cwObject* cw_object_alloc(cwObject** objects, size_t size, cwObjectType type);
+void      cw_free_objects(cwObject* objects);
+
+/*
+ * Frozen values can never change and live as long as the engine, so every
+ * runtime of the engine can read them on any thread without locks and
+ * channels pass them without copying. Literals, functions and natives are
+ * frozen from the start. Freezing a value of a runtime copies it into the
+ * engine once, strings become literals, and the frozen copy is returned.
+ * Maps and records are frozen deeply, with their keys and values.
+ */
+#define CW_COPY_DEPTH_MAX 256   /* nesting of maps and records that are frozen or sent */
+
+static inline bool cw_is_frozen(cwValue value) { return !IS_OBJECT(value) || AS_OBJECT(value)->frozen; }
+
+bool cw_freeze(cwRuntime* cw, cwValue value, cwValue* frozen);
 
 /* strings */
 struct cwString
@@ -126,9 +214,13 @@ struct cwString
     uint32_t hash;
 };
 
+/* literals are interned by the engine and shared by all of its runtimes */
+cwString* cw_str_intern(cwEngine* engine, const char* src, size_t len);
+
 cwString* cw_str_take(cwRuntime* cw, char* src, size_t len);
 cwString* cw_str_copy(cwRuntime* cw, const char* src, size_t len);
 cwString* cw_str_concat(cwRuntime* cw, cwString* a, cwString* b);
+bool      cw_str_equal(const cwString* a, const cwString* b);
 
 cwString* cw_find_str(cwRuntime* cw, const char* str, size_t len);
 uint32_t cw_hash_str(const char* str, size_t len);
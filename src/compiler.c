@@ -9,32 +9,61 @@
 
 #include "debug.h"
 #include "memory.h"
+#include "record.h"
 #include "runtime.h"
 
 
 /* --------------------------| identifiers |--------------------------------------------- */
-uint8_t cw_make_constant(cwRuntime* cw, cwValue val)
+uint8_t cw_make_constant(cwCompiler* c, cwValue val)
 {
-    if (cw->chunk->const_cap < cw->chunk->const_len + 1)
+    if (c->chunk->const_cap < c->chunk->const_len + 1)
     {
-        int old_cap = cw->chunk->const_cap;
-        cw->chunk->const_cap = CW_GROW_CAPACITY(old_cap);
-        cw->chunk->constants = CW_GROW_ARRAY(cwValue, cw->chunk->constants, old_cap, cw->chunk->const_cap);
+        int old_cap = c->chunk->const_cap;
+        c->chunk->const_cap = CW_GROW_CAPACITY(old_cap);
+        c->chunk->constants = CW_GROW_ARRAY(cwValue, c->chunk->constants, old_cap, c->chunk->const_cap);
     }
 
-    cw->chunk->constants[cw->chunk->const_len] = val;
-    if (cw->chunk->const_len > UINT8_MAX)
+    c->chunk->constants[c->chunk->const_len] = val;
+    if (c->chunk->const_len > UINT8_MAX)
     {
-        cw_syntax_error_at(cw, &cw->previous, "Too many constants in one chunk.");
+        cw_syntax_error_at(c->parser, &c->parser->previous, "Too many constants in one chunk.");
         return 0;
     }
 
-    return (uint8_t)cw->chunk->const_len++;
+    return (uint8_t)c->chunk->const_len++;
 }
 
-uint8_t cw_identifier_constant(cwRuntime* cw, cwToken* name)
+uint16_t cw_make_cache(cwCompiler* c)
 {
-    return cw_make_constant(cw, MAKE_OBJECT(cw_str_copy(cw, name->start, name->end - name->start)));
+    cwChunk* chunk = c->chunk;
+    if (chunk->cache_len > UINT16_MAX)
+    {
+        cw_syntax_error_at(c->parser, &c->parser->previous, "Too many inline caches in one chunk.");
+        return 0;
+    }
+
+    chunk->caches = CW_GROW_ARRAY(uint32_t, chunk->caches, chunk->cache_len, chunk->cache_len + 1);
+    chunk->caches[chunk->cache_len] = UINT32_MAX;
+    return (uint16_t)chunk->cache_len++;
+}
+
+uint16_t cw_make_call_site(cwCompiler* c)
+{
+    cwChunk* chunk = c->chunk;
+    if (chunk->site_len > UINT16_MAX)
+    {
+        cw_syntax_error_at(c->parser, &c->parser->previous, "Too many method calls in one chunk.");
+        return 0;
+    }
+
+    chunk->sites = CW_GROW_ARRAY(cwCallSite, chunk->sites, chunk->site_len, chunk->site_len + 1);
+    cw_call_site_init(&chunk->sites[chunk->site_len]);
+    return (uint16_t)chunk->site_len++;
+}
+
+uint8_t cw_identifier_constant(cwCompiler* c, cwToken* name)
+{
+    return cw_make_constant(c, MAKE_OBJECT(cw_str_intern(c->engine, name->start, name->end - name->start)));
 }
 
 bool cw_identifiers_equal(const cwToken* a, const cwToken* b)
@@ -45,28 +74,47 @@ bool cw_identifiers_equal(const cwToken* a, const cwToken* b)
 }
 
 /* --------------------------| locals |-------------------------------------------------- */
-void cw_add_local(cwRuntime* cw, cwToken* name)
+void cw_add_local(cwCompiler* c, cwToken* name)
 {
-    if (cw->local_count > UINT8_MAX)
+    if (c->local_count > UINT8_MAX)
     {
-        cw_syntax_error_at(cw, &cw->previous, "Too many variables in scope.");
+        cw_syntax_error_at(c->parser, &c->parser->previous, "Too many variables in scope.");
         return;
     }
 
-    cwLocal* local = &cw->locals[cw->local_count++];
+    cwLocal* local = &c->locals[c->local_count++];
     local->name = *name;
     local->depth = -1;
 }
 
-int cw_resolve_local(cwRuntime* cw, cwToken* name)
+void cw_declare_local(cwCompiler* c, cwToken* name)
 {
-    for (int i = cw->local_count - 1; i >= 0; i--)
+    for (int i = c->local_count - 1; i >= 0; i--)
     {
-        cwLocal* local = &cw->locals[i]; 
+        cwLocal* local = &c->locals[i];
+        if (local->depth != -1 && local->depth < c->scope_depth) break;
+
+        if (cw_identifiers_equal(name, &local->name))
+            cw_syntax_error_at(c->parser, name, "Already a variable with this name in this scope.");
+    }
+
+    cw_add_local(c, name);
+}
+
+void cw_mark_initialized(cwCompiler* c)
+{
+    c->locals[c->local_count - 1].depth = c->scope_depth;
+}
+
+int cw_resolve_local(cwCompiler* c, cwToken* name)
+{
+    for (int i = c->local_count - 1; i >= 0; i--)
+    {
+        cwLocal* local = &c->locals[i]; 
         if (cw_identifiers_equal(name, &local->name))
         {
             if (local->depth < 0) 
-                cw_syntax_error_at(cw, name, "Can not read local variable in its own initializer.");
+                cw_syntax_error_at(c->parser, name, "Can not read local variable in its own initializer.");
             return i;
         } 
     }
@@ -103,59 +151,264 @@ int cw_emit_jump(cwChunk* chunk, uint8_t instruction, int line)
     return chunk->len - 2;
 }
 
-void cw_patch_jump(cwRuntime* cw, int offset)
+void cw_patch_jump(cwCompiler* c, int offset)
 {
     /* -2 to adjust for the bytecode for the jump offset itself. */
-    int jump = cw->chunk->len - offset - 2;
+    int jump = c->chunk->len - offset - 2;
 
-    if (jump > UINT16_MAX) cw_syntax_error_at(cw, &cw->previous, "Too much code to jump over.");
+    if (jump > UINT16_MAX) cw_syntax_error_at(c->parser, &c->parser->previous, "Too much code to jump over.");
 
-    cw->chunk->bytes[offset] = (jump >> 8) & 0xff;
-    cw->chunk->bytes[offset + 1] = jump & 0xff;
+    c->chunk->bytes[offset] = (jump >> 8) & 0xff;
+    c->chunk->bytes[offset + 1] = jump & 0xff;
 }
 
-void cw_emit_loop(cwRuntime* cw, int start)
+void cw_emit_loop(cwCompiler* c, int start)
 {
-    cw_emit_byte(cw->chunk, OP_LOOP, cw->previous.line);
+    cw_emit_byte(c->chunk, OP_LOOP, c->parser->previous.line);
 
-    int offset = cw->chunk->len - start + 2;
-    if (offset > UINT16_MAX) cw_syntax_error_at(cw, &cw->previous, "Loop body too large.");
+    int offset = c->chunk->len - start + 2;
+    if (offset > UINT16_MAX) cw_syntax_error_at(c->parser, &c->parser->previous, "Loop body too large.");
 
-    cw_emit_byte(cw->chunk, (offset >> 8) & 0xff, cw->previous.line);
-    cw_emit_byte(cw->chunk, offset & 0xff, cw->previous.line);
+    cw_emit_byte(c->chunk, (offset >> 8) & 0xff, c->parser->previous.line);
+    cw_emit_byte(c->chunk, offset & 0xff, c->parser->previous.line);
 }
 
 /* --------------------------| compiling |----------------------------------------------- */
-static void cw_compiler_end(cwRuntime* cw)
+static void cw_compiler_begin(cwCompiler* c, cwParser* parser, cwEngine* engine, cwFunction* function, const char* src, int line)
+{
+    /* init parser with the first token */
+    parser->current.type = TOKEN_NULL;
+    parser->current.start = src;
+    parser->current.end = src;
+    parser->current.line = line;
+    parser->error = false;
+    parser->panic = false;
+
+    /* init compiler */
+    c->engine = engine;
+    c->parser = parser;
+    c->function = function;
+    c->chunk = &function->chunk;
+    c->local_count = 0;
+    c->scope_depth = 0;
+    c->enclosing = NULL;
+    c->reductions = NULL;
+    c->local_end = -1;
+    c->modifier_end = -1;
+
+    /* the first slot holds the called function */
+    cwLocal* local = &c->locals[c->local_count++];
+    local->depth = 0;
+    local->name.start = "";
+    local->name.end = local->name.start;
+
+    cw_advance(c);
+}
+
+void cw_compiler_nest(cwCompiler* c, cwCompiler* enclosing, cwFunction* function)
+{
+    c->engine = enclosing->engine;
+    c->parser = enclosing->parser;
+    c->function = function;
+    c->chunk = &function->chunk;
+    c->local_count = 0;
+    c->scope_depth = 1;
+    c->enclosing = enclosing;
+    c->reductions = NULL;
+    c->local_end = -1;
+    c->modifier_end = -1;
+
+    cwLocal* local = &c->locals[c->local_count++];
+    local->depth = 0;
+    local->name.start = "";
+    local->name.end = local->name.start;
+}
+
+void cw_compiler_end(cwCompiler* c)
 {
-    cw_emit_byte(cw->chunk, OP_RETURN, cw->previous.line);
+    cw_emit_byte(c->chunk, OP_NULL, c->parser->previous.line);
+    cw_emit_byte(c->chunk, OP_RETURN, c->parser->previous.line);
 #ifdef DEBUG_PRINT_CODE
-    if (!cw->error) cw_disassemble_chunk(cw->chunk, "code");
+    if (!c->parser->error) cw_disassemble_chunk(c->chunk, c->function->name ? c->function->name->raw : "<script>");
 #endif 
 }
 
-bool cw_compile(cwRuntime* cw, const char* src, cwChunk* chunk)
+/*
+ * Parser and compiler state lives on the C stack of the compile call and
+ * the VM state is never touched, so a function can be compiled while the
+ * runtime is executing. Compiling adds literals and functions to the engine
+ * and is serialized by the engine lock; compiled chunks are never modified
+ * afterwards and can be executed by any number of threads.
+ */
+static cwFunction* cw_compile_script(cwEngine* engine, const char* src)
 {
-    /* init first token */
-    cw->current.type = TOKEN_NULL;
-    cw->current.start = src;
-    cw->current.end = src;
-    cw->current.line = 1;
+    cwParser parser;
+    cwCompiler compiler;
 
-    /* init compiler */
-    cw->chunk = chunk;
-    cw->local_count = 0;
-    cw->scope_depth = 0;
-    cw->error = false;
-    cw->panic = false;
+    cwFunction* function = cw_function_new(engine);
+    cw_compiler_begin(&compiler, &parser, engine, function, src, 1);
+
+    while (!cw_match(&compiler, TOKEN_EOF))
+    {
+        cw_parse_declaration(&compiler);
+    }
 
-    cw_advance(cw);
+    cw_compiler_end(&compiler);
+    return parser.error ? NULL : function;
+}
 
-    while (!cw_match(cw, TOKEN_EOF))
+static bool cw_compile_body(cwEngine* engine, cwFunction* function)
+{
+    cwParser parser;
+    cwCompiler compiler;
+    cwCompiler* c = &compiler;
+
+    cw_compiler_begin(c, &parser, engine, function, function->source, function->line);
+    c->scope_depth = 1;
+
+    /* parameters become the first locals of the function */
+    cw_consume(c, TOKEN_LPAREN, "Expect '(' after function name.");
+    if (parser.current.type != TOKEN_RPAREN)
     {
-        cw_parse_declaration(cw);
+        do
+        {
+            cw_consume(c, TOKEN_IDENTIFIER, "Expect parameter name.");
+            cw_declare_local(c, &parser.previous);
+            cw_mark_initialized(c);
+        } while (cw_match(c, TOKEN_COMMA));
     }
+    cw_consume(c, TOKEN_RPAREN, "Expect ')' after parameters.");
 
-    cw_compiler_end(cw);
-    return !cw->error;
+    cw_consume(c, TOKEN_LBRACE, "Expect '{' before function body.");
+    while (parser.current.type != TOKEN_RBRACE && parser.current.type != TOKEN_EOF)
+    {
+        cw_parse_declaration(c);
+    }
+    cw_consume(c, TOKEN_RBRACE, "Expect '}' after function body.");
+
+    cw_compiler_end(c);
+    if (parser.error)
+    {
+        cw_chunk_free(&function->chunk);
+        return false;
+    }
+
+    /* publish the chunk: threads that see no source can run it without the lock */
+    char* source = function->source;
+    size_t source_len = function->source_len;
+    function->source_len = 0;
+    CW_ATOMIC_STORE(&function->source, NULL);
+
+    CW_FREE_ARRAY(char, source, source_len + 1);
+    return true;
+}
+
+cwFunction* cw_compile(cwEngine* engine, const char* src)
+{
+    cw_mutex_lock(&engine->lock);
+    cwFunction* function = cw_compile_script(engine, src);
+    cw_mutex_unlock(&engine->lock);
+    return function;
+}
+
+bool cw_compile_function(cwEngine* engine, cwFunction* function)
+{
+    if (cw_function_compiled(function)) return true;
+
+    /* another thread might have compiled the function while waiting for the lock */
+    cw_mutex_lock(&engine->lock);
+    bool result = cw_function_compiled(function) || cw_compile_body(engine, function);
+    cw_mutex_unlock(&engine->lock);
+    return result;
+}
+
+bool cw_compile_all(cwEngine* engine, cwFunction* function)
+{
+    if (!cw_compile_function(engine, function)) return false;
+
+    /* nested functions only exist once the body that declares them is compiled */
+    const cwChunk* chunk = &function->chunk;
+    for (size_t i = 0; i < chunk->const_len; ++i)
+    {
+        cwValue constant = chunk->constants[i];
+        if (IS_FUNCTION(constant) && !cw_compile_all(engine, AS_FUNCTION(constant))) return false;
+        if (!IS_SHAPE(constant)) continue;
+
+        const cwShape* shape = AS_SHAPE(constant);
+        for (int m = 0; m < shape->method_count; ++m)
+        {
+            if (!cw_compile_all(engine, shape->methods[m])) return false;
+        }
+    }
+    return true;
+}
+
+/* --------------------------| batch |--------------------------------------------------- */
+typedef struct
+{
+    const char* const* sources;
+    cwFunction** functions;
+    int count;
+    int next;   /* index of the next source to compile */
+} cwBatch;
+
+typedef struct
+{
+    cwBatch* batch;
+    cwEngine engine;
+    cwThread thread;
+    bool started;
+} cwBatchWorker;
+
+static void* cw_batch_compile(void* arg)
+{
+    cwBatchWorker* worker = arg;
+    cwBatch* batch = worker->batch;
+
+    int i;
+    while ((i = CW_ATOMIC_ADD(&batch->next, 1) - 1) < batch->count)
+    {
+        batch->functions[i] = cw_compile(&worker->engine, batch->sources[i]);
+    }
+    return NULL;
+}
+
+bool cw_compile_batch(cwEngine* engine, const char* const* sources, int count, cwFunction** functions, int threads)
+{
+    if (threads <= 0)    threads = cw_thread_count();
+    if (threads > count) threads = count;
+    if (threads <= 0)    return true;
+
+    cwBatch batch = { .sources = sources, .functions = functions, .count = count, .next = 0 };
+
+    /* literals go to the shared intern table right away if the engine uses one */
+    cwBatchWorker* workers = CW_ALLOCATE(cwBatchWorker, threads);
+    for (int i = 0; i < threads; ++i)
+    {
+        workers[i].batch = &batch;
+        workers[i].started = false;
+        cw_engine_init(&workers[i].engine, engine->atoms);
+    }
+
+    /* the calling thread is the first worker */
+    for (int i = 1; i < threads; ++i)
+    {
+        workers[i].started = cw_thread_create(&workers[i].thread, cw_batch_compile, &workers[i]);
+    }
+    cw_batch_compile(&workers[0]);
+
+    for (int i = 0; i < threads; ++i)
+    {
+        if (workers[i].started) cw_thread_join(workers[i].thread);
+        cw_engine_merge(engine, &workers[i].engine);
+        cw_engine_free(&workers[i].engine);
+    }
+    CW_FREE_ARRAY(cwBatchWorker, workers, threads);
+
+    bool result = true;
+    for (int i = 0; i < count; ++i)
+    {
+        if (!functions[i]) result = false;
+    }
+    return result;
 }
\ No newline at end of file
@@ -2,6 +2,7 @@
 #define CLOCKWORK_COMPILER_H
 
 #include "scanner.h"
+#include "parser.h"
 
 typedef enum
 {
@@ -32,6 +33,26 @@ typedef enum
     OP_JUMP_IF_FALSE,
     OP_JUMP,
     OP_LOOP,
+    OP_CALL,
+    /* coroutines */
+    OP_RESUME,
+    OP_YIELD,
+    /* parallel and vectorized loops */
+    OP_PARALLEL,
+    OP_VECTORIZE,
+    /* arrays */
+    OP_ARRAY,
+    OP_INDEX_GET,
+    OP_INDEX_SET,
+    /* maps */
+    OP_MAP,
+    OP_MAP_GET,
+    OP_MAP_SET,
+    OP_ITERATE,
+    /* records */
+    OP_GET_FIELD,
+    OP_SET_FIELD,
+    OP_INVOKE,
     OP_PRINT,
     OP_RETURN,
 } cwOpCode;
@@ -42,23 +63,85 @@ typedef struct
     int depth;
 } cwLocal;
 
-bool cw_compile(cwRuntime* cw, const char* src, cwChunk* chunk);
+/*
+ * Reduction variables of a parallel loop. Each block of the loop starts with
+ * its own copy of the variable and the copies are combined at the end.
+ */
+#define CW_REDUCTIONS_MAX 8
+
+typedef enum
+{
+    REDUCE_SUM,
+    REDUCE_MIN,
+    REDUCE_MAX
+} cwReduceOp;
+
+typedef struct
+{
+    cwToken names[CW_REDUCTIONS_MAX];
+    cwReduceOp ops[CW_REDUCTIONS_MAX];
+    int count;
+} cwReductions;
+
+/* state for compiling the body of a single function */
+struct cwCompiler
+{
+    cwEngine* engine;   /* owns interned literals and compiled functions */
+    cwParser* parser;
+
+    cwFunction* function;
+    cwChunk* chunk;
+
+    cwLocal locals[UINT8_MAX + 1];
+    int local_count;
+    int scope_depth;
+
+    /* set for the body of a parallel loop, which is compiled as a function of its own */
+    cwCompiler* enclosing;
+    const cwReductions* reductions;
+
+    /* ends of the last reads of a local and of a builtin that modifies its first argument */
+    int local_end;
+    int modifier_end;
+};
+
+cwFunction* cw_compile(cwEngine* engine, const char* src);
+bool cw_compile_function(cwEngine* engine, cwFunction* function);
+
+/* compiles the function and every function nested in it, methods of datatypes included */
+bool cw_compile_all(cwEngine* engine, cwFunction* function);
+
+/* compiles a function in the middle of the source of the enclosing compiler */
+void cw_compiler_nest(cwCompiler* c, cwCompiler* enclosing, cwFunction* function);
+void cw_compiler_end(cwCompiler* c);
+
+/*
+ * Compiles many sources in parallel. Every thread compiles into an engine of
+ * its own, which is merged into the given engine at the end. Functions are
+ * stored in the order of the sources, NULL for sources that did not compile.
+ * A thread count of 0 uses one thread per processor.
+ */
+bool cw_compile_batch(cwEngine* engine, const char* const* sources, int count, cwFunction** functions, int threads);
 
 /* constants identitfiers */
-uint8_t cw_make_constant(cwRuntime* cw, cwValue value);
-uint8_t cw_identifier_constant(cwRuntime* cw, cwToken* name);
+uint8_t cw_make_constant(cwCompiler* c, cwValue value);
+uint8_t cw_identifier_constant(cwCompiler* c, cwToken* name);
+uint16_t cw_make_cache(cwCompiler* c); /* a cache word for the instruction being emitted */
+uint16_t cw_make_call_site(cwCompiler* c);
 bool cw_identifiers_equal(const cwToken* a, const cwToken* b);
 
 /* locals */
-void cw_add_local(cwRuntime* cw, cwToken* name);
-int  cw_resolve_local(cwRuntime* cw, cwToken* name);
+void cw_add_local(cwCompiler* c, cwToken* name);
+void cw_declare_local(cwCompiler* c, cwToken* name);
+void cw_mark_initialized(cwCompiler* c);
+int  cw_resolve_local(cwCompiler* c, cwToken* name);
 
 /* writing byte code */
 void cw_emit_byte(cwChunk* chunk, uint8_t byte, int line);
 void cw_emit_bytes(cwChunk* chunk, uint8_t a, uint8_t b, int line);
 
 int  cw_emit_jump(cwChunk* chunk, uint8_t instruction, int line);
-void cw_emit_loop(cwRuntime* cw, int start);
-void cw_patch_jump(cwRuntime* cw, int offset);
+void cw_emit_loop(cwCompiler* c, int start);
+void cw_patch_jump(cwCompiler* c, int offset);
 
 #endif /* !CLOCKWORK_COMPILER_H */
\ No newline at end of file
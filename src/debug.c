@@ -4,6 +4,11 @@
 #include <stdarg.h>
 
 #include "runtime.h"
+#include "array.h"
+#include "map.h"
+#include "record.h"
+#include "columns.h"
+#include "vectorize.h"
 
 void cw_disassemble_chunk(const cwChunk* chunk, const char* name)
 {
@@ -44,6 +49,65 @@ static int cw_disassemble_jump(const char* name, int sign, const cwChunk* chunk,
     return offset + 3;
 }
 
+static int cw_disassemble_parallel(const cwChunk* chunk, int offset)
+{
+    uint8_t body = chunk->bytes[offset + 1];
+    uint8_t count = chunk->bytes[offset + 2];
+    printf("%-16s %4d '", "OP_PARALLEL", body);
+    cw_print_value(chunk->constants[body]);
+    printf("'");
+
+    static const char* ops[] = { "+", "min", "max" };
+    for (int i = 0; i < count; ++i)
+    {
+        const uint8_t* reduction = &chunk->bytes[offset + 3 + 2 * i];
+        printf(" %s ", ops[reduction[1]]);
+        cw_print_value(chunk->constants[reduction[0]]);
+    }
+    printf("\n");
+    return offset + 3 + 2 * count;
+}
+
+static int cw_disassemble_vectorize(const cwChunk* chunk, int offset)
+{
+    cwVectorLoop loop;
+    cw_vector_decode(chunk->bytes + offset + 1, &loop);
+
+    static const char* kinds[] = { "sum", "dot", "add", "mul", "scale", "fill" };
+    int end = offset + 1 + CW_VECTOR_OPERANDS;
+    printf("%-16s %4d %s -> %d\n", "OP_VECTORIZE", offset, kinds[loop.kind], end + loop.skip);
+    return end;
+}
+
+static int cw_disassemble_cached(const char* name, const cwChunk* chunk, int offset)
+{
+    uint8_t key = chunk->bytes[offset + 1];
+    uint16_t cache = (uint16_t)(chunk->bytes[offset + 2] << 8) | chunk->bytes[offset + 3];
+    printf("%-16s %4d '", name, key);
+    cw_print_value(chunk->constants[key]);
+    printf("' cache %d\n", cache);
+    return offset + 4;
+}
+
+static int cw_disassemble_iterate(const cwChunk* chunk, int offset)
+{
+    uint8_t slot = chunk->bytes[offset + 1];
+    uint16_t jump = (uint16_t)(chunk->bytes[offset + 2] << 8) | chunk->bytes[offset + 3];
+    printf("%-16s %4d -> %d\n", "OP_ITERATE", slot, offset + 4 + jump);
+    return offset + 4;
+}
+
+static int cw_disassemble_invoke(const cwChunk* chunk, int offset)
+{
+    uint8_t name = chunk->bytes[offset + 1];
+    uint8_t argc = chunk->bytes[offset + 2];
+    uint16_t site = (uint16_t)(chunk->bytes[offset + 3] << 8) | chunk->bytes[offset + 4];
+    printf("%-16s (%d args) %4d '", "OP_INVOKE", argc, name);
+    cw_print_value(chunk->constants[name]);
+    printf("' site %d\n", site);
+    return offset + 5;
+}
+
 int  cw_disassemble_instruction(const cwChunk* chunk, int offset)
 {
     printf("%04d ", offset);
@@ -80,6 +144,21 @@ int  cw_disassemble_instruction(const cwChunk* chunk, int offset)
     case OP_JUMP_IF_FALSE:  return cw_disassemble_jump("OP_JUMP_IF_FALSE", 1, chunk, offset);
     case OP_JUMP:           return cw_disassemble_jump("OP_JUMP", 1, chunk, offset);
     case OP_LOOP:           return cw_disassemble_jump("OP_LOOP", -1, chunk, offset);
+    case OP_CALL:           return cw_disassemble_byte("OP_CALL", chunk, offset);
+    case OP_RESUME:         return cw_disassemble_simple("OP_RESUME", offset);
+    case OP_YIELD:          return cw_disassemble_simple("OP_YIELD", offset);
+    case OP_PARALLEL:       return cw_disassemble_parallel(chunk, offset);
+    case OP_VECTORIZE:      return cw_disassemble_vectorize(chunk, offset);
+    case OP_ARRAY:          return cw_disassemble_byte("OP_ARRAY", chunk, offset);
+    case OP_INDEX_GET:      return cw_disassemble_simple("OP_INDEX_GET", offset);
+    case OP_INDEX_SET:      return cw_disassemble_simple("OP_INDEX_SET", offset);
+    case OP_MAP:            return cw_disassemble_byte("OP_MAP", chunk, offset);
+    case OP_MAP_GET:        return cw_disassemble_cached("OP_MAP_GET", chunk, offset);
+    case OP_MAP_SET:        return cw_disassemble_cached("OP_MAP_SET", chunk, offset);
+    case OP_GET_FIELD:      return cw_disassemble_cached("OP_GET_FIELD", chunk, offset);
+    case OP_SET_FIELD:      return cw_disassemble_cached("OP_SET_FIELD", chunk, offset);
+    case OP_INVOKE:         return cw_disassemble_invoke(chunk, offset);
+    case OP_ITERATE:        return cw_disassemble_iterate(chunk, offset);
     case OP_PRINT:          return cw_disassemble_simple("OP_PRINT", offset);
     case OP_RETURN:         return cw_disassemble_simple("OP_RETURN", offset);
     default:
@@ -105,6 +184,108 @@ void cw_print_object(cwValue val)
     switch (OBJECT_TYPE(val))
     {
     case OBJ_STRING: printf("%s", AS_RAWSTRING(val)); break;
+    case OBJ_FUNCTION:
+        if (AS_FUNCTION(val)->name) printf("<fn %s>", AS_FUNCTION(val)->name->raw);
+        else                        printf("<script>");
+        break;
+    case OBJ_NATIVE:
+        printf("<native %s>", AS_NATIVE(val)->name->raw);
+        break;
+    case OBJ_COROUTINE:
+        printf("<coroutine>");
+        break;
+    case OBJ_CHANNEL:
+        printf("<channel>");
+        break;
+    case OBJ_ARRAY:
+    {
+        const cwArray* array = AS_ARRAY(val);
+        printf("[");
+        for (uint32_t i = 0; i < array->len; ++i)
+        {
+            if (i > 0) printf(", ");
+            cw_print_value(cw_array_get(array, i));
+        }
+        printf("]");
+        break;
+    }
+    case OBJ_MAP:
+    {
+        const cwMap* map = AS_MAP(val);
+        uint32_t position = 0;
+        cwString* key;
+        cwValue value;
+        printf("{");
+        for (bool first = true; cw_map_next(map, &position, &key, &value); first = false)
+        {
+            printf(first ? "%s: " : ", %s: ", key->raw);
+            cw_print_value(value);
+        }
+        printf("}");
+        break;
+    }
+    case OBJ_SHAPE:
+        printf("<datatype %s>", AS_SHAPE(val)->name->raw);
+        break;
+    case OBJ_RECORD:
+    {
+        const cwRecord* record = AS_RECORD(val);
+        const cwShape* shape = record->shape;
+        printf("%s(", shape->name->raw);
+        for (int i = 0; i < shape->field_count; ++i)
+        {
+            printf(i > 0 ? ", %s: " : "%s: ", shape->fields[i]->raw);
+            cw_print_value(record->fields[i]);
+        }
+        printf(")");
+        break;
+    }
+    case OBJ_COLUMNS:
+    {
+        const cwColumns* columns = AS_COLUMNS(val);
+        printf("<columns %s %u>", columns->shape->name->raw, cw_columns_len(columns));
+        break;
+    }
+    case OBJ_ROW:
+    {
+        const cwRow* row = AS_ROW(val);
+        const cwShape* shape = row->columns->shape;
+        printf("%s(", shape->name->raw);
+        for (int i = 0; i < shape->field_count; ++i)
+        {
+            cwValue value = MAKE_NULL();
+            cw_row_get(row, i, &value);
+            printf(i > 0 ? ", %s: " : "%s: ", shape->fields[i]->raw);
+            cw_print_value(value);
+        }
+        printf(")");
+        break;
+    }
+    }
+}
+
+static void cw_print_call_sites(const cwChunk* chunk, const char* name)
+{
+    for (size_t i = 0; i < chunk->site_len; ++i)
+    {
+        const cwCallSite* site = &chunk->sites[i];
+        uint64_t calls = site->hits + site->misses + site->megamorphic;
+        if (calls == 0) continue;
+
+        printf("%-16s site %-4zu %12llu calls %6.2f%% hits %6.2f%% misses %6.2f%% megamorphic\n", name, i,
+               (unsigned long long)calls, 100.0 * site->hits / calls, 100.0 * site->misses / calls,
+               100.0 * site->megamorphic / calls);
+    }
+}
+
+void cw_print_dispatch_stats(const cwEngine* engine)
+{
+    for (const cwObject* object = engine->objects; object; object = object->next)
+    {
+        if (object->type != OBJ_FUNCTION) continue;
+
+        const cwFunction* function = (const cwFunction*)object;
+        cw_print_call_sites(&function->chunk, function->name ? function->name->raw : "<script>");
     }
 }
 
@@ -116,33 +297,39 @@ void cw_runtime_error(cwRuntime* cw, const char* fmt, ...)
     va_end(args);
     fputs("\n", stderr);
 
-    size_t instruction = cw->ip - cw->chunk->bytes - 1;
-    int line = cw->chunk->lines[instruction];
-    fprintf(stderr, "[line %d] in script\n", line);
+    for (int i = cw->vm.frame_count - 1; i >= 0; i--)
+    {
+        cwCallFrame* frame = &cw->vm.frames[i];
+        cwFunction* function = frame->function;
+        size_t instruction = frame->ip - function->chunk.bytes - 1;
+        fprintf(stderr, "[line %d] in ", function->chunk.lines[instruction]);
+        if (function->name) fprintf(stderr, "%s()\n", function->name->raw);
+        else                fprintf(stderr, "script\n");
+    }
     cw_reset_stack(cw);
 }
 
 
-void cw_syntax_error(cwRuntime* cw, int line, const char* fmt, ...)
+void cw_syntax_error(cwParser* parser, int line, const char* fmt, ...)
 {
-    if (cw->panic) return;
-    cw->panic = true;
+    if (parser->panic) return;
+    parser->panic = true;
 
     fprintf(stderr, "[line %d] Syntax error: ", line);
 
     va_list args;
     va_start(args, fmt);
-    fprintf(stderr, fmt, args);
+    vfprintf(stderr, fmt, args);
     va_end(args);
     fputs("\n", stderr);
 
-    cw->error = true;
+    parser->error = true;
 }
 
-void cw_syntax_error_at(cwRuntime* cw, cwToken* token, const char* msg)
+void cw_syntax_error_at(cwParser* parser, cwToken* token, const char* msg)
 {
-    if (cw->panic) return;
-    cw->panic = true;
+    if (parser->panic) return;
+    parser->panic = true;
 
     fprintf(stderr, "[line %d] Syntax error", token->line);
 
@@ -152,6 +339,6 @@ void cw_syntax_error_at(cwRuntime* cw, cwToken* token, const char* msg)
         fprintf(stderr, " at '%.*s'", token->end - token->start, token->start);
 
     fprintf(stderr, ": %s\n", msg);
-    cw->error = true;
+    parser->error = true;
 }
 
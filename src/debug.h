@@ -9,11 +9,14 @@ int  cw_disassemble_instruction(const cwChunk* chunk, int offset);
 void cw_print_value(cwValue val);
 void cw_print_object(cwValue val);
 
+/* hit, miss and megamorphic rates of every method call site that ran */
+void cw_print_dispatch_stats(const cwEngine* engine);
+
 
 /* Error Handling */
 void cw_runtime_error(cwRuntime* cw, const char* format, ...);
 
-void cw_syntax_error(cwRuntime* cw, int line, const char* fmt, ...);
-void cw_syntax_error_at(cwRuntime* cw, cwToken* token, const char* msg);
+void cw_syntax_error(cwParser* parser, int line, const char* fmt, ...);
+void cw_syntax_error_at(cwParser* parser, cwToken* token, const char* msg);
 
 #endif /* !CLOCKWORK_DEBUG_H */
\ No newline at end of file
@@ -0,0 +1,21 @@
+#ifndef CLOCKWORK_EMBEDDED_H
+#define CLOCKWORK_EMBEDDED_H
+
+#include "common.h"
+
+/*
+ * Scripts compiled into the executable at build time. The table is generated
+ * by tools/cwc.c and holds one chunk image per script, in the order the
+ * scripts were passed to the tool.
+ */
+typedef struct
+{
+    const char* name;
+    const uint8_t* bytes;
+    size_t len;
+} cwEmbedded;
+
+extern const cwEmbedded cw_embedded[];
+extern const size_t cw_embedded_count;
+
+#endif /* !CLOCKWORK_EMBEDDED_H */
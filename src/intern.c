@@ -0,0 +1,136 @@
+#include "intern.h"
+
+#include <string.h>
+
+#include "memory.h"
+
+#define CW_INTERN_MAX_LOAD 0.75
+
+/* the low bits select the shard, the remaining bits the slot */
+#define CW_INTERN_SHARD(hash) ((hash) % CW_INTERN_SHARDS)
+#define CW_INTERN_SLOT(hash)  ((hash) / CW_INTERN_SHARDS)
+
+static cwInternSlots* cw_intern_slots_new(uint32_t capacity)
+{
+    cwInternSlots* slots = cw_reallocate(NULL, 0, sizeof(cwInternSlots) + sizeof(cwString*) * capacity);
+    slots->retired = NULL;
+    slots->capacity = capacity;
+    memset(slots->entries, 0, sizeof(cwString*) * capacity);
+    return slots;
+}
+
+static void cw_intern_slots_free(cwInternSlots* slots)
+{
+    while (slots)
+    {
+        cwInternSlots* retired = slots->retired;
+        cw_reallocate(slots, sizeof(cwInternSlots) + sizeof(cwString*) * slots->capacity, 0);
+        slots = retired;
+    }
+}
+
+void cw_intern_init(cwInternTable* table)
+{
+    for (int i = 0; i < CW_INTERN_SHARDS; ++i)
+    {
+        cwInternShard* shard = &table->shards[i];
+        shard->slots = NULL;
+        shard->size = 0;
+        shard->objects = NULL;
+        cw_mutex_init(&shard->lock);
+    }
+}
+
+void cw_intern_free(cwInternTable* table)
+{
+    for (int i = 0; i < CW_INTERN_SHARDS; ++i)
+    {
+        cwInternShard* shard = &table->shards[i];
+        cw_intern_slots_free(shard->slots);
+        cw_free_objects(shard->objects);
+        cw_mutex_free(&shard->lock);
+    }
+    cw_intern_init(table);
+}
+
+static cwString* cw_intern_probe(const cwInternSlots* slots, const char* src, size_t len, uint32_t hash)
+{
+    uint32_t mask = slots->capacity - 1;
+    uint32_t index = CW_INTERN_SLOT(hash) & mask;
+    while (true)
+    {
+        cwString* str = CW_ATOMIC_LOAD(&slots->entries[index]);
+        if (str == NULL) return NULL;
+
+        if (str->len == len && str->hash == hash && memcmp(str->raw, src, len) == 0) return str;
+
+        index = (index + 1) & mask;
+    }
+}
+
+cwString* cw_intern_find(const cwInternTable* table, const char* src, size_t len, uint32_t hash)
+{
+    const cwInternShard* shard = &table->shards[CW_INTERN_SHARD(hash)];
+    const cwInternSlots* slots = CW_ATOMIC_LOAD(&shard->slots);
+    return slots ? cw_intern_probe(slots, src, len, hash) : NULL;
+}
+
+/* only the owner of the shard lock writes to the slots, so no compare-and-swap is needed */
+static void cw_intern_place(cwInternSlots* slots, cwString* str)
+{
+    uint32_t mask = slots->capacity - 1;
+    uint32_t index = CW_INTERN_SLOT(str->hash) & mask;
+    while (slots->entries[index] != NULL) index = (index + 1) & mask;
+
+    CW_ATOMIC_STORE(&slots->entries[index], str);
+}
+
+static void cw_intern_grow(cwInternShard* shard)
+{
+    cwInternSlots* old = shard->slots;
+    cwInternSlots* slots = cw_intern_slots_new(CW_GROW_CAPACITY(old ? old->capacity : 0));
+
+    if (old)
+    {
+        for (uint32_t i = 0; i < old->capacity; ++i)
+        {
+            if (old->entries[i]) cw_intern_place(slots, old->entries[i]);
+        }
+    }
+
+    /* readers might still probe the old array, so it is only retired */
+    slots->retired = old;
+    CW_ATOMIC_STORE(&shard->slots, slots);
+}
+
+cwString* cw_intern_insert(cwInternTable* table, const char* src, size_t len, uint32_t hash)
+{
+    cwInternShard* shard = &table->shards[CW_INTERN_SHARD(hash)];
+
+    cwString* str = cw_intern_find(table, src, len, hash);
+    if (str) return str;
+
+    cw_mutex_lock(&shard->lock);
+
+    /* another thread might have inserted the string while waiting for the lock */
+    str = shard->slots ? cw_intern_probe(shard->slots, src, len, hash) : NULL;
+    if (!str)
+    {
+        if (!shard->slots || shard->size + 1 > shard->slots->capacity * CW_INTERN_MAX_LOAD)
+            cw_intern_grow(shard);
+
+        str = (cwString*)cw_object_alloc(&shard->objects, sizeof(cwString), OBJ_STRING);
+        str->obj.frozen = true;
+        str->raw = cw_reallocate(NULL, 0, len + 1);
+        memcpy(str->raw, src, len);
+        str->raw[len] = '\0';
+        str->len = len;
+        str->hash = hash;
+
+        cw_intern_place(shard->slots, str);
+        shard->size++;
+    }
+
+    cw_mutex_unlock(&shard->lock);
+    return str;
+}
@@ -0,0 +1,41 @@
+#ifndef CLOCKWORK_INTERN_H
+#define CLOCKWORK_INTERN_H
+
+#include "common.h"
+
+#define CW_INTERN_SHARDS 16
+
+/*
+ * Concurrent intern table for literals shared by several engines, so equal
+ * literals of different engines are the same string. Lookups are lock-free:
+ * slot arrays are published with release stores and never freed while the
+ * table is alive. Inserts lock only the shard of the hash. Strings in the
+ * table are immortal and freed together with the table.
+ */
+typedef struct cwInternSlots
+{
+    struct cwInternSlots* retired;  /* arrays replaced by growing */
+    uint32_t capacity;              /* power of two */
+    cwString* entries[];
+} cwInternSlots;
+
+typedef struct
+{
+    cwInternSlots* slots;
+    uint32_t size;
+    cwObject* objects;
+    cwMutex lock;
+} cwInternShard;
+
+typedef struct
+{
+    cwInternShard shards[CW_INTERN_SHARDS];
+} cwInternTable;
+
+void cw_intern_init(cwInternTable* table);
+void cw_intern_free(cwInternTable* table);
+
+cwString* cw_intern_find(const cwInternTable* table, const char* src, size_t len, uint32_t hash);
+cwString* cw_intern_insert(cwInternTable* table, const char* src, size_t len, uint32_t hash);
+
+#endif /* !CLOCKWORK_INTERN_H */
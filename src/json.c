@@ -0,0 +1,986 @@
+#include "json.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "array.h"
+#include "columns.h"
+#include "debug.h"
+#include "map.h"
+#include "memory.h"
+#include "record.h"
+
+#if defined(__GNUC__) && defined(__SSE2__)
+#define CW_JSON_SSE2
+#include <emmintrin.h>
+#endif
+
+/* --------------------------| stage 1 |------------------------------------------------- */
+/* one bit per byte of a block of 64 */
+typedef struct
+{
+    uint64_t quote;
+    uint64_t backslash;
+    uint64_t op;        /* { } [ ] : , */
+    uint64_t space;
+} cwJsonMasks;
+
+#ifdef CW_JSON_SSE2
+
+static inline uint64_t cw_json_match(__m128i chunk, char c)
+{
+    return (uint16_t)_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, _mm_set1_epi8(c)));
+}
+
+static void cw_json_classify(const uint8_t* block, cwJsonMasks* masks)
+{
+    masks->quote = masks->backslash = masks->op = masks->space = 0;
+    for (int i = 0; i < 4; ++i)
+    {
+        __m128i chunk = _mm_loadu_si128((const __m128i*)(block + 16 * i));
+
+        /* setting bit 5 folds [ and ] onto { and } */
+        __m128i folded = _mm_or_si128(chunk, _mm_set1_epi8(0x20));
+        uint64_t op = cw_json_match(folded, '{') | cw_json_match(folded, '}')
+                    | cw_json_match(chunk, ':')  | cw_json_match(chunk, ',');
+        uint64_t space = cw_json_match(chunk, ' ')  | cw_json_match(chunk, '\n')
+                       | cw_json_match(chunk, '\r') | cw_json_match(chunk, '\t');
+
+        masks->quote     |= cw_json_match(chunk, '"') << (16 * i);
+        masks->backslash |= cw_json_match(chunk, '\\') << (16 * i);
+        masks->op        |= op << (16 * i);
+        masks->space     |= space << (16 * i);
+    }
+}
+
+#else
+
+static void cw_json_classify(const uint8_t* block, cwJsonMasks* masks)
+{
+    masks->quote = masks->backslash = masks->op = masks->space = 0;
+    for (int i = 0; i < 64; ++i)
+    {
+        uint64_t bit = (uint64_t)1 << i;
+        switch (block[i])
+        {
+        case '"':  masks->quote |= bit; break;
+        case '\\': masks->backslash |= bit; break;
+        case '{': case '}': case '[': case ']': case ':': case ',': masks->op |= bit; break;
+        case ' ': case '\n': case '\r': case '\t': masks->space |= bit; break;
+        }
+    }
+}
+
+#endif /* CW_JSON_SSE2 */
+
+/*
+ * Bits of the characters escaped by an odd run of backslashes. Runs are
+ * told apart by whether they start on an even or an odd bit: adding the
+ * start to the run carries past its end, and the parity of the end against
+ * the start is the parity of the run. A run that carries out of the block
+ * is continued by the next one.
+ */
+static inline uint64_t cw_json_escaped(uint64_t backslash, uint64_t* prev_odd)
+{
+    const uint64_t even_bits = 0x5555555555555555u;
+    const uint64_t odd_bits = ~even_bits;
+
+    uint64_t starts = backslash & ~(backslash << 1);
+    uint64_t even_start_mask = even_bits ^ *prev_odd;
+    uint64_t even_starts = starts & even_start_mask;
+    uint64_t odd_starts = starts & ~even_start_mask;
+
+    uint64_t even_carries = backslash + even_starts;
+    uint64_t odd_carries = backslash + odd_starts;
+    uint64_t carried_out = odd_carries < backslash;
+    odd_carries |= *prev_odd;
+    *prev_odd = carried_out;
+
+    uint64_t even_carry_ends = even_carries & ~backslash;
+    uint64_t odd_carry_ends = odd_carries & ~backslash;
+    return (even_carry_ends & odd_bits) | (odd_carry_ends & even_bits);
+}
+
+/* every bit becomes the xor of itself and the bits below, SSE2 has no carry-less multiply for this */
+static inline uint64_t cw_json_prefix_xor(uint64_t bits)
+{
+    bits ^= bits << 1;
+    bits ^= bits << 2;
+    bits ^= bits << 4;
+    bits ^= bits << 8;
+    bits ^= bits << 16;
+    bits ^= bits << 32;
+    return bits;
+}
+
+static inline int cw_json_ctz(uint64_t bits)
+{
+#ifdef __GNUC__
+    return __builtin_ctzll(bits);
+#else
+    int n = 0;
+    while (!(bits & 1)) { bits >>= 1; ++n; }
+    return n;
+#endif
+}
+
+/* --------------------------| parser |-------------------------------------------------- */
+typedef struct
+{
+    cwValue value;
+    double number;      /* the number at full precision for arrays of numbers */
+    size_t at;
+} cwJsonSlot;
+
+typedef struct
+{
+    cwRuntime* cw;      /* the heap the values are built in */
+    const char* src;
+    size_t len;
+
+    uint32_t* index;    /* offsets of structural characters and starts of values */
+    size_t index_len;
+    size_t index_cap;
+    size_t next;
+
+    cwJsonSlot* slots;  /* elements of the arrays being parsed */
+    size_t slot_len;
+    size_t slot_cap;
+
+    char* text;         /* strings with escapes and numbers */
+    size_t text_cap;
+
+    double number;
+    bool in_array;      /* numbers too large for a float may still end up in a float64 array */
+    const char* error;
+    size_t error_at;
+} cwJsonParser;
+
+static void cw_json_parser_init(cwJsonParser* p, cwRuntime* cw)
+{
+    memset(p, 0, sizeof(cwJsonParser));
+    p->cw = cw;
+}
+
+static void cw_json_parser_free(cwJsonParser* p)
+{
+    CW_FREE_ARRAY(uint32_t, p->index, p->index_cap);
+    CW_FREE_ARRAY(cwJsonSlot, p->slots, p->slot_cap);
+    CW_FREE_ARRAY(char, p->text, p->text_cap);
+}
+
+static bool cw_json_fail(cwJsonParser* p, size_t at, const char* error)
+{
+    p->error = error;
+    p->error_at = at;
+    return false;
+}
+
+static void cw_json_reserve_text(cwJsonParser* p, size_t len)
+{
+    if (len <= p->text_cap) return;
+
+    size_t old_cap = p->text_cap;
+    while (p->text_cap < len) p->text_cap = CW_GROW_CAPACITY(p->text_cap);
+    p->text = CW_GROW_ARRAY(char, p->text, old_cap, p->text_cap);
+}
+
+static bool cw_json_index(cwJsonParser* p)
+{
+    if (p->len > UINT32_MAX) return cw_json_fail(p, 0, "Documents are limited to 4 GiB");
+
+    /* a structural character takes at least a byte, the index never outgrows the text */
+    if (p->index_cap < p->len)
+    {
+        CW_FREE_ARRAY(uint32_t, p->index, p->index_cap);
+        p->index_cap = p->len;
+        p->index = CW_ALLOCATE(uint32_t, p->index_cap);
+    }
+
+    const uint8_t* src = (const uint8_t*)p->src;
+    uint64_t prev_odd = 0;          /* the last block ended in an odd run of backslashes */
+    uint64_t prev_in_string = 0;    /* all ones if the last block ended inside a string */
+    uint64_t prev_scalar = 0;       /* the last block ended in a scalar */
+    size_t count = 0;
+
+    for (size_t base = 0; base < p->len; base += 64)
+    {
+        /* the last block is padded with whitespace */
+        uint8_t tail[64];
+        const uint8_t* block = src + base;
+        if (p->len - base < 64)
+        {
+            memset(tail, ' ', sizeof(tail));
+            memcpy(tail, block, p->len - base);
+            block = tail;
+        }
+
+        cwJsonMasks masks;
+        cw_json_classify(block, &masks);
+
+        /* in_string holds the opening quote and the inside, string_tail the inside and the closing quote */
+        uint64_t quote = masks.quote & ~cw_json_escaped(masks.backslash, &prev_odd);
+        uint64_t in_string = cw_json_prefix_xor(quote) ^ prev_in_string;
+        prev_in_string = (uint64_t)((int64_t)in_string >> 63);
+        uint64_t string_tail = in_string ^ quote;
+
+        /* values start at a scalar that does not follow another one, strings at their opening quote */
+        uint64_t scalar = ~(masks.op | masks.space);
+        uint64_t nonquote_scalar = scalar & ~quote;
+        uint64_t follows_scalar = nonquote_scalar << 1 | prev_scalar;
+        prev_scalar = nonquote_scalar >> 63;
+
+        uint64_t structural = (masks.op | (scalar & ~follows_scalar)) & ~string_tail;
+        while (structural)
+        {
+            p->index[count++] = (uint32_t)(base + cw_json_ctz(structural));
+            structural &= structural - 1;
+        }
+    }
+
+    p->index_len = count;
+    p->next = 0;
+    if (prev_in_string) return cw_json_fail(p, p->len, "Unterminated string");
+    return true;
+}
+
+/* --------------------------| stage 2 |------------------------------------------------- */
+static inline bool cw_json_delimiter(char c)
+{
+    switch (c)
+    {
+    case ' ': case '\n': case '\r': case '\t':
+    case '{': case '}': case '[': case ']': case ':': case ',':
+        return true;
+    default:
+        return false;
+    }
+}
+
+/* a scalar has to end where the next token or whitespace begins */
+static inline bool cw_json_scalar_end(const cwJsonParser* p, size_t end)
+{
+    return end == p->len || cw_json_delimiter(p->src[end]);
+}
+
+static inline bool cw_json_is_digit(char c) { return c >= '0' && c <= '9'; }
+
+static bool cw_json_token(cwJsonParser* p, size_t* at)
+{
+    if (p->next == p->index_len) return cw_json_fail(p, p->len, "Unexpected end of input");
+
+    *at = p->index[p->next++];
+    return true;
+}
+
+static bool cw_json_expect(cwJsonParser* p, char c, const char* error, size_t* at)
+{
+    if (!cw_json_token(p, at)) return false;
+    if (p->src[*at] != c) return cw_json_fail(p, *at, error);
+    return true;
+}
+
+static bool cw_json_literal(cwJsonParser* p, size_t at, const char* literal, cwValue value, cwValue* result)
+{
+    size_t len = strlen(literal);
+    if (p->len - at < len || memcmp(p->src + at, literal, len) != 0 || !cw_json_scalar_end(p, at + len))
+        return cw_json_fail(p, at, "Invalid literal");
+
+    *result = value;
+    return true;
+}
+
+static bool cw_json_too_large(cwValue value, double number)
+{
+    return IS_FLOAT(value) && isinf(AS_FLOAT(value)) && isfinite(number);
+}
+
+static bool cw_json_number(cwJsonParser* p, size_t at, cwValue* result)
+{
+    const char* s = p->src;
+    size_t i = at;
+    bool negative = s[i] == '-';
+    if (negative) ++i;
+    if (i == p->len || !cw_json_is_digit(s[i])) return cw_json_fail(p, at, "Invalid number");
+
+    /* integers of up to 9 digits are accumulated directly and always fit */
+    int32_t integer = 0;
+    int digits = 0;
+    if (s[i] == '0') ++i;
+    else for (; i < p->len && cw_json_is_digit(s[i]); ++i, ++digits) integer = digits < 9 ? integer * 10 + (s[i] - '0') : 0;
+
+    bool integral = true;
+    if (i < p->len && s[i] == '.')
+    {
+        integral = false;
+        if (++i == p->len || !cw_json_is_digit(s[i])) return cw_json_fail(p, at, "Invalid number");
+        while (i < p->len && cw_json_is_digit(s[i])) ++i;
+    }
+    if (i < p->len && (s[i] == 'e' || s[i] == 'E'))
+    {
+        integral = false;
+        if (++i < p->len && (s[i] == '+' || s[i] == '-')) ++i;
+        if (i == p->len || !cw_json_is_digit(s[i])) return cw_json_fail(p, at, "Invalid number");
+        while (i < p->len && cw_json_is_digit(s[i])) ++i;
+    }
+    if (!cw_json_scalar_end(p, i)) return cw_json_fail(p, at, "Invalid number");
+
+    if (integral && digits <= 9)
+    {
+        if (negative) integer = -integer;
+        p->number = integer;
+        *result = MAKE_INT(integer);
+        return true;
+    }
+
+    /* the text is not terminated after the number, strtod gets a copy */
+    cw_json_reserve_text(p, i - at + 1);
+    memcpy(p->text, s + at, i - at);
+    p->text[i - at] = '\0';
+    p->number = strtod(p->text, NULL);
+
+    if (integral && p->number >= INT32_MIN && p->number <= INT32_MAX) *result = MAKE_INT((int32_t)p->number);
+    else                                                           *result = MAKE_FLOAT((float)p->number);
+
+    /* floats of the VM are single precision, a number that overflows one would turn into null */
+    if (!p->in_array && cw_json_too_large(*result, p->number)) return cw_json_fail(p, at, "Number too large for a float");
+    return true;
+}
+
+static int cw_json_hex(const char* s)
+{
+    int code = 0;
+    for (int i = 0; i < 4; ++i)
+    {
+        char c = s[i];
+        code <<= 4;
+        if (c >= '0' && c <= '9')      code |= c - '0';
+        else if (c >= 'a' && c <= 'f') code |= c - 'a' + 10;
+        else if (c >= 'A' && c <= 'F') code |= c - 'A' + 10;
+        else return -1;
+    }
+    return code;
+}
+
+static size_t cw_json_utf8(char* out, uint32_t code)
+{
+    if (code < 0x80)
+    {
+        out[0] = (char)code;
+        return 1;
+    }
+    if (code < 0x800)
+    {
+        out[0] = (char)(0xc0 | code >> 6);
+        out[1] = (char)(0x80 | (code & 0x3f));
+        return 2;
+    }
+    if (code < 0x10000)
+    {
+        out[0] = (char)(0xe0 | code >> 12);
+        out[1] = (char)(0x80 | (code >> 6 & 0x3f));
+        out[2] = (char)(0x80 | (code & 0x3f));
+        return 3;
+    }
+    out[0] = (char)(0xf0 | code >> 18);
+    out[1] = (char)(0x80 | (code >> 12 & 0x3f));
+    out[2] = (char)(0x80 | (code >> 6 & 0x3f));
+    out[3] = (char)(0x80 | (code & 0x3f));
+    return 4;
+}
+
+/* decodes the escapes of a string, the part before the first one is copied as it is */
+static bool cw_json_unescape(cwJsonParser* p, size_t at, size_t i, size_t* len)
+{
+    const char* s = p->src;
+    size_t n = i - (at + 1);
+    cw_json_reserve_text(p, n + 4);
+    memcpy(p->text, s + at + 1, n);
+
+    while (true)
+    {
+        if (i == p->len) return cw_json_fail(p, at, "Unterminated string");
+
+        uint8_t c = (uint8_t)s[i];
+        if (c == '"') break;
+        if (c < 0x20) return cw_json_fail(p, i, "Control character in string");
+
+        cw_json_reserve_text(p, n + 4);
+        if (c != '\\')
+        {
+            p->text[n++] = (char)c;
+            ++i;
+            continue;
+        }
+
+        if (++i == p->len) return cw_json_fail(p, at, "Unterminated string");
+        switch (s[i++])
+        {
+        case '"':  p->text[n++] = '"';  break;
+        case '\\': p->text[n++] = '\\'; break;
+        case '/':  p->text[n++] = '/';  break;
+        case 'b':  p->text[n++] = '\b'; break;
+        case 'f':  p->text[n++] = '\f'; break;
+        case 'n':  p->text[n++] = '\n'; break;
+        case 'r':  p->text[n++] = '\r'; break;
+        case 't':  p->text[n++] = '\t'; break;
+        case 'u':
+        {
+            int code = p->len - i >= 4 ? cw_json_hex(s + i) : -1;
+            if (code < 0) return cw_json_fail(p, i - 2, "Invalid unicode escape");
+            i += 4;
+
+            /* characters outside of the basic plane are escaped as a surrogate pair */
+            if (code >= 0xdc00 && code <= 0xdfff) return cw_json_fail(p, i - 6, "Invalid surrogate pair");
+            if (code >= 0xd800 && code <= 0xdbff)
+            {
+                int low = p->len - i >= 6 && s[i] == '\\' && s[i + 1] == 'u' ? cw_json_hex(s + i + 2) : -1;
+                if (low < 0xdc00 || low > 0xdfff) return cw_json_fail(p, i - 6, "Invalid surrogate pair");
+                i += 6;
+                code = 0x10000 + ((code - 0xd800) << 10) + (low - 0xdc00);
+            }
+            n += cw_json_utf8(p->text + n, (uint32_t)code);
+            break;
+        }
+        default:
+            return cw_json_fail(p, i - 2, "Invalid escape");
+        }
+    }
+
+    *len = n;
+    return true;
+}
+
+/*
+ * Keys become literals of the engine like the names the compiler interns.
+ * Functions are compiled on their first call, so a literal of the script
+ * may be interned after the document was parsed and still has to be the
+ * same string as the key. Keys also outlive the heap of a streamed line.
+ */
+static cwString* cw_json_key(cwJsonParser* p, const char* src, size_t len)
+{
+    cwEngine* engine = p->cw->engine;
+    if (engine->atoms) return cw_str_intern(engine, src, len);
+
+    cw_mutex_lock(&engine->lock);
+    cwString* key = cw_str_intern(engine, src, len);
+    cw_mutex_unlock(&engine->lock);
+    return key;
+}
+
+static bool cw_json_string(cwJsonParser* p, size_t at, bool key, cwString** result)
+{
+    /* strings without escapes are interned straight from the text */
+    const char* s = p->src;
+    size_t i = at + 1;
+    while (i < p->len && s[i] != '"' && s[i] != '\\' && (uint8_t)s[i] >= 0x20) ++i;
+
+    const char* chars = s + at + 1;
+    size_t len = i - at - 1;
+    if (i == p->len || s[i] != '"')
+    {
+        if (!cw_json_unescape(p, at, i, &len)) return false;
+        chars = p->text;
+    }
+
+    *result = key ? cw_json_key(p, chars, len) : cw_str_copy(p->cw, chars, len);
+    return true;
+}
+
+static bool cw_json_value(cwJsonParser* p, int depth, cwValue* result);
+
+static bool cw_json_object(cwJsonParser* p, int depth, cwValue* result)
+{
+    cwMap* map = cw_map_new(&p->cw->objects, p->cw->depth);
+    *result = MAKE_OBJECT(map);
+
+    size_t at;
+    if (p->next < p->index_len && p->src[p->index[p->next]] == '}')
+    {
+        p->next++;
+        return true;
+    }
+
+    while (true)
+    {
+        cwString* key;
+        cwValue value;
+        if (!cw_json_expect(p, '"', "Expected a key", &at) || !cw_json_string(p, at, true, &key)) return false;
+        if (!cw_json_expect(p, ':', "Expected ':' after a key", &at))                         return false;
+
+        p->in_array = false;
+        if (!cw_json_value(p, depth + 1, &value))                                              return false;
+        cw_map_set(map, key, value, NULL);
+
+        if (!cw_json_token(p, &at)) return false;
+        if (p->src[at] == '}')      return true;
+        if (p->src[at] != ',')      return cw_json_fail(p, at, "Expected ',' or '}'");
+    }
+}
+
+/* the elements wait on the slots until it is known whether they are all numbers */
+static bool cw_json_build_array(cwJsonParser* p, size_t base, cwValue* result)
+{
+    uint32_t len = (uint32_t)(p->slot_len - base);
+    const cwJsonSlot* slots = p->slots + base;
+
+    bool numbers = true;
+    bool integers = true;
+    for (uint32_t i = 0; i < len && numbers; ++i)
+    {
+        numbers = IS_INT(slots[i].value) || IS_FLOAT(slots[i].value);
+        integers = integers && IS_INT(slots[i].value);
+    }
+
+    if (numbers)
+    {
+        cwArray* array = cw_array_new(&p->cw->objects, p->cw->depth, integers ? ARRAY_INT32 : ARRAY_FLOAT64, len);
+        if (integers) for (uint32_t i = 0; i < len; ++i) ((int32_t*)array->data)[i] = AS_INT(slots[i].value);
+        else          for (uint32_t i = 0; i < len; ++i) ((double*)array->data)[i] = slots[i].number;
+        *result = MAKE_OBJECT(array);
+    }
+    else
+    {
+        cwMap* map = cw_map_new(&p->cw->objects, p->cw->depth);
+        for (uint32_t i = 0; i < len; ++i)
+        {
+            if (cw_json_too_large(slots[i].value, slots[i].number))
+                return cw_json_fail(p, slots[i].at, "Number too large for a float");
+
+            char key[16];
+            int key_len = snprintf(key, sizeof(key), "%u", i);
+            cw_map_set(map, cw_json_key(p, key, (size_t)key_len), slots[i].value, NULL);
+        }
+        *result = MAKE_OBJECT(map);
+    }
+    p->slot_len = base;
+    return true;
+}
+
+static bool cw_json_array(cwJsonParser* p, int depth, cwValue* result)
+{
+    size_t base = p->slot_len;
+    size_t at;
+    if (p->next < p->index_len && p->src[p->index[p->next]] == ']')
+    {
+        p->next++;
+        return cw_json_build_array(p, base, result);
+    }
+
+    while (true)
+    {
+        cwValue value;
+        size_t start = p->next < p->index_len ? p->index[p->next] : p->len;
+        p->number = 0.0;
+        p->in_array = true;
+        if (!cw_json_value(p, depth + 1, &value)) return false;
+
+        if (p->slot_len == p->slot_cap)
+        {
+            size_t old_cap = p->slot_cap;
+            p->slot_cap = CW_GROW_CAPACITY(old_cap);
+            p->slots = CW_GROW_ARRAY(cwJsonSlot, p->slots, old_cap, p->slot_cap);
+        }
+        p->slots[p->slot_len++] = (cwJsonSlot){ value, p->number, start };
+
+        if (!cw_json_token(p, &at)) return false;
+        if (p->src[at] == ']') return cw_json_build_array(p, base, result);
+        if (p->src[at] != ',') return cw_json_fail(p, at, "Expected ',' or ']'");
+    }
+}
+
+static bool cw_json_value(cwJsonParser* p, int depth, cwValue* result)
+{
+    size_t at;
+    if (!cw_json_token(p, &at)) return false;
+    if (depth >= CW_JSON_DEPTH_MAX) return cw_json_fail(p, at, "Nesting too deep");
+
+    switch (p->src[at])
+    {
+    case '{': return cw_json_object(p, depth, result);
+    case '[': return cw_json_array(p, depth, result);
+    case '"':
+    {
+        cwString* str;
+        if (!cw_json_string(p, at, false, &str)) return false;
+
+        *result = MAKE_OBJECT(str);
+        return true;
+    }
+    case 't': return cw_json_literal(p, at, "true", MAKE_BOOL(true), result);
+    case 'f': return cw_json_literal(p, at, "false", MAKE_BOOL(false), result);
+    case 'n': return cw_json_literal(p, at, "null", MAKE_NULL(), result);
+    case '-': case '0': case '1': case '2': case '3': case '4':
+    case '5': case '6': case '7': case '8': case '9':
+        return cw_json_number(p, at, result);
+    default:
+        return cw_json_fail(p, at, "Unexpected character");
+    }
+}
+
+static bool cw_json_document(cwJsonParser* p, const char* src, size_t len, cwValue* result)
+{
+    p->src = src;
+    p->len = len;
+    p->slot_len = 0;
+    p->in_array = false;
+    p->error = NULL;
+
+    if (!cw_json_index(p))              return false;
+    if (!cw_json_value(p, 0, result))   return false;
+    if (p->next != p->index_len)        return cw_json_fail(p, p->index[p->next], "Unexpected data after the value");
+    return true;
+}
+
+bool cw_json_parse(cwRuntime* cw, const char* src, size_t len, cwValue* result)
+{
+    cwJsonParser parser;
+    cw_json_parser_init(&parser, cw);
+    bool ok = cw_json_document(&parser, src, len, result);
+    if (!ok) cw_runtime_error(cw, "Invalid JSON at offset %zu: %s.", parser.error_at, parser.error);
+
+    cw_json_parser_free(&parser);
+    return ok;
+}
+
+/* --------------------------| stringify |----------------------------------------------- */
+typedef struct
+{
+    char* chars;
+    size_t len;
+    size_t cap;
+    const char* error;
+} cwJsonWriter;
+
+static void cw_json_write(cwJsonWriter* w, const char* src, size_t len)
+{
+    if (w->cap < w->len + len + 1)
+    {
+        size_t old_cap = w->cap;
+        while (w->cap < w->len + len + 1) w->cap = CW_GROW_CAPACITY(w->cap);
+        w->chars = CW_GROW_ARRAY(char, w->chars, old_cap, w->cap);
+    }
+    memcpy(w->chars + w->len, src, len);
+    w->len += len;
+}
+
+static void cw_json_write_char(cwJsonWriter* w, char c) { cw_json_write(w, &c, 1); }
+
+/* the shortest digits that read back as the same float or double, JSON has no infinities and no NaN */
+static void cw_json_write_number(cwJsonWriter* w, double number, bool single)
+{
+    char buffer[32];
+    int len = snprintf(buffer, sizeof(buffer), "null");
+    if (isfinite(number))
+    {
+        for (int precision = single ? 6 : 15; precision <= (single ? 9 : 17); ++precision)
+        {
+            len = snprintf(buffer, sizeof(buffer), "%.*g", precision, number);
+            double back = strtod(buffer, NULL);
+            if (single ? (float)back == (float)number : back == number) break;
+        }
+    }
+    cw_json_write(w, buffer, (size_t)len);
+}
+
+static void cw_json_write_string(cwJsonWriter* w, const char* src, size_t len)
+{
+    cw_json_write_char(w, '"');
+    size_t run = 0;
+    for (size_t i = 0; i < len; ++i)
+    {
+        uint8_t c = (uint8_t)src[i];
+        if (c >= 0x20 && c != '"' && c != '\\') continue;
+
+        cw_json_write(w, src + run, i - run);
+        run = i + 1;
+
+        char escape[8];
+        switch (c)
+        {
+        case '"':  cw_json_write(w, "\\\"", 2); break;
+        case '\\': cw_json_write(w, "\\\\", 2); break;
+        case '\n': cw_json_write(w, "\\n", 2);  break;
+        case '\r': cw_json_write(w, "\\r", 2);  break;
+        case '\t': cw_json_write(w, "\\t", 2);  break;
+        default:   cw_json_write(w, escape, (size_t)snprintf(escape, sizeof(escape), "\\u%04x", c)); break;
+        }
+    }
+    cw_json_write(w, src + run, len - run);
+    cw_json_write_char(w, '"');
+}
+
+static void cw_json_write_array(cwJsonWriter* w, const cwArray* array)
+{
+    cw_json_write_char(w, '[');
+    for (uint32_t i = 0; i < array->len; ++i)
+    {
+        if (i) cw_json_write_char(w, ',');
+        switch (array->type)
+        {
+        case ARRAY_INT32:   cw_json_write_number(w, ((const int32_t*)array->data)[i], false); break;
+        case ARRAY_FLOAT32: cw_json_write_number(w, ((const float*)array->data)[i], true);  break;
+        case ARRAY_FLOAT64: cw_json_write_number(w, ((const double*)array->data)[i], false); break;
+        }
+    }
+    cw_json_write_char(w, ']');
+}
+
+/* the element of a map that holds the indices "0" to count - 1, NULL if the map is not such an array */
+static cwValue* cw_json_map_element(const cwMap* map, uint32_t index)
+{
+    char key[16];
+    int len = snprintf(key, sizeof(key), "%u", index);
+    cwString* name = cw_table_find_key(&map->table, key, (size_t)len, cw_hash_str(key, (size_t)len));
+    return name ? cw_map_find(map, name, NULL) : NULL;
+}
+
+static bool cw_json_write_value(cwJsonWriter* w, cwValue value, int depth);
+
+static bool cw_json_write_map(cwJsonWriter* w, const cwMap* map, int depth)
+{
+    bool indexed = map->count > 0;
+    for (uint32_t i = 0; i < map->count && indexed; ++i) indexed = cw_json_map_element(map, i) != NULL;
+
+    if (indexed)
+    {
+        cw_json_write_char(w, '[');
+        for (uint32_t i = 0; i < map->count; ++i)
+        {
+            if (i) cw_json_write_char(w, ',');
+            if (!cw_json_write_value(w, *cw_json_map_element(map, i), depth + 1)) return false;
+        }
+        cw_json_write_char(w, ']');
+        return true;
+    }
+
+    cw_json_write_char(w, '{');
+    uint32_t position = 0;
+    cwString* key;
+    cwValue element;
+    for (bool first = true; cw_map_next(map, &position, &key, &element); first = false)
+    {
+        if (!first) cw_json_write_char(w, ',');
+        cw_json_write_string(w, key->raw, key->len);
+        cw_json_write_char(w, ':');
+        if (!cw_json_write_value(w, element, depth + 1)) return false;
+    }
+    cw_json_write_char(w, '}');
+    return true;
+}
+
+static bool cw_json_write_fields(cwJsonWriter* w, const cwShape* shape, const cwValue* fields, const cwRow* row, int depth)
+{
+    cw_json_write_char(w, '{');
+    for (int i = 0; i < shape->field_count; ++i)
+    {
+        cwValue field = MAKE_NULL();
+        if (fields) field = fields[i];
+        else        cw_row_get(row, i, &field);
+
+        if (i) cw_json_write_char(w, ',');
+        cw_json_write_string(w, shape->fields[i]->raw, shape->fields[i]->len);
+        cw_json_write_char(w, ':');
+        if (!cw_json_write_value(w, field, depth + 1)) return false;
+    }
+    cw_json_write_char(w, '}');
+    return true;
+}
+
+static bool cw_json_write_value(cwJsonWriter* w, cwValue value, int depth)
+{
+    if (depth >= CW_JSON_DEPTH_MAX)
+    {
+        w->error = "Values nest too deep for JSON.";
+        return false;
+    }
+
+    switch (value.type)
+    {
+    case VAL_NULL:  cw_json_write(w, "null", 4); return true;
+    case VAL_BOOL:  AS_BOOL(value) ? cw_json_write(w, "true", 4) : cw_json_write(w, "false", 5); return true;
+    case VAL_INT:   cw_json_write_number(w, AS_INT(value), false); return true;
+    case VAL_FLOAT: cw_json_write_number(w, AS_FLOAT(value), true); return true;
+    case VAL_OBJECT: break;
+    }
+
+    if (IS_STRING(value))
+    {
+        cw_json_write_string(w, AS_STRING(value)->raw, AS_STRING(value)->len);
+        return true;
+    }
+    if (IS_ARRAY(value))
+    {
+        cw_json_write_array(w, AS_ARRAY(value));
+        return true;
+    }
+    if (IS_MAP(value))    return cw_json_write_map(w, AS_MAP(value), depth);
+    if (IS_RECORD(value)) return cw_json_write_fields(w, AS_RECORD(value)->shape, AS_RECORD(value)->fields, NULL, depth);
+    if (IS_ROW(value))    return cw_json_write_fields(w, AS_ROW(value)->columns->shape, NULL, AS_ROW(value), depth);
+
+    w->error = "Only null, booleans, numbers, strings, arrays, maps and records convert to JSON.";
+    return false;
+}
+
+bool cw_json_stringify(cwRuntime* cw, cwValue value, cwString** result)
+{
+    cwJsonWriter writer = { NULL, 0, 0, NULL };
+    if (!cw_json_write_value(&writer, value, 0))
+    {
+        CW_FREE_ARRAY(char, writer.chars, writer.cap);
+        cw_runtime_error(cw, writer.error);
+        return false;
+    }
+
+    /* strings own a buffer of exactly their length and the terminator */
+    char* chars = CW_GROW_ARRAY(char, writer.chars, writer.cap, writer.len + 1);
+    chars[writer.len] = '\0';
+    *result = cw_str_take(cw, chars, writer.len);
+    return true;
+}
+
+/* --------------------------| streaming |----------------------------------------------- */
+typedef struct
+{
+    cwRuntime* cw;
+    cwRuntime fork;
+    cwJsonParser parser;
+    cwFunction* function;
+    uint32_t line;
+    uint32_t count;
+    bool stop;
+} cwJsonStream;
+
+static bool cw_json_blank(const char* src, size_t len)
+{
+    for (size_t i = 0; i < len; ++i)
+    {
+        if (src[i] != ' ' && src[i] != '\t' && src[i] != '\r') return false;
+    }
+    return true;
+}
+
+/* globals the function assigned are copied back to the caller, values of the line are exported first */
+static bool cw_json_write_back(cwJsonStream* s)
+{
+    const Table* globals = &s->fork.globals;
+    for (uint32_t i = 0; i < globals->capacity; ++i)
+    {
+        const TableEntry* entry = &globals->entries[i];
+        if (entry->key == NULL) continue;
+
+        cwValue value = entry->val;
+        if (!cw_export(&s->fork, &value)) return false;
+        cw_set_global(s->cw, entry->key, value);
+    }
+    return true;
+}
+
+static bool cw_json_stream_line(cwJsonStream* s, const char* src, size_t len)
+{
+    s->line++;
+    if (cw_json_blank(src, len)) return true;
+
+    /* the values and globals of the last line are gone before the next is parsed */
+    cw_reset(&s->fork, CW_RESET_HEAP);
+
+    cwValue value;
+    if (!cw_json_document(&s->parser, src, len, &value))
+    {
+        cw_runtime_error(s->cw, "Invalid JSON on line %u at column %zu: %s.", s->line, s->parser.error_at + 1, s->parser.error);
+        return false;
+    }
+
+    cwValue result;
+    if (cw_call_function(&s->fork, s->function, &value, 1, &result) != INTERPRET_OK)
+    {
+        cw_runtime_error(s->cw, "Line function failed on line %u.", s->line);
+        return false;
+    }
+
+    if (!cw_json_write_back(s))
+    {
+        cw_runtime_error(s->cw, "Line function failed on line %u.", s->line);
+        return false;
+    }
+
+    s->count++;
+    s->stop = IS_BOOL(result) && !AS_BOOL(result);
+    return true;
+}
+
+bool cw_json_lines(cwRuntime* cw, const char* path, cwFunction* function, uint32_t* count)
+{
+    if (function->arity != 1)
+    {
+        cw_runtime_error(cw, "Expected a function with one parameter.");
+        return false;
+    }
+
+    FILE* file = fopen(path, "rb");
+    if (!file)
+    {
+        cw_runtime_error(cw, "Could not open file \"%s\".", path);
+        return false;
+    }
+
+    cwJsonStream s = { .cw = cw, .function = function };
+    /* rows the function stores into containers of the caller are exported, see cw_check_write */
+    cw_fork(&s.fork, cw);
+    s.fork.host = cw;
+    cw_json_parser_init(&s.parser, &s.fork);
+
+    /* the buffer holds the start of a line cut off by the last read and grows only for longer lines */
+    size_t cap = CW_JSON_CHUNK;
+    size_t len = 0;
+    char* buffer = CW_ALLOCATE(char, cap);
+    bool ok = true;
+    bool eof = false;
+    while (ok && !eof && !s.stop)
+    {
+        if (len == cap)
+        {
+            buffer = CW_GROW_ARRAY(char, buffer, cap, cap * 2);
+            cap *= 2;
+        }
+
+        size_t read = fread(buffer + len, 1, cap - len, file);
+        if (read == 0 && ferror(file))
+        {
+            cw_runtime_error(cw, "Could not read file \"%s\".", path);
+            ok = false;
+            break;
+        }
+        eof = read == 0;
+        len += read;
+
+        size_t start = 0;
+        while (ok && !s.stop)
+        {
+            const char* newline = memchr(buffer + start, '\n', len - start);
+            if (!newline)
+            {
+                /* a last line without newline */
+                if (eof && start < len) ok = cw_json_stream_line(&s, buffer + start, len - start);
+                if (eof) start = len;
+                break;
+            }
+
+            size_t end = (size_t)(newline - buffer);
+            ok = cw_json_stream_line(&s, buffer + start, end - start);
+            start = end + 1;
+        }
+
+        memmove(buffer, buffer + start, len - start);
+        len -= start;
+    }
+
+    CW_FREE_ARRAY(char, buffer, cap);
+    fclose(file);
+    cw_json_parser_free(&s.parser);
+    cw_free(&s.fork);
+
+    *count = s.count;
+    return ok;
+}
@@ -0,0 +1,43 @@
+#ifndef CLOCKWORK_JSON_H
+#define CLOCKWORK_JSON_H
+
+#include "runtime.h"
+
+#define CW_JSON_DEPTH_MAX 1024          /* nesting of arrays and objects */
+#define CW_JSON_CHUNK     (1 << 20)     /* bytes read at a time when streaming */
+
+/*
+ * Parsing runs in two stages like simdjson. The first classifies 64 bytes
+ * at a time with SSE2 compares into bit masks of quotes, backslashes,
+ * structural characters and whitespace, finds escaped quotes and the
+ * inside of strings with carries and prefix xors over the masks, and
+ * collects the offsets of every structural character and every start of a
+ * value into an index. The second walks the index and builds the values
+ * straight into the heap of the runtime, without scanning for tokens.
+ *
+ * Objects become maps with interned keys. Arrays of numbers become int32
+ * arrays if all of them are integers and float64 arrays otherwise, other
+ * arrays become maps from the indices "0", "1", ... to the elements, which
+ * are written back as arrays. Numbers outside of arrays are ints if they
+ * are integers that fit and floats otherwise; a number too large for a
+ * float is an error there rather than infinity, which would be written
+ * back as null. Errors are runtime errors.
+ */
+bool cw_json_parse(cwRuntime* cw, const char* src, size_t len, cwValue* result);
+
+/* records are written as objects, values that have no JSON form are an error */
+bool cw_json_stringify(cwRuntime* cw, cwValue value, cwString** result);
+
+/*
+ * Streams a file of newline delimited JSON: every line is parsed into a
+ * fork of the runtime and passed to the function, whose heap is reset
+ * before the next line, so memory stays bounded by the longest line and
+ * the file can be larger than memory. Values of the line that the
+ * function keeps, by storing them into containers of the runtime or by
+ * assigning globals, are copied into the runtime (see cw_export). Blank
+ * lines are skipped and a function that returns false stops the stream.
+ * Counts the lines passed to the function.
+ */
+bool cw_json_lines(cwRuntime* cw, const char* path, cwFunction* function, uint32_t* count);
+
+#endif /* !CLOCKWORK_JSON_H */
@@ -0,0 +1,700 @@
+#include "kernels.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define CW_KERNELS_X86
+#include <immintrin.h>
+#endif
+
+/*
+ * Integer kernels compute in uint32_t and convert back, so they wrap around
+ * like the arithmetic of the VM instead of overflowing.
+ */
+
+/* --------------------------| scalar |-------------------------------------------------- */
+#define CW_TO_INT32(value)   AS_INT(value)
+#define CW_TO_FLOAT32(value) AS_FLOAT(value)
+#define CW_TO_FLOAT64(value) ((double)AS_FLOAT(value))
+
+#define CW_MAKE_INT32(acc)   MAKE_INT((int32_t)(acc))
+#define CW_MAKE_FLOAT32(acc) MAKE_FLOAT((float)(acc))
+#define CW_MAKE_FLOAT64(acc) MAKE_FLOAT((float)(acc))
+
+#define CW_SCALAR_KERNELS(name, type, acc_t, TO, MAKE)                                  \
+static cwValue cw_sum_##name(const void* a, size_t n)                                   \
+{                                                                                       \
+    const type* x = a;                                                                  \
+    acc_t acc = 0;                                                                      \
+    for (size_t i = 0; i < n; ++i) acc += (acc_t)x[i];                                  \
+    return MAKE(acc);                                                                   \
+}                                                                                       \
+                                                                                        \
+static cwValue cw_min_##name(const void* a, size_t n)                                   \
+{                                                                                       \
+    const type* x = a;                                                                  \
+    type m = x[0];                                                                      \
+    for (size_t i = 1; i < n; ++i) if (x[i] < m) m = x[i];                              \
+    return MAKE(m);                                                                     \
+}                                                                                       \
+                                                                                        \
+static cwValue cw_max_##name(const void* a, size_t n)                                   \
+{                                                                                       \
+    const type* x = a;                                                                  \
+    type m = x[0];                                                                      \
+    for (size_t i = 1; i < n; ++i) if (x[i] > m) m = x[i];                              \
+    return MAKE(m);                                                                     \
+}                                                                                       \
+                                                                                        \
+static cwValue cw_dot_##name(const void* a, const void* b, size_t n)                    \
+{                                                                                       \
+    const type* x = a;                                                                  \
+    const type* y = b;                                                                  \
+    acc_t acc = 0;                                                                      \
+    for (size_t i = 0; i < n; ++i) acc += (acc_t)x[i] * (acc_t)y[i];                    \
+    return MAKE(acc);                                                                   \
+}                                                                                       \
+                                                                                        \
+static void cw_add_##name(void* dst, const void* src, size_t n)                         \
+{                                                                                       \
+    type* x = dst;                                                                      \
+    const type* y = src;                                                                \
+    for (size_t i = 0; i < n; ++i) x[i] = (type)((acc_t)x[i] + (acc_t)y[i]);            \
+}                                                                                       \
+                                                                                        \
+static void cw_mul_##name(void* dst, const void* src, size_t n)                         \
+{                                                                                       \
+    type* x = dst;                                                                      \
+    const type* y = src;                                                                \
+    for (size_t i = 0; i < n; ++i) x[i] = (type)((acc_t)x[i] * (acc_t)y[i]);            \
+}                                                                                       \
+                                                                                        \
+static void cw_scale_##name(void* dst, cwValue factor, size_t n)                        \
+{                                                                                       \
+    type* x = dst;                                                                      \
+    acc_t f = (acc_t)TO(factor);                                                        \
+    for (size_t i = 0; i < n; ++i) x[i] = (type)((acc_t)x[i] * f);                      \
+}                                                                                       \
+                                                                                        \
+static void cw_fill_##name(void* dst, cwValue value, size_t n)                          \
+{                                                                                       \
+    type* x = dst;                                                                      \
+    type v = TO(value);                                                                 \
+    for (size_t i = 0; i < n; ++i) x[i] = v;                                            \
+}                                                                                       \
+                                                                                        \
+static void cw_compare_##name(const void* a, cwCompareOp op, cwValue value, int32_t* mask, size_t n) \
+{                                                                                       \
+    const type* x = a;                                                                  \
+    type v = TO(value);                                                                 \
+    switch (op)                                                                         \
+    {                                                                                   \
+    case COMPARE_LT: for (size_t i = 0; i < n; ++i) mask[i] = x[i] < v;  break;         \
+    case COMPARE_GT: for (size_t i = 0; i < n; ++i) mask[i] = x[i] > v;  break;         \
+    case COMPARE_EQ: for (size_t i = 0; i < n; ++i) mask[i] = x[i] == v; break;         \
+    }                                                                                   \
+}
+
+CW_SCALAR_KERNELS(i32, int32_t, uint32_t, CW_TO_INT32,   CW_MAKE_INT32)
+CW_SCALAR_KERNELS(f32, float,   float,    CW_TO_FLOAT32, CW_MAKE_FLOAT32)
+CW_SCALAR_KERNELS(f64, double,  double,   CW_TO_FLOAT64, CW_MAKE_FLOAT64)
+
+static const cwKernels cw_scalar_kernels[] = {
+    [ARRAY_INT32]   = { cw_sum_i32, cw_min_i32, cw_max_i32, cw_dot_i32, cw_add_i32, cw_mul_i32, cw_scale_i32, cw_fill_i32, cw_compare_i32 },
+    [ARRAY_FLOAT32] = { cw_sum_f32, cw_min_f32, cw_max_f32, cw_dot_f32, cw_add_f32, cw_mul_f32, cw_scale_f32, cw_fill_f32, cw_compare_f32 },
+    [ARRAY_FLOAT64] = { cw_sum_f64, cw_min_f64, cw_max_f64, cw_dot_f64, cw_add_f64, cw_mul_f64, cw_scale_f64, cw_fill_f64, cw_compare_f64 },
+};
+
+#ifdef CW_KERNELS_X86
+
+/*
+ * Vector kernels run the bulk of the elements through the vector loop and
+ * leave the rest, fewer than one vector, to the scalar kernel. Reductions
+ * keep two accumulators, so one addition does not wait for the previous.
+ */
+
+/* --------------------------| sse2 |---------------------------------------------------- */
+static float cw_hsum_ps(__m128 v)
+{
+    v = _mm_add_ps(v, _mm_movehl_ps(v, v));
+    v = _mm_add_ss(v, _mm_shuffle_ps(v, v, 1));
+    return _mm_cvtss_f32(v);
+}
+
+static int32_t cw_hsum_epi32(__m128i v)
+{
+    v = _mm_add_epi32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2)));
+    v = _mm_add_epi32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtsi128_si32(v);
+}
+
+static float cw_hmin_ps(__m128 v)
+{
+    v = _mm_min_ps(v, _mm_movehl_ps(v, v));
+    v = _mm_min_ss(v, _mm_shuffle_ps(v, v, 1));
+    return _mm_cvtss_f32(v);
+}
+
+static float cw_hmax_ps(__m128 v)
+{
+    v = _mm_max_ps(v, _mm_movehl_ps(v, v));
+    v = _mm_max_ss(v, _mm_shuffle_ps(v, v, 1));
+    return _mm_cvtss_f32(v);
+}
+
+static cwValue cw_sum_f32_sse2(const void* a, size_t n)
+{
+    const float* x = a;
+    __m128 acc0 = _mm_setzero_ps();
+    __m128 acc1 = _mm_setzero_ps();
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        acc0 = _mm_add_ps(acc0, _mm_loadu_ps(x + i));
+        acc1 = _mm_add_ps(acc1, _mm_loadu_ps(x + i + 4));
+    }
+    return MAKE_FLOAT(cw_hsum_ps(_mm_add_ps(acc0, acc1)) + AS_FLOAT(cw_sum_f32(x + i, n - i)));
+}
+
+static cwValue cw_min_f32_sse2(const void* a, size_t n)
+{
+    const float* x = a;
+    if (n < 4) return cw_min_f32(x, n);
+
+    __m128 m = _mm_loadu_ps(x);
+    size_t i = 4;
+    for (; i + 4 <= n; i += 4) m = _mm_min_ps(m, _mm_loadu_ps(x + i));
+
+    float result = cw_hmin_ps(m);
+    for (; i < n; ++i) if (x[i] < result) result = x[i];
+    return MAKE_FLOAT(result);
+}
+
+static cwValue cw_max_f32_sse2(const void* a, size_t n)
+{
+    const float* x = a;
+    if (n < 4) return cw_max_f32(x, n);
+
+    __m128 m = _mm_loadu_ps(x);
+    size_t i = 4;
+    for (; i + 4 <= n; i += 4) m = _mm_max_ps(m, _mm_loadu_ps(x + i));
+
+    float result = cw_hmax_ps(m);
+    for (; i < n; ++i) if (x[i] > result) result = x[i];
+    return MAKE_FLOAT(result);
+}
+
+static cwValue cw_dot_f32_sse2(const void* a, const void* b, size_t n)
+{
+    const float* x = a;
+    const float* y = b;
+    __m128 acc0 = _mm_setzero_ps();
+    __m128 acc1 = _mm_setzero_ps();
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_loadu_ps(x + i), _mm_loadu_ps(y + i)));
+        acc1 = _mm_add_ps(acc1, _mm_mul_ps(_mm_loadu_ps(x + i + 4), _mm_loadu_ps(y + i + 4)));
+    }
+    return MAKE_FLOAT(cw_hsum_ps(_mm_add_ps(acc0, acc1)) + AS_FLOAT(cw_dot_f32(x + i, y + i, n - i)));
+}
+
+static void cw_add_f32_sse2(void* dst, const void* src, size_t n)
+{
+    float* x = dst;
+    const float* y = src;
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) _mm_storeu_ps(x + i, _mm_add_ps(_mm_loadu_ps(x + i), _mm_loadu_ps(y + i)));
+    cw_add_f32(x + i, y + i, n - i);
+}
+
+static void cw_mul_f32_sse2(void* dst, const void* src, size_t n)
+{
+    float* x = dst;
+    const float* y = src;
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) _mm_storeu_ps(x + i, _mm_mul_ps(_mm_loadu_ps(x + i), _mm_loadu_ps(y + i)));
+    cw_mul_f32(x + i, y + i, n - i);
+}
+
+static void cw_scale_f32_sse2(void* dst, cwValue factor, size_t n)
+{
+    float* x = dst;
+    __m128 f = _mm_set1_ps(AS_FLOAT(factor));
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) _mm_storeu_ps(x + i, _mm_mul_ps(_mm_loadu_ps(x + i), f));
+    cw_scale_f32(x + i, factor, n - i);
+}
+
+static void cw_fill_f32_sse2(void* dst, cwValue value, size_t n)
+{
+    float* x = dst;
+    __m128 v = _mm_set1_ps(AS_FLOAT(value));
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) _mm_storeu_ps(x + i, v);
+    cw_fill_f32(x + i, value, n - i);
+}
+
+static void cw_compare_f32_sse2(const void* a, cwCompareOp op, cwValue value, int32_t* mask, size_t n)
+{
+    const float* x = a;
+    __m128 v = _mm_set1_ps(AS_FLOAT(value));
+    __m128i one = _mm_set1_epi32(1);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4)
+    {
+        __m128 e = _mm_loadu_ps(x + i);
+        __m128 m = op == COMPARE_LT ? _mm_cmplt_ps(e, v) : op == COMPARE_GT ? _mm_cmpgt_ps(e, v) : _mm_cmpeq_ps(e, v);
+        _mm_storeu_si128((__m128i*)(mask + i), _mm_and_si128(_mm_castps_si128(m), one));
+    }
+    cw_compare_f32(x + i, op, value, mask + i, n - i);
+}
+
+/* SSE2 has no 32 bit integer min, max and multiplication, those stay scalar */
+static cwValue cw_sum_i32_sse2(const void* a, size_t n)
+{
+    const int32_t* x = a;
+    __m128i acc0 = _mm_setzero_si128();
+    __m128i acc1 = _mm_setzero_si128();
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        acc0 = _mm_add_epi32(acc0, _mm_loadu_si128((const __m128i*)(x + i)));
+        acc1 = _mm_add_epi32(acc1, _mm_loadu_si128((const __m128i*)(x + i + 4)));
+    }
+    uint32_t sum = (uint32_t)cw_hsum_epi32(_mm_add_epi32(acc0, acc1)) + (uint32_t)AS_INT(cw_sum_i32(x + i, n - i));
+    return MAKE_INT((int32_t)sum);
+}
+
+static void cw_add_i32_sse2(void* dst, const void* src, size_t n)
+{
+    int32_t* x = dst;
+    const int32_t* y = src;
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4)
+    {
+        __m128i e = _mm_add_epi32(_mm_loadu_si128((const __m128i*)(x + i)), _mm_loadu_si128((const __m128i*)(y + i)));
+        _mm_storeu_si128((__m128i*)(x + i), e);
+    }
+    cw_add_i32(x + i, y + i, n - i);
+}
+
+static void cw_fill_i32_sse2(void* dst, cwValue value, size_t n)
+{
+    int32_t* x = dst;
+    __m128i v = _mm_set1_epi32(AS_INT(value));
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) _mm_storeu_si128((__m128i*)(x + i), v);
+    cw_fill_i32(x + i, value, n - i);
+}
+
+static void cw_compare_i32_sse2(const void* a, cwCompareOp op, cwValue value, int32_t* mask, size_t n)
+{
+    const int32_t* x = a;
+    __m128i v = _mm_set1_epi32(AS_INT(value));
+    __m128i one = _mm_set1_epi32(1);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4)
+    {
+        __m128i e = _mm_loadu_si128((const __m128i*)(x + i));
+        __m128i m = op == COMPARE_LT ? _mm_cmplt_epi32(e, v) : op == COMPARE_GT ? _mm_cmpgt_epi32(e, v) : _mm_cmpeq_epi32(e, v);
+        _mm_storeu_si128((__m128i*)(mask + i), _mm_and_si128(m, one));
+    }
+    cw_compare_i32(x + i, op, value, mask + i, n - i);
+}
+
+static const cwKernels cw_sse2_kernels[] = {
+    [ARRAY_INT32]   = { cw_sum_i32_sse2, cw_min_i32, cw_max_i32, cw_dot_i32, cw_add_i32_sse2, cw_mul_i32, cw_scale_i32, cw_fill_i32_sse2, cw_compare_i32_sse2 },
+    [ARRAY_FLOAT32] = { cw_sum_f32_sse2, cw_min_f32_sse2, cw_max_f32_sse2, cw_dot_f32_sse2, cw_add_f32_sse2, cw_mul_f32_sse2, cw_scale_f32_sse2, cw_fill_f32_sse2, cw_compare_f32_sse2 },
+    [ARRAY_FLOAT64] = { cw_sum_f64, cw_min_f64, cw_max_f64, cw_dot_f64, cw_add_f64, cw_mul_f64, cw_scale_f64, cw_fill_f64, cw_compare_f64 },
+};
+
+/* --------------------------| avx2 |---------------------------------------------------- */
+/* compiled for AVX2 on their own, the rest of the VM keeps the baseline instruction set */
+#define CW_AVX2 __attribute__((target("avx2")))
+
+CW_AVX2 static cwValue cw_sum_f32_avx2(const void* a, size_t n)
+{
+    const float* x = a;
+    __m256 acc0 = _mm256_setzero_ps();
+    __m256 acc1 = _mm256_setzero_ps();
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16)
+    {
+        acc0 = _mm256_add_ps(acc0, _mm256_loadu_ps(x + i));
+        acc1 = _mm256_add_ps(acc1, _mm256_loadu_ps(x + i + 8));
+    }
+    __m256 acc = _mm256_add_ps(acc0, acc1);
+    __m128 half = _mm_add_ps(_mm256_castps256_ps128(acc), _mm256_extractf128_ps(acc, 1));
+    return MAKE_FLOAT(cw_hsum_ps(half) + AS_FLOAT(cw_sum_f32(x + i, n - i)));
+}
+
+CW_AVX2 static cwValue cw_min_f32_avx2(const void* a, size_t n)
+{
+    const float* x = a;
+    if (n < 8) return cw_min_f32(x, n);
+
+    __m256 m = _mm256_loadu_ps(x);
+    size_t i = 8;
+    for (; i + 8 <= n; i += 8) m = _mm256_min_ps(m, _mm256_loadu_ps(x + i));
+
+    float result = cw_hmin_ps(_mm_min_ps(_mm256_castps256_ps128(m), _mm256_extractf128_ps(m, 1)));
+    for (; i < n; ++i) if (x[i] < result) result = x[i];
+    return MAKE_FLOAT(result);
+}
+
+CW_AVX2 static cwValue cw_max_f32_avx2(const void* a, size_t n)
+{
+    const float* x = a;
+    if (n < 8) return cw_max_f32(x, n);
+
+    __m256 m = _mm256_loadu_ps(x);
+    size_t i = 8;
+    for (; i + 8 <= n; i += 8) m = _mm256_max_ps(m, _mm256_loadu_ps(x + i));
+
+    float result = cw_hmax_ps(_mm_max_ps(_mm256_castps256_ps128(m), _mm256_extractf128_ps(m, 1)));
+    for (; i < n; ++i) if (x[i] > result) result = x[i];
+    return MAKE_FLOAT(result);
+}
+
+CW_AVX2 static cwValue cw_dot_f32_avx2(const void* a, const void* b, size_t n)
+{
+    const float* x = a;
+    const float* y = b;
+    __m256 acc0 = _mm256_setzero_ps();
+    __m256 acc1 = _mm256_setzero_ps();
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16)
+    {
+        acc0 = _mm256_add_ps(acc0, _mm256_mul_ps(_mm256_loadu_ps(x + i), _mm256_loadu_ps(y + i)));
+        acc1 = _mm256_add_ps(acc1, _mm256_mul_ps(_mm256_loadu_ps(x + i + 8), _mm256_loadu_ps(y + i + 8)));
+    }
+    __m256 acc = _mm256_add_ps(acc0, acc1);
+    __m128 half = _mm_add_ps(_mm256_castps256_ps128(acc), _mm256_extractf128_ps(acc, 1));
+    return MAKE_FLOAT(cw_hsum_ps(half) + AS_FLOAT(cw_dot_f32(x + i, y + i, n - i)));
+}
+
+CW_AVX2 static void cw_add_f32_avx2(void* dst, const void* src, size_t n)
+{
+    float* x = dst;
+    const float* y = src;
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) _mm256_storeu_ps(x + i, _mm256_add_ps(_mm256_loadu_ps(x + i), _mm256_loadu_ps(y + i)));
+    cw_add_f32(x + i, y + i, n - i);
+}
+
+CW_AVX2 static void cw_mul_f32_avx2(void* dst, const void* src, size_t n)
+{
+    float* x = dst;
+    const float* y = src;
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) _mm256_storeu_ps(x + i, _mm256_mul_ps(_mm256_loadu_ps(x + i), _mm256_loadu_ps(y + i)));
+    cw_mul_f32(x + i, y + i, n - i);
+}
+
+CW_AVX2 static void cw_scale_f32_avx2(void* dst, cwValue factor, size_t n)
+{
+    float* x = dst;
+    __m256 f = _mm256_set1_ps(AS_FLOAT(factor));
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) _mm256_storeu_ps(x + i, _mm256_mul_ps(_mm256_loadu_ps(x + i), f));
+    cw_scale_f32(x + i, factor, n - i);
+}
+
+CW_AVX2 static void cw_fill_f32_avx2(void* dst, cwValue value, size_t n)
+{
+    float* x = dst;
+    __m256 v = _mm256_set1_ps(AS_FLOAT(value));
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) _mm256_storeu_ps(x + i, v);
+    cw_fill_f32(x + i, value, n - i);
+}
+
+CW_AVX2 static void cw_compare_f32_avx2(const void* a, cwCompareOp op, cwValue value, int32_t* mask, size_t n)
+{
+    const float* x = a;
+    __m256 v = _mm256_set1_ps(AS_FLOAT(value));
+    __m256i one = _mm256_set1_epi32(1);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        __m256 e = _mm256_loadu_ps(x + i);
+        __m256 m;
+        switch (op)
+        {
+        case COMPARE_LT: m = _mm256_cmp_ps(e, v, _CMP_LT_OQ); break;
+        case COMPARE_GT: m = _mm256_cmp_ps(e, v, _CMP_GT_OQ); break;
+        default:         m = _mm256_cmp_ps(e, v, _CMP_EQ_OQ); break;
+        }
+        _mm256_storeu_si256((__m256i*)(mask + i), _mm256_and_si256(_mm256_castps_si256(m), one));
+    }
+    cw_compare_f32(x + i, op, value, mask + i, n - i);
+}
+
+CW_AVX2 static int32_t cw_hsum_epi32_avx2(__m256i v)
+{
+    return cw_hsum_epi32(_mm_add_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1)));
+}
+
+CW_AVX2 static cwValue cw_sum_i32_avx2(const void* a, size_t n)
+{
+    const int32_t* x = a;
+    __m256i acc0 = _mm256_setzero_si256();
+    __m256i acc1 = _mm256_setzero_si256();
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16)
+    {
+        acc0 = _mm256_add_epi32(acc0, _mm256_loadu_si256((const __m256i*)(x + i)));
+        acc1 = _mm256_add_epi32(acc1, _mm256_loadu_si256((const __m256i*)(x + i + 8)));
+    }
+    uint32_t sum = (uint32_t)cw_hsum_epi32_avx2(_mm256_add_epi32(acc0, acc1)) + (uint32_t)AS_INT(cw_sum_i32(x + i, n - i));
+    return MAKE_INT((int32_t)sum);
+}
+
+CW_AVX2 static cwValue cw_min_i32_avx2(const void* a, size_t n)
+{
+    const int32_t* x = a;
+    if (n < 8) return cw_min_i32(x, n);
+
+    __m256i m = _mm256_loadu_si256((const __m256i*)x);
+    size_t i = 8;
+    for (; i + 8 <= n; i += 8) m = _mm256_min_epi32(m, _mm256_loadu_si256((const __m256i*)(x + i)));
+
+    int32_t lanes[8];
+    _mm256_storeu_si256((__m256i*)lanes, m);
+    int32_t result = lanes[0];
+    for (int l = 1; l < 8; ++l) if (lanes[l] < result) result = lanes[l];
+    for (; i < n; ++i) if (x[i] < result) result = x[i];
+    return MAKE_INT(result);
+}
+
+CW_AVX2 static cwValue cw_max_i32_avx2(const void* a, size_t n)
+{
+    const int32_t* x = a;
+    if (n < 8) return cw_max_i32(x, n);
+
+    __m256i m = _mm256_loadu_si256((const __m256i*)x);
+    size_t i = 8;
+    for (; i + 8 <= n; i += 8) m = _mm256_max_epi32(m, _mm256_loadu_si256((const __m256i*)(x + i)));
+
+    int32_t lanes[8];
+    _mm256_storeu_si256((__m256i*)lanes, m);
+    int32_t result = lanes[0];
+    for (int l = 1; l < 8; ++l) if (lanes[l] > result) result = lanes[l];
+    for (; i < n; ++i) if (x[i] > result) result = x[i];
+    return MAKE_INT(result);
+}
+
+CW_AVX2 static cwValue cw_dot_i32_avx2(const void* a, const void* b, size_t n)
+{
+    const int32_t* x = a;
+    const int32_t* y = b;
+    __m256i acc = _mm256_setzero_si256();
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        __m256i p = _mm256_mullo_epi32(_mm256_loadu_si256((const __m256i*)(x + i)), _mm256_loadu_si256((const __m256i*)(y + i)));
+        acc = _mm256_add_epi32(acc, p);
+    }
+    uint32_t sum = (uint32_t)cw_hsum_epi32_avx2(acc) + (uint32_t)AS_INT(cw_dot_i32(x + i, y + i, n - i));
+    return MAKE_INT((int32_t)sum);
+}
+
+CW_AVX2 static void cw_add_i32_avx2(void* dst, const void* src, size_t n)
+{
+    int32_t* x = dst;
+    const int32_t* y = src;
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        __m256i e = _mm256_add_epi32(_mm256_loadu_si256((const __m256i*)(x + i)), _mm256_loadu_si256((const __m256i*)(y + i)));
+        _mm256_storeu_si256((__m256i*)(x + i), e);
+    }
+    cw_add_i32(x + i, y + i, n - i);
+}
+
+CW_AVX2 static void cw_mul_i32_avx2(void* dst, const void* src, size_t n)
+{
+    int32_t* x = dst;
+    const int32_t* y = src;
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        __m256i e = _mm256_mullo_epi32(_mm256_loadu_si256((const __m256i*)(x + i)), _mm256_loadu_si256((const __m256i*)(y + i)));
+        _mm256_storeu_si256((__m256i*)(x + i), e);
+    }
+    cw_mul_i32(x + i, y + i, n - i);
+}
+
+CW_AVX2 static void cw_scale_i32_avx2(void* dst, cwValue factor, size_t n)
+{
+    int32_t* x = dst;
+    __m256i f = _mm256_set1_epi32(AS_INT(factor));
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        __m256i e = _mm256_mullo_epi32(_mm256_loadu_si256((const __m256i*)(x + i)), f);
+        _mm256_storeu_si256((__m256i*)(x + i), e);
+    }
+    cw_scale_i32(x + i, factor, n - i);
+}
+
+CW_AVX2 static void cw_fill_i32_avx2(void* dst, cwValue value, size_t n)
+{
+    int32_t* x = dst;
+    __m256i v = _mm256_set1_epi32(AS_INT(value));
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) _mm256_storeu_si256((__m256i*)(x + i), v);
+    cw_fill_i32(x + i, value, n - i);
+}
+
+CW_AVX2 static void cw_compare_i32_avx2(const void* a, cwCompareOp op, cwValue value, int32_t* mask, size_t n)
+{
+    const int32_t* x = a;
+    __m256i v = _mm256_set1_epi32(AS_INT(value));
+    __m256i one = _mm256_set1_epi32(1);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        __m256i e = _mm256_loadu_si256((const __m256i*)(x + i));
+        __m256i m;
+        switch (op)
+        {
+        case COMPARE_LT: m = _mm256_cmpgt_epi32(v, e); break;
+        case COMPARE_GT: m = _mm256_cmpgt_epi32(e, v); break;
+        default:         m = _mm256_cmpeq_epi32(e, v); break;
+        }
+        _mm256_storeu_si256((__m256i*)(mask + i), _mm256_and_si256(m, one));
+    }
+    cw_compare_i32(x + i, op, value, mask + i, n - i);
+}
+
+CW_AVX2 static double cw_hsum_pd(__m256d v)
+{
+    __m128d h = _mm_add_pd(_mm256_castpd256_pd128(v), _mm256_extractf128_pd(v, 1));
+    return _mm_cvtsd_f64(_mm_add_sd(h, _mm_unpackhi_pd(h, h)));
+}
+
+CW_AVX2 static cwValue cw_sum_f64_avx2(const void* a, size_t n)
+{
+    const double* x = a;
+    __m256d acc0 = _mm256_setzero_pd();
+    __m256d acc1 = _mm256_setzero_pd();
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        acc0 = _mm256_add_pd(acc0, _mm256_loadu_pd(x + i));
+        acc1 = _mm256_add_pd(acc1, _mm256_loadu_pd(x + i + 4));
+    }
+    double sum = cw_hsum_pd(_mm256_add_pd(acc0, acc1));
+    for (; i < n; ++i) sum += x[i];
+    return MAKE_FLOAT((float)sum);
+}
+
+CW_AVX2 static cwValue cw_dot_f64_avx2(const void* a, const void* b, size_t n)
+{
+    const double* x = a;
+    const double* y = b;
+    __m256d acc0 = _mm256_setzero_pd();
+    __m256d acc1 = _mm256_setzero_pd();
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        acc0 = _mm256_add_pd(acc0, _mm256_mul_pd(_mm256_loadu_pd(x + i), _mm256_loadu_pd(y + i)));
+        acc1 = _mm256_add_pd(acc1, _mm256_mul_pd(_mm256_loadu_pd(x + i + 4), _mm256_loadu_pd(y + i + 4)));
+    }
+    double sum = cw_hsum_pd(_mm256_add_pd(acc0, acc1));
+    for (; i < n; ++i) sum += x[i] * y[i];
+    return MAKE_FLOAT((float)sum);
+}
+
+CW_AVX2 static void cw_add_f64_avx2(void* dst, const void* src, size_t n)
+{
+    double* x = dst;
+    const double* y = src;
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) _mm256_storeu_pd(x + i, _mm256_add_pd(_mm256_loadu_pd(x + i), _mm256_loadu_pd(y + i)));
+    cw_add_f64(x + i, y + i, n - i);
+}
+
+CW_AVX2 static void cw_mul_f64_avx2(void* dst, const void* src, size_t n)
+{
+    double* x = dst;
+    const double* y = src;
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) _mm256_storeu_pd(x + i, _mm256_mul_pd(_mm256_loadu_pd(x + i), _mm256_loadu_pd(y + i)));
+    cw_mul_f64(x + i, y + i, n - i);
+}
+
+CW_AVX2 static void cw_scale_f64_avx2(void* dst, cwValue factor, size_t n)
+{
+    double* x = dst;
+    __m256d f = _mm256_set1_pd(AS_FLOAT(factor));
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) _mm256_storeu_pd(x + i, _mm256_mul_pd(_mm256_loadu_pd(x + i), f));
+    cw_scale_f64(x + i, factor, n - i);
+}
+
+CW_AVX2 static void cw_fill_f64_avx2(void* dst, cwValue value, size_t n)
+{
+    double* x = dst;
+    __m256d v = _mm256_set1_pd(AS_FLOAT(value));
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) _mm256_storeu_pd(x + i, v);
+    cw_fill_f64(x + i, value, n - i);
+}
+
+/* min, max and compare of float64 are rare enough to stay scalar */
+static const cwKernels cw_avx2_kernels[] = {
+    [ARRAY_INT32]   = { cw_sum_i32_avx2, cw_min_i32_avx2, cw_max_i32_avx2, cw_dot_i32_avx2, cw_add_i32_avx2, cw_mul_i32_avx2, cw_scale_i32_avx2, cw_fill_i32_avx2, cw_compare_i32_avx2 },
+    [ARRAY_FLOAT32] = { cw_sum_f32_avx2, cw_min_f32_avx2, cw_max_f32_avx2, cw_dot_f32_avx2, cw_add_f32_avx2, cw_mul_f32_avx2, cw_scale_f32_avx2, cw_fill_f32_avx2, cw_compare_f32_avx2 },
+    [ARRAY_FLOAT64] = { cw_sum_f64_avx2, cw_min_f64, cw_max_f64, cw_dot_f64_avx2, cw_add_f64_avx2, cw_mul_f64_avx2, cw_scale_f64_avx2, cw_fill_f64_avx2, cw_compare_f64 },
+};
+
+#endif /* CW_KERNELS_X86 */
+
+/* --------------------------| dispatch |------------------------------------------------ */
+static const cwKernels* cw_kernels_select(const char** isa)
+{
+#ifdef CW_KERNELS_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+    {
+        *isa = "avx2";
+        return cw_avx2_kernels;
+    }
+    if (__builtin_cpu_supports("sse2"))
+    {
+        *isa = "sse2";
+        return cw_sse2_kernels;
+    }
+#endif
+    *isa = "scalar";
+    return cw_scalar_kernels;
+}
+
+/* every thread selects the same table, so racing on the first call is harmless */
+static const cwKernels* cw_selected;
+static const char* cw_selected_isa;
+
+static const cwKernels* cw_kernels_table(void)
+{
+    const cwKernels* table = CW_ATOMIC_LOAD(&cw_selected);
+    if (!table)
+    {
+        const char* isa;
+        table = cw_kernels_select(&isa);
+        CW_ATOMIC_STORE(&cw_selected_isa, isa);
+        CW_ATOMIC_STORE(&cw_selected, table);
+    }
+    return table;
+}
+
+const cwKernels* cw_kernels(cwArrayType type)
+{
+    return &cw_kernels_table()[type];
+}
+
+const char* cw_kernels_isa(void)
+{
+    cw_kernels_table();
+    return CW_ATOMIC_LOAD(&cw_selected_isa);
+}
@@ -0,0 +1,43 @@
+#ifndef CLOCKWORK_KERNELS_H
+#define CLOCKWORK_KERNELS_H
+
+#include "array.h"
+
+typedef enum
+{
+    COMPARE_LT,
+    COMPARE_GT,
+    COMPARE_EQ
+} cwCompareOp;
+
+/*
+ * Bulk operations on the elements of typed arrays. Every element type has a
+ * table of kernels; the tables are chosen once by the instruction sets the
+ * processor supports (AVX2, SSE2 or plain C), so a script pays one call
+ * instead of a dispatch per element. Kernels do not check anything: the
+ * arrays have the type of the table, binary kernels get arrays of the same
+ * length and min and max get at least one element. Vector kernels add in a
+ * different order than a loop would, so float sums can differ in the last
+ * bits from a sum computed element by element.
+ */
+typedef struct
+{
+    cwValue (*sum)(const void* a, size_t n);
+    cwValue (*min)(const void* a, size_t n);
+    cwValue (*max)(const void* a, size_t n);
+    cwValue (*dot)(const void* a, const void* b, size_t n);
+
+    /* in place on dst */
+    void (*add)(void* dst, const void* src, size_t n);
+    void (*mul)(void* dst, const void* src, size_t n);
+    void (*scale)(void* dst, cwValue factor, size_t n);
+    void (*fill)(void* dst, cwValue value, size_t n);
+
+    /* mask[i] is 1 where the comparison of a[i] with the value holds and 0 otherwise */
+    void (*compare)(const void* a, cwCompareOp op, cwValue value, int32_t* mask, size_t n);
+} cwKernels;
+
+const cwKernels* cw_kernels(cwArrayType type);
+const char*      cw_kernels_isa(void);
+
+#endif /* !CLOCKWORK_KERNELS_H */
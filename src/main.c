@@ -1,4 +1,6 @@
 #include "runtime.h"
+#include "snapshot.h"
+#include "embedded.h"
 #include "debug.h"
 
 #include <stdio.h>
@@ -70,20 +72,109 @@ static InterpretResult run_file(cwRuntime* cw, const char* path)
     return result;
 }
 
-int main(int argc, const char* argv[])
+/* compiles all files in parallel and runs them in order */
+static InterpretResult run_batch(cwRuntime* cw, int count, const char* paths[])
+{
+    char** sources = calloc(count, sizeof(char*));
+    cwFunction** functions = calloc(count, sizeof(cwFunction*));
+
+    InterpretResult result = INTERPRET_OK;
+    for (int i = 0; i < count && result == INTERPRET_OK; ++i)
+    {
+        sources[i] = read_file(paths[i]);
+        if (!sources[i]) result = INTERPRET_COMPILE_ERROR;
+    }
+
+    if (result == INTERPRET_OK && !cw_compile_batch(cw->engine, (const char* const*)sources, count, functions, 0))
+        result = INTERPRET_COMPILE_ERROR;
+
+    for (int i = 0; i < count && result == INTERPRET_OK; ++i)
+    {
+        result = cw_interpret_function(cw, functions[i]);
+    }
+
+    for (int i = 0; i < count; ++i) free(sources[i]);
+    free(sources);
+    free(functions);
+    return result;
+}
+
+/* runs the scripts that were precompiled into the executable */
+static InterpretResult run_embedded(cwRuntime* cw)
+{
+    for (size_t i = 0; i < cw_embedded_count; ++i)
+    {
+        InterpretResult result = cw_interpret_image(cw, cw_embedded[i].bytes, cw_embedded[i].len);
+        if (result != INTERPRET_OK)
+        {
+            fprintf(stderr, "Could not run embedded script \"%s\".\n", cw_embedded[i].name);
+            return result;
+        }
+    }
+    return INTERPRET_OK;
+}
+
+static void usage()
 {
-    cwRuntime cw = { 0 };
-    cw_init(&cw);
+    fprintf(stderr, "Usage: clockwork <path>\n");
+    fprintf(stderr, "       clockwork --save-snapshot <snapshot> <prelude>\n");
+    fprintf(stderr, "       clockwork --snapshot <snapshot> [path]\n");
+    fprintf(stderr, "       clockwork --batch <paths...>\n");
+    fprintf(stderr, "       clockwork --dispatch-stats <path>\n");
+}
 
+static int run(cwRuntime* cw, int argc, const char* argv[])
+{
     int status = 0;
     if (argc == 1) 
-        repl(&cw);
+        repl(cw);
     else if (argc == 2)
-        status = run_file(&cw, argv[1]);
+        status = run_file(cw, argv[1]);
+    else if (argc == 4 && strcmp(argv[1], "--save-snapshot") == 0)
+    {
+        status = run_file(cw, argv[3]);
+        if (status == INTERPRET_OK && !cw_snapshot_save(cw, argv[2]))
+        {
+            fprintf(stderr, "Could not write snapshot \"%s\".\n", argv[2]);
+            status = 1;
+        }
+    }
+    else if ((argc == 3 || argc == 4) && strcmp(argv[1], "--snapshot") == 0)
+    {
+        if (!cw_snapshot_load(cw, argv[2]))
+        {
+            fprintf(stderr, "Could not load snapshot \"%s\".\n", argv[2]);
+            status = 1;
+        }
+        else if (argc == 3) repl(cw);
+        else                status = run_file(cw, argv[3]);
+    }
+    else if (argc >= 3 && strcmp(argv[1], "--batch") == 0)
+        status = run_batch(cw, argc - 2, argv + 2);
+    else if (argc == 3 && strcmp(argv[1], "--dispatch-stats") == 0)
+    {
+        status = run_file(cw, argv[2]);
+        cw_print_dispatch_stats(cw->engine);
+    }
     else
-        fprintf(stderr, "Usage: clockwork <path>\n");
+        usage();
+
+    return status;
+}
+
+int main(int argc, const char* argv[])
+{
+    cwEngine engine;
+    cw_engine_init(&engine, NULL);
+
+    cwRuntime cw;
+    cw_init(&cw, &engine);
+
+    int status = run_embedded(&cw);
+    if (status == INTERPRET_OK) status = run(&cw, argc, argv);
 
     cw_free(&cw);
+    cw_engine_free(&engine);
 
     return status;
 }
\ No newline at end of file
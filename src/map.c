@@ -0,0 +1,71 @@
+#include "map.h"
+
+#include "memory.h"
+
+cwMap* cw_map_new(cwObject** objects, uint8_t depth)
+{
+    cwMap* map = (cwMap*)cw_object_alloc(objects, sizeof(cwMap), OBJ_MAP);
+    map->obj.depth = depth;
+    cw_table_init(&map->table);
+    map->count = 0;
+    return map;
+}
+
+void cw_map_free(cwMap* map)
+{
+    cw_table_free(&map->table);
+    cw_reallocate(map, sizeof(cwMap), 0);
+}
+
+cwValue* cw_map_find(const cwMap* map, const cwString* key, uint32_t* cache)
+{
+    const Table* table = &map->table;
+    if (cache)
+    {
+        uint32_t index = CW_ATOMIC_LOAD(cache);
+        if (index < table->capacity && table->entries[index].key == key) return &table->entries[index].val;
+    }
+
+    TableEntry* entry = cw_table_find_entry(table, key);
+    if (!entry) return NULL;
+
+    if (cache) CW_ATOMIC_STORE(cache, (uint32_t)(entry - table->entries));
+    return &entry->val;
+}
+
+void cw_map_set(cwMap* map, cwString* key, cwValue value, uint32_t* cache)
+{
+    cwValue* slot = cw_map_find(map, key, cache);
+    if (slot)
+    {
+        *slot = value;
+        return;
+    }
+
+    /* inserting may grow the table, the cache is filled by the next lookup */
+    cw_table_insert(&map->table, key, value);
+    map->count++;
+}
+
+bool cw_map_remove(cwMap* map, cwString* key)
+{
+    if (!cw_table_remove(&map->table, key)) return false;
+
+    map->count--;
+    return true;
+}
+
+bool cw_map_next(const cwMap* map, uint32_t* position, cwString** key, cwValue* value)
+{
+    for (uint32_t i = *position; i < map->table.capacity; ++i)
+    {
+        const TableEntry* entry = &map->table.entries[i];
+        if (!entry->key) continue;
+
+        *key = entry->key;
+        *value = entry->val;
+        *position = i + 1;
+        return true;
+    }
+    return false;
+}
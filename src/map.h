@@ -0,0 +1,40 @@
+#ifndef CLOCKWORK_MAP_H
+#define CLOCKWORK_MAP_H
+
+#include "table.h"
+
+/*
+ * Maps from strings to values of a runtime. Keys are interned, so they are
+ * usually found by identity; a runtime string that equals a literal
+ * compiled after it is another object and is found by its contents, the
+ * way cw_values_equal compares strings. Lookups can take an inline cache,
+ * which remembers the entry a key was found in last time: as long as the
+ * entry still holds the key the lookup does not hash or probe at all.
+ * Caches are shared by all runtimes running the same code, a stale or torn
+ * cache only costs a lookup.
+ */
+typedef struct
+{
+    cwObject obj;
+    Table table;
+    uint32_t count;     /* entries without tombstones */
+} cwMap;
+
+#define IS_MAP(value) cw_is_obj_type(value, OBJ_MAP)
+#define AS_MAP(value) ((cwMap*)AS_OBJECT(value))
+
+cwMap* cw_map_new(cwObject** objects, uint8_t depth);
+void   cw_map_free(cwMap* map);
+
+/* caches are optional */
+cwValue* cw_map_find(const cwMap* map, const cwString* key, uint32_t* cache);
+void     cw_map_set(cwMap* map, cwString* key, cwValue value, uint32_t* cache);
+bool     cw_map_remove(cwMap* map, cwString* key);
+
+/*
+ * Finds the first entry at or after position and moves the position past
+ * it, false if there is none. Entries added while iterating may be missed.
+ */
+bool cw_map_next(const cwMap* map, uint32_t* position, cwString** key, cwValue* value);
+
+#endif /* !CLOCKWORK_MAP_H */
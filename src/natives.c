@@ -0,0 +1,563 @@
+#include "natives.h"
+
+#include "array.h"
+#include "channel.h"
+#include "columns.h"
+#include "debug.h"
+#include "json.h"
+#include "kernels.h"
+#include "map.h"
+#include "runtime.h"
+#include "sort.h"
+
+/* --------------------------| coroutines |---------------------------------------------- */
+static bool cw_native_coroutine(cwRuntime* cw, int argc, cwValue* args, cwValue* result)
+{
+    if (!IS_FUNCTION(args[0]) || AS_FUNCTION(args[0])->arity > 1)
+    {
+        cw_runtime_error(cw, "Expected a function with at most one parameter.");
+        return false;
+    }
+
+    *result = MAKE_OBJECT(cw_coroutine_new(cw, AS_FUNCTION(args[0])));
+    return true;
+}
+
+static bool cw_native_done(cwRuntime* cw, int argc, cwValue* args, cwValue* result)
+{
+    if (!IS_COROUTINE(args[0]))
+    {
+        cw_runtime_error(cw, "Expected a coroutine.");
+        return false;
+    }
+
+    *result = MAKE_BOOL(AS_COROUTINE(args[0])->state == CO_DONE);
+    return true;
+}
+
+/* --------------------------| numbers |------------------------------------------------- */
+static bool cw_expect_numbers(cwRuntime* cw, cwValue* args)
+{
+    if (IS_NUMBER(args[0]) && IS_NUMBER(args[1])) return true;
+
+    cw_runtime_error(cw, "Operands must be numbers.");
+    return false;
+}
+
+static bool cw_expect_pair(cwRuntime* cw, int argc)
+{
+    if (argc == 2) return true;
+
+    cw_runtime_error(cw, "Expected an array or two numbers.");
+    return false;
+}
+
+/* --------------------------| bulk operations |----------------------------------------- */
+static bool cw_expect_array(cwRuntime* cw, cwValue value, bool writable)
+{
+    if (!IS_ARRAY(value))
+    {
+        cw_runtime_error(cw, "Expected an array.");
+        return false;
+    }
+
+    return !writable || cw_check_write(cw, value);
+}
+
+static bool cw_expect_matching(cwRuntime* cw, const cwArray* a, const cwArray* b)
+{
+    if (a->type == b->type && a->len == b->len) return true;
+
+    cw_runtime_error(cw, "Expected arrays of the same type and length.");
+    return false;
+}
+
+static bool cw_expect_number(cwRuntime* cw, cwValue value)
+{
+    if (IS_NUMBER(value)) return true;
+
+    cw_runtime_error(cw, "Operand must be a number.");
+    return false;
+}
+
+/* min and max of an empty array are null */
+static bool cw_reduce_array(cwRuntime* cw, cwValue value, cwReduceOp op, cwValue* result)
+{
+    if (!cw_expect_array(cw, value, false)) return false;
+
+    cwArray* array = AS_ARRAY(value);
+    const cwKernels* kernels = cw_kernels(array->type);
+    switch (op)
+    {
+    case REDUCE_SUM: *result = kernels->sum(array->data, array->len); break;
+    case REDUCE_MIN: *result = array->len ? kernels->min(array->data, array->len) : MAKE_NULL(); break;
+    case REDUCE_MAX: *result = array->len ? kernels->max(array->data, array->len) : MAKE_NULL(); break;
+    }
+    return true;
+}
+
+static bool cw_native_sum(cwRuntime* cw, int argc, cwValue* args, cwValue* result)
+{
+    return cw_reduce_array(cw, args[0], REDUCE_SUM, result);
+}
+
+static bool cw_native_dot(cwRuntime* cw, int argc, cwValue* args, cwValue* result)
+{
+    if (!cw_expect_array(cw, args[0], false) || !cw_expect_array(cw, args[1], false)) return false;
+
+    cwArray* a = AS_ARRAY(args[0]);
+    cwArray* b = AS_ARRAY(args[1]);
+    if (!cw_expect_matching(cw, a, b)) return false;
+
+    *result = cw_kernels(a->type)->dot(a->data, b->data, a->len);
+    return true;
+}
+
+/* elementwise operations work in place on the first array and return it */
+static bool cw_native_add(cwRuntime* cw, int argc, cwValue* args, cwValue* result)
+{
+    if (!cw_expect_array(cw, args[0], true) || !cw_expect_array(cw, args[1], false)) return false;
+
+    cwArray* a = AS_ARRAY(args[0]);
+    cwArray* b = AS_ARRAY(args[1]);
+    if (!cw_expect_matching(cw, a, b)) return false;
+
+    cw_kernels(a->type)->add(a->data, b->data, a->len);
+    *result = args[0];
+    return true;
+}
+
+static bool cw_native_mul(cwRuntime* cw, int argc, cwValue* args, cwValue* result)
+{
+    if (!cw_expect_array(cw, args[0], true) || !cw_expect_array(cw, args[1], false)) return false;
+
+    cwArray* a = AS_ARRAY(args[0]);
+    cwArray* b = AS_ARRAY(args[1]);
+    if (!cw_expect_matching(cw, a, b)) return false;
+
+    cw_kernels(a->type)->mul(a->data, b->data, a->len);
+    *result = args[0];
+    return true;
+}
+
+static bool cw_native_scale(cwRuntime* cw, int argc, cwValue* args, cwValue* result)
+{
+    if (!cw_expect_array(cw, args[0], true) || !cw_expect_number(cw, args[1])) return false;
+
+    cwArray* a = AS_ARRAY(args[0]);
+    cw_kernels(a->type)->scale(a->data, args[1], a->len);
+    *result = args[0];
+    return true;
+}
+
+static bool cw_native_fill(cwRuntime* cw, int argc, cwValue* args, cwValue* result)
+{
+    if (!cw_expect_array(cw, args[0], true) || !cw_expect_number(cw, args[1])) return false;
+
+    cwArray* a = AS_ARRAY(args[0]);
+    cw_kernels(a->type)->fill(a->data, args[1], a->len);
+    *result = args[0];
+    return true;
+}
+
+/* comparisons return a new int32 array with 1 where the comparison holds */
+static bool cw_compare_array(cwRuntime* cw, cwValue* args, cwCompareOp op, cwValue* result)
+{
+    if (!cw_expect_array(cw, args[0], false) || !cw_expect_number(cw, args[1])) return false;
+
+    cwArray* a = AS_ARRAY(args[0]);
+    cwArray* mask = cw_array_new(&cw->objects, cw->depth, ARRAY_INT32, a->len);
+    cw_kernels(a->type)->compare(a->data, op, args[1], mask->data, a->len);
+    *result = MAKE_OBJECT(mask);
+    return true;
+}
+
+static bool cw_native_lt(cwRuntime* cw, int argc, cwValue* args, cwValue* result) { return cw_compare_array(cw, args, COMPARE_LT, result); }
+static bool cw_native_gt(cwRuntime* cw, int argc, cwValue* args, cwValue* result) { return cw_compare_array(cw, args, COMPARE_GT, result); }
+static bool cw_native_eq(cwRuntime* cw, int argc, cwValue* args, cwValue* result) { return cw_compare_array(cw, args, COMPARE_EQ, result); }
+
+/* min and max compare two numbers or reduce an array */
+static bool cw_native_min(cwRuntime* cw, int argc, cwValue* args, cwValue* result)
+{
+    if (argc == 1) return cw_reduce_array(cw, args[0], REDUCE_MIN, result);
+    if (!cw_expect_pair(cw, argc) || !cw_expect_numbers(cw, args)) return false;
+
+    bool less = IS_INT(args[0]) && IS_INT(args[1]) ? AS_INT(args[1]) < AS_INT(args[0]) : AS_FLOAT(args[1]) < AS_FLOAT(args[0]);
+    *result = less ? args[1] : args[0];
+    return true;
+}
+
+static bool cw_native_max(cwRuntime* cw, int argc, cwValue* args, cwValue* result)
+{
+    if (argc == 1) return cw_reduce_array(cw, args[0], REDUCE_MAX, result);
+    if (!cw_expect_pair(cw, argc) || !cw_expect_numbers(cw, args)) return false;
+
+    bool greater = IS_INT(args[0]) && IS_INT(args[1]) ? AS_INT(args[1]) > AS_INT(args[0]) : AS_FLOAT(args[1]) > AS_FLOAT(args[0]);
+    *result = greater ? args[1] : args[0];
+    return true;
+}
+
+/* --------------------------| arrays |-------------------------------------------------- */
+static bool cw_new_array(cwRuntime* cw, cwValue len, cwArrayType type, cwValue* result)
+{
+    if (!IS_INT(len) || AS_INT(len) < 0)
+    {
+        cw_runtime_error(cw, "Expected a length that is not negative.");
+        return false;
+    }
+
+    *result = MAKE_OBJECT(cw_array_new(&cw->objects, cw->depth, type, (uint32_t)AS_INT(len)));
+    return true;
+}
+
+static bool cw_native_int32(cwRuntime* cw, int argc, cwValue* args, cwValue* result)
+{
+    return cw_new_array(cw, args[0], ARRAY_INT32, result);
+}
+
+static bool cw_native_float32(cwRuntime* cw, int argc, cwValue* args, cwValue* result)
+{
+    return cw_new_array(cw, args[0], ARRAY_FLOAT32, result);
+}
+
+static bool cw_native_float64(cwRuntime* cw, int argc, cwValue* args, cwValue* result)
+{
+    return cw_new_array(cw, args[0], ARRAY_FLOAT64, result);
+}
+
+static bool cw_native_len(cwRuntime* cw, int argc, cwValue* args, cwValue* result)
+{
+    if (IS_ARRAY(args[0]))        *result = MAKE_INT((int32_t)AS_ARRAY(args[0])->len);
+    else if (IS_STRING(args[0]))  *result = MAKE_INT((int32_t)AS_STRING(args[0])->len);
+    else if (IS_MAP(args[0]))     *result = MAKE_INT((int32_t)AS_MAP(args[0])->count);
+    else if (IS_COLUMNS(args[0])) *result = MAKE_INT((int32_t)cw_columns_len(AS_COLUMNS(args[0])));
+    else
+    {
+        cw_runtime_error(cw, "Expected an array, a map, columns or a string.");
+        return false;
+    }
+    return true;
+}
+
+static bool cw_native_push(cwRuntime* cw, int argc, cwValue* args, cwValue* result)
+{
+    if (IS_COLUMNS(args[0]))
+    {
+        cwColumns* columns = AS_COLUMNS(args[0]);
+        if (!cw_check_write(cw, args[0])) return false;
+        if (IS_RECORD(args[1]) && cw_columns_push(columns, AS_RECORD(args[1]))) return true;
+
+        cw_runtime_error(cw, "Expected a %s with numbers in every field.", columns->shape->name->raw);
+        return false;
+    }
+
+    if (!cw_expect_array(cw, args[0], true)) return false;
+
+    if (!IS_NUMBER(args[1]))
+    {
+        cw_runtime_error(cw, "Array elements must be numbers.");
+        return false;
+    }
+
+    cw_array_push(AS_ARRAY(args[0]), args[1]);
+    return true;
+}
+
+/* --------------------------| columns |------------------------------------------------- */
+/* columns(Point, len) holds float32 columns, columns(Point, len, int32) another type of array */
+static bool cw_native_columns(cwRuntime* cw, int argc, cwValue* args, cwValue* result)
+{
+    if (argc != 2 && argc != 3)
+    {
+        cw_runtime_error(cw, "Expected a datatype, a length and optionally an array type.");
+        return false;
+    }
+
+    if (!IS_SHAPE(args[0]))
+    {
+        cw_runtime_error(cw, "Expected a datatype.");
+        return false;
+    }
+
+    if (!IS_INT(args[1]) || AS_INT(args[1]) < 0)
+    {
+        cw_runtime_error(cw, "Expected a length that is not negative.");
+        return false;
+    }
+
+    cwArrayType type = ARRAY_FLOAT32;
+    if (argc == 3)
+    {
+        cwNativeFn fn = IS_NATIVE(args[2]) ? AS_NATIVE(args[2])->fn : NULL;
+        if (fn == cw_native_int32)        type = ARRAY_INT32;
+        else if (fn == cw_native_float32) type = ARRAY_FLOAT32;
+        else if (fn == cw_native_float64) type = ARRAY_FLOAT64;
+        else
+        {
+            cw_runtime_error(cw, "Expected int32, float32 or float64 as the array type.");
+            return false;
+        }
+    }
+
+    *result = MAKE_OBJECT(cw_columns_new(&cw->objects, cw->depth, AS_SHAPE(args[0]), type, (uint32_t)AS_INT(args[1])));
+    return true;
+}
+
+/* --------------------------| sorting |------------------------------------------------- */
+/* sort(a) orders by value, sort(a, fn) by the keys or comparisons of a function */
+static bool cw_sort(cwRuntime* cw, int argc, cwValue* args, bool stable)
+{
+    if (argc != 1 && argc != 2)
+    {
+        cw_runtime_error(cw, "Expected an array and optionally a function.");
+        return false;
+    }
+    if (!cw_expect_array(cw, args[0], true)) return false;
+
+    if (argc == 1)
+    {
+        cw_sort_array(cw->engine, AS_ARRAY(args[0]));
+        return true;
+    }
+
+    if (!IS_FUNCTION(args[1]))
+    {
+        cw_runtime_error(cw, "Expected a function to sort by.");
+        return false;
+    }
+    return cw_sort_by(cw, AS_ARRAY(args[0]), AS_FUNCTION(args[1]), stable);
+}
+
+static bool cw_native_sort(cwRuntime* cw, int argc, cwValue* args, cwValue* result)
+{
+    return cw_sort(cw, argc, args, false);
+}
+
+static bool cw_native_stable_sort(cwRuntime* cw, int argc, cwValue* args, cwValue* result)
+{
+    return cw_sort(cw, argc, args, true);
+}
+
+static bool cw_native_search(cwRuntime* cw, int argc, cwValue* args, cwValue* result)
+{
+    if (!cw_expect_array(cw, args[0], false) || !cw_expect_number(cw, args[1])) return false;
+
+    *result = MAKE_INT((int32_t)cw_array_search(AS_ARRAY(args[0]), args[1]));
+    return true;
+}
+
+/* partition(a, pivot) or partition(a, fn) returns the length of the front */
+static bool cw_native_partition(cwRuntime* cw, int argc, cwValue* args, cwValue* result)
+{
+    if (!cw_expect_array(cw, args[0], true)) return false;
+    if (!IS_NUMBER(args[1]) && !IS_FUNCTION(args[1]))
+    {
+        cw_runtime_error(cw, "Expected a number or a function to partition by.");
+        return false;
+    }
+
+    uint32_t count;
+    if (!cw_partition(cw, AS_ARRAY(args[0]), args[1], &count)) return false;
+
+    *result = MAKE_INT((int32_t)count);
+    return true;
+}
+
+/* --------------------------| maps |---------------------------------------------------- */
+static bool cw_expect_map_key(cwRuntime* cw, cwValue* args)
+{
+    if (!IS_MAP(args[0]))
+    {
+        cw_runtime_error(cw, "Expected a map.");
+        return false;
+    }
+
+    if (!IS_STRING(args[1]))
+    {
+        cw_runtime_error(cw, "Map keys must be strings.");
+        return false;
+    }
+    return true;
+}
+
+static bool cw_native_has(cwRuntime* cw, int argc, cwValue* args, cwValue* result)
+{
+    if (!cw_expect_map_key(cw, args)) return false;
+
+    *result = MAKE_BOOL(cw_map_find(AS_MAP(args[0]), AS_STRING(args[1]), NULL) != NULL);
+    return true;
+}
+
+/* true if the key was in the map */
+static bool cw_native_remove(cwRuntime* cw, int argc, cwValue* args, cwValue* result)
+{
+    if (!cw_expect_map_key(cw, args) || !cw_check_write(cw, args[0])) return false;
+
+    *result = MAKE_BOOL(cw_map_remove(AS_MAP(args[0]), AS_STRING(args[1])));
+    return true;
+}
+
+/* --------------------------| json |---------------------------------------------------- */
+static bool cw_native_json_parse(cwRuntime* cw, int argc, cwValue* args, cwValue* result)
+{
+    if (!IS_STRING(args[0]))
+    {
+        cw_runtime_error(cw, "Expected a string of JSON.");
+        return false;
+    }
+    return cw_json_parse(cw, AS_STRING(args[0])->raw, AS_STRING(args[0])->len, result);
+}
+
+static bool cw_native_json_stringify(cwRuntime* cw, int argc, cwValue* args, cwValue* result)
+{
+    cwString* str;
+    if (!cw_json_stringify(cw, args[0], &str)) return false;
+
+    *result = MAKE_OBJECT(str);
+    return true;
+}
+
+/* json_lines(path, fn) calls fn with the value of every line and returns how many there were */
+static bool cw_native_json_lines(cwRuntime* cw, int argc, cwValue* args, cwValue* result)
+{
+    if (!IS_STRING(args[0]) || !IS_FUNCTION(args[1]))
+    {
+        cw_runtime_error(cw, "Expected a path and a function.");
+        return false;
+    }
+
+    uint32_t count;
+    if (!cw_json_lines(cw, AS_STRING(args[0])->raw, AS_FUNCTION(args[1]), &count)) return false;
+
+    *result = MAKE_INT((int32_t)count);
+    return true;
+}
+
+/* --------------------------| freezing |------------------------------------------------ */
+static bool cw_native_freeze(cwRuntime* cw, int argc, cwValue* args, cwValue* result)
+{
+    return cw_freeze(cw, args[0], result);
+}
+
+static bool cw_native_frozen(cwRuntime* cw, int argc, cwValue* args, cwValue* result)
+{
+    *result = MAKE_BOOL(cw_is_frozen(args[0]));
+    return true;
+}
+
+/* --------------------------| channels |------------------------------------------------ */
+static bool cw_native_channel(cwRuntime* cw, int argc, cwValue* args, cwValue* result)
+{
+    if (!IS_INT(args[0]) || AS_INT(args[0]) < 1 || AS_INT(args[0]) > CW_CHANNEL_CAPACITY_MAX)
+    {
+        cw_runtime_error(cw, "Expected a capacity between 1 and %d.", CW_CHANNEL_CAPACITY_MAX);
+        return false;
+    }
+
+    *result = MAKE_OBJECT(cw_channel_new(cw->engine, (size_t)AS_INT(args[0])));
+    return true;
+}
+
+static bool cw_expect_channel(cwRuntime* cw, cwValue value)
+{
+    if (IS_CHANNEL(value)) return true;
+
+    cw_runtime_error(cw, "Expected a channel.");
+    return false;
+}
+
+static bool cw_native_try_send(cwRuntime* cw, int argc, cwValue* args, cwValue* result)
+{
+    if (!cw_expect_channel(cw, args[0])) return false;
+
+    bool sent;
+    if (!cw_channel_try_send(cw, AS_CHANNEL(args[0]), args[1], &sent)) return false;
+
+    *result = MAKE_BOOL(sent);
+    return true;
+}
+
+/* null if the channel is empty */
+static bool cw_native_try_recv(cwRuntime* cw, int argc, cwValue* args, cwValue* result)
+{
+    if (!cw_expect_channel(cw, args[0])) return false;
+
+    cw_channel_try_recv(cw, AS_CHANNEL(args[0]), result);
+    return true;
+}
+
+/* blocking operations give up the thread and suspend a fiber until it resumes */
+static bool cw_native_send(cwRuntime* cw, int argc, cwValue* args, cwValue* result)
+{
+    if (!cw_expect_channel(cw, args[0])) return false;
+
+    bool sent;
+    while (true)
+    {
+        if (!cw_channel_try_send(cw, AS_CHANNEL(args[0]), args[1], &sent)) return false;
+        if (sent) return true;
+
+        /* nothing can be sent until a receiver runs */
+        cw_thread_yield();
+        if (cw_block(cw)) return true;
+    }
+}
+
+static bool cw_native_recv(cwRuntime* cw, int argc, cwValue* args, cwValue* result)
+{
+    if (!cw_expect_channel(cw, args[0])) return false;
+
+    while (!cw_channel_try_recv(cw, AS_CHANNEL(args[0]), result))
+    {
+        cw_thread_yield();
+        if (cw_block(cw)) return true;
+    }
+    return true;
+}
+
+void cw_define_natives(cwEngine* engine)
+{
+    cw_define_native(engine, "coroutine", cw_native_coroutine, 1);
+    cw_define_native(engine, "done",      cw_native_done,      1);
+
+    cw_define_native(engine, "min",       cw_native_min,       -1);
+    cw_define_native(engine, "max",       cw_native_max,       -1);
+
+    cw_define_native(engine, "int32",     cw_native_int32,     1);
+    cw_define_native(engine, "float32",   cw_native_float32,   1);
+    cw_define_native(engine, "float64",   cw_native_float64,   1);
+    cw_define_native(engine, "len",       cw_native_len,       1);
+    cw_define_native(engine, "push",      cw_native_push,      2);
+    cw_define_native(engine, "columns",   cw_native_columns,   -1);
+
+    cw_define_native(engine, "sort",        cw_native_sort,        -1);
+    cw_define_native(engine, "stable_sort", cw_native_stable_sort, -1);
+    cw_define_native(engine, "search",      cw_native_search,      2);
+    cw_define_native(engine, "partition",   cw_native_partition,   2);
+
+    cw_define_native(engine, "sum",       cw_native_sum,       1);
+    cw_define_native(engine, "dot",       cw_native_dot,       2);
+    cw_define_native(engine, "add",       cw_native_add,       2);
+    cw_define_native(engine, "mul",       cw_native_mul,       2);
+    cw_define_native(engine, "scale",     cw_native_scale,     2);
+    cw_define_native(engine, "fill",      cw_native_fill,      2);
+    cw_define_native(engine, "lt",        cw_native_lt,        2);
+    cw_define_native(engine, "gt",        cw_native_gt,        2);
+    cw_define_native(engine, "eq",        cw_native_eq,        2);
+
+    cw_define_native(engine, "has",       cw_native_has,       2);
+    cw_define_native(engine, "remove",    cw_native_remove,    2);
+
+    cw_define_native(engine, "json_parse",     cw_native_json_parse,     1);
+    cw_define_native(engine, "json_stringify", cw_native_json_stringify, 1);
+    cw_define_native(engine, "json_lines",     cw_native_json_lines,     2);
+
+    cw_define_native(engine, "freeze",    cw_native_freeze,    1);
+    cw_define_native(engine, "frozen",    cw_native_frozen,    1);
+
+    cw_define_native(engine, "channel",   cw_native_channel,   1);
+    cw_define_native(engine, "send",      cw_native_send,      2);
+    cw_define_native(engine, "recv",      cw_native_recv,      1);
+    cw_define_native(engine, "try_send",  cw_native_try_send,  2);
+    cw_define_native(engine, "try_recv",  cw_native_try_recv,  1);
+}
@@ -0,0 +1,9 @@
+#ifndef CLOCKWORK_NATIVES_H
+#define CLOCKWORK_NATIVES_H
+
+#include "common.h"
+
+/* defines the builtin natives of an engine (see cw_define_native) */
+void cw_define_natives(cwEngine* engine);
+
+#endif /* !CLOCKWORK_NATIVES_H */
@@ -0,0 +1,111 @@
+#include "parallel.h"
+
+#include "debug.h"
+#include "memory.h"
+#include "scheduler.h"
+
+/* sums start at zero, minimum and maximum can start with the current value */
+static cwValue cw_reduction_init(cwReduceOp op, cwValue value)
+{
+    return op == REDUCE_SUM ? MAKE_INT(0) : value;
+}
+
+static bool cw_reduction_less(cwValue a, cwValue b)
+{
+    if (IS_INT(a) && IS_INT(b)) return AS_INT(a) < AS_INT(b);
+    return AS_FLOAT(a) < AS_FLOAT(b);
+}
+
+static bool cw_reduce(cwReduceOp op, cwValue* acc, cwValue value)
+{
+    if (!IS_NUMBER(*acc) || !IS_NUMBER(value)) return false;
+
+    switch (op)
+    {
+    case REDUCE_SUM: cw_value_add(acc, &value); break;
+    case REDUCE_MIN: if (cw_reduction_less(value, *acc)) *acc = value; break;
+    case REDUCE_MAX: if (cw_reduction_less(*acc, value)) *acc = value; break;
+    }
+    return true;
+}
+
+bool cw_parallel_for(cwRuntime* cw, cwFunction* body, cwValue* args, cwString* const* names, const uint8_t* ops, int count)
+{
+    if (!IS_INT(args[0]) || !IS_INT(args[1]))
+    {
+        cw_runtime_error(cw, "Range bounds must be integers.");
+        return false;
+    }
+
+    int32_t start = AS_INT(args[0]);
+    int32_t end = AS_INT(args[1]);
+    cwValue* values = args + 2;
+    if (end <= start)
+    {
+        for (int i = 0; i < count; ++i) args[i] = values[i];
+        return true;
+    }
+
+    cwScheduler* scheduler = cw_engine_scheduler(cw->engine);
+    int64_t length = (int64_t)end - start;
+    int blocks = scheduler->worker_count * CW_PARALLEL_SPLIT;
+    if (blocks > length) blocks = (int)length;
+
+    cwJob* jobs = CW_ALLOCATE(cwJob, blocks);
+    cwRuntime* runtimes = CW_ALLOCATE(cwRuntime, blocks);
+    for (int b = 0; b < blocks; ++b)
+    {
+        cwValue range[2] = {
+            MAKE_INT((int32_t)(start + length * b / blocks)),
+            MAKE_INT((int32_t)(start + length * (b + 1) / blocks))
+        };
+
+        /*
+         * reduction variables are globals of the fork, so writes never reach the caller,
+         * and blocks can only set elements of shared arrays, so no object of a fork escapes
+         */
+        cwRuntime* fork = &runtimes[b];
+        cw_fork(fork, cw);
+        fork->shared_arrays = true;
+        for (int i = 0; i < count; ++i)
+            cw_table_insert(&fork->globals, names[i], cw_reduction_init(ops[i], values[i]));
+
+        cwJob* job = &jobs[b];
+        cw_job_init(job, body, range, 2);
+        job->runtime = fork;
+        if (!cw_prepare_call(fork, body, range, 2)) job->status = INTERPRET_RUNTIME_ERROR;
+    }
+
+    for (int b = 0; b < blocks; ++b)
+    {
+        if (jobs[b].status == INTERPRET_OK) cw_scheduler_spawn(scheduler, &jobs[b]);
+    }
+
+    /* combined in the order of the blocks, so float sums do not depend on the timing */
+    const char* error = NULL;
+    for (int b = 0; b < blocks; ++b)
+    {
+        cwJob* job = &jobs[b];
+        if (job->status == INTERPRET_OK) cw_scheduler_await(scheduler, job);
+        if (job->status != INTERPRET_OK && !error) error = "Parallel loop failed.";
+
+        for (int i = 0; i < count && !error; ++i)
+        {
+            cwValue* value = cw_table_find(&runtimes[b].globals, names[i]);
+            if (!cw_reduce(ops[i], &values[i], *value)) error = "Reduction variables must be numbers.";
+        }
+    }
+
+    for (int b = 0; b < blocks; ++b) cw_free(&runtimes[b]);
+    CW_FREE_ARRAY(cwRuntime, runtimes, blocks);
+    CW_FREE_ARRAY(cwJob, jobs, blocks);
+
+    if (error)
+    {
+        cw_runtime_error(cw, error);
+        return false;
+    }
+
+    for (int i = 0; i < count; ++i) args[i] = values[i];
+    return true;
+}
@@ -0,0 +1,19 @@
+#ifndef CLOCKWORK_PARALLEL_H
+#define CLOCKWORK_PARALLEL_H
+
+#include "runtime.h"
+
+#define CW_PARALLEL_SPLIT 4 /* blocks per worker, so stealing can even out the load */
+
+/*
+ * Runs the body of a parallel loop (see cw_parse_stmt_parallel) for the
+ * range in args[0] and args[1]. The range is split into blocks that run as
+ * fibers on the scheduler of the engine, each in a fork of the calling
+ * runtime that starts with its own copy of the reduction variables. The
+ * current values of the reduction variables follow the range in args and
+ * are replaced by the combined values. The calling runtime waits for all
+ * blocks and must not run anything else in the meantime.
+ */
+bool cw_parallel_for(cwRuntime* cw, cwFunction* body, cwValue* args, cwString* const* names, const uint8_t* ops, int count);
+
+#endif /* !CLOCKWORK_PARALLEL_H */
@@ -1,12 +1,14 @@
 #include "parser.h"
 
+#include <string.h>
+
 #include "statement.h"
 
 #include "debug.h"
 #include "runtime.h"
 
 /* --------------------------| parse rules |--------------------------------------------- */
-typedef void (*ParseCallback)(cwRuntime* cw, bool can_assign);
+typedef void (*ParseCallback)(cwCompiler* c, bool can_assign);
 
 typedef struct
 {
@@ -15,24 +17,33 @@ typedef struct
     Precedence precedence;
 } ParseRule;
 
-static void cw_parse_integer(cwRuntime* cw, bool can_assign);
-static void cw_parse_float(cwRuntime* cw, bool can_assign);
-static void cw_parse_string(cwRuntime* cw, bool can_assign);
-static void cw_parse_grouping(cwRuntime* cw, bool can_assign);
-static void cw_parse_unary(cwRuntime* cw, bool can_assign);
-static void cw_parse_binary(cwRuntime* cw, bool can_assign);
-static void cw_parse_and(cwRuntime* cw, bool can_assign);
-static void cw_parse_or(cwRuntime* cw, bool can_assign);
-static void cw_parse_literal(cwRuntime* cw, bool can_assign);
-static void cw_parse_variable(cwRuntime* cw, bool can_assign);
+static void cw_parse_integer(cwCompiler* c, bool can_assign);
+static void cw_parse_float(cwCompiler* c, bool can_assign);
+static void cw_parse_string(cwCompiler* c, bool can_assign);
+static void cw_parse_grouping(cwCompiler* c, bool can_assign);
+static void cw_parse_unary(cwCompiler* c, bool can_assign);
+static void cw_parse_binary(cwCompiler* c, bool can_assign);
+static void cw_parse_and(cwCompiler* c, bool can_assign);
+static void cw_parse_or(cwCompiler* c, bool can_assign);
+static void cw_parse_literal(cwCompiler* c, bool can_assign);
+static void cw_parse_variable(cwCompiler* c, bool can_assign);
+static void cw_parse_call(cwCompiler* c, bool can_assign);
+static void cw_parse_resume(cwCompiler* c, bool can_assign);
+static void cw_parse_yield(cwCompiler* c, bool can_assign);
+static void cw_parse_array(cwCompiler* c, bool can_assign);
+static void cw_parse_index(cwCompiler* c, bool can_assign);
+static void cw_parse_dot(cwCompiler* c, bool can_assign);
+static void cw_parse_map(cwCompiler* c, bool can_assign);
 
 ParseRule rules[] = {
     [TOKEN_EOF]         = { NULL,               NULL,               PREC_NONE },
-    [TOKEN_LPAREN]      = { cw_parse_grouping,  NULL,               PREC_NONE },
+    [TOKEN_LPAREN]      = { cw_parse_grouping,  cw_parse_call,      PREC_CALL },
     [TOKEN_RPAREN]      = { NULL,               NULL,               PREC_NONE },
-    [TOKEN_LBRACE]      = { NULL,               NULL,               PREC_NONE }, 
+    [TOKEN_LBRACE]      = { cw_parse_map,       NULL,               PREC_NONE },
     [TOKEN_RBRACE]      = { NULL,               NULL,               PREC_NONE },
-    [TOKEN_PERIOD]      = { NULL,               NULL,               PREC_NONE },
+    [TOKEN_LBRACKET]    = { cw_parse_array,     cw_parse_index,     PREC_CALL },
+    [TOKEN_RBRACKET]    = { NULL,               NULL,               PREC_NONE },
+    [TOKEN_PERIOD]      = { NULL,               cw_parse_dot,       PREC_CALL },
     [TOKEN_COMMA]       = { NULL,               NULL,               PREC_NONE },
     [TOKEN_COLON]       = { NULL,               NULL,               PREC_NONE },
     [TOKEN_SEMICOLON]   = { NULL,               NULL,               PREC_NONE },
@@ -44,6 +55,7 @@ ParseRule rules[] = {
     [TOKEN_ASSIGN]      = { NULL,               NULL,               PREC_NONE },
     [TOKEN_AND]         = { NULL,               cw_parse_and,       PREC_AND },
     [TOKEN_OR]          = { NULL,               cw_parse_or,        PREC_OR },
+    [TOKEN_RANGE]       = { NULL,               NULL,               PREC_NONE },
     // Comparison tokens.
     [TOKEN_EQ]          = { NULL,               cw_parse_binary,    PREC_EQUALITY },
     [TOKEN_NOTEQ]       = { NULL,               cw_parse_binary,    PREC_EQUALITY },
@@ -69,188 +81,416 @@ ParseRule rules[] = {
     [TOKEN_DATATYPE]    = { NULL,               NULL,               PREC_NONE },
     [TOKEN_RETURN]      = { NULL,               NULL,               PREC_NONE },
     [TOKEN_PRINT]       = { NULL,               NULL,               PREC_NONE },
+    [TOKEN_RESUME]      = { cw_parse_resume,    NULL,               PREC_NONE },
+    [TOKEN_YIELD]       = { cw_parse_yield,     NULL,               PREC_NONE },
+    [TOKEN_IN]          = { NULL,               NULL,               PREC_NONE },
+    [TOKEN_PARALLEL]    = { NULL,               NULL,               PREC_NONE },
+    [TOKEN_REDUCE]      = { NULL,               NULL,               PREC_NONE },
 };
 
-void cw_parse_precedence(cwRuntime* cw, Precedence precedence)
+void cw_parse_precedence(cwCompiler* c, Precedence precedence)
 {
-    cw_advance(cw);
-    ParseCallback prefix_rule = rules[cw->previous.type].prefix;
+    cw_advance(c);
+    ParseCallback prefix_rule = rules[c->parser->previous.type].prefix;
 
     if (!prefix_rule)
     {
-        cw_syntax_error_at(cw, &cw->previous, "Expect expression");
+        cw_syntax_error_at(c->parser, &c->parser->previous, "Expect expression");
         return;
     }
 
     bool can_assign = precedence <= PREC_ASSIGNMENT;
-    prefix_rule(cw, can_assign);
+    prefix_rule(c, can_assign);
 
-    while (precedence <= rules[cw->current.type].precedence)
+    while (precedence <= rules[c->parser->current.type].precedence)
     {
-        cw_advance(cw);
-        ParseCallback infix_rule = rules[cw->previous.type].infix;
-        infix_rule(cw, can_assign);
+        cw_advance(c);
+        ParseCallback infix_rule = rules[c->parser->previous.type].infix;
+        infix_rule(c, can_assign);
     }
 
-    if (can_assign && cw_match(cw, TOKEN_ASSIGN))
+    if (can_assign && cw_match(c, TOKEN_ASSIGN))
     {
-        cw_syntax_error_at(cw, &cw->previous, "Invalid assignment target.");
+        cw_syntax_error_at(c->parser, &c->parser->previous, "Invalid assignment target.");
     }
 }
 
 /* --------------------------| parse callbacks |----------------------------------------- */
-static void cw_parse_integer(cwRuntime* cw, bool can_assign)
+static void cw_parse_integer(cwCompiler* c, bool can_assign)
 {
-    int32_t value = strtol(cw->previous.start, NULL, cw_token_get_base(&cw->previous));
-    cw_emit_bytes(cw->chunk, OP_CONSTANT, cw_make_constant(cw, MAKE_INT(value)), cw->previous.line);
+    int32_t value = strtol(c->parser->previous.start, NULL, cw_token_get_base(&c->parser->previous));
+    cw_emit_bytes(c->chunk, OP_CONSTANT, cw_make_constant(c, MAKE_INT(value)), c->parser->previous.line);
 }
 
-static void cw_parse_float(cwRuntime* cw, bool can_assign)
+static void cw_parse_float(cwCompiler* c, bool can_assign)
 {
-    float value = strtod(cw->previous.start, NULL);
-    cw_emit_bytes(cw->chunk, OP_CONSTANT, cw_make_constant(cw, MAKE_FLOAT(value)), cw->previous.line);
+    float value = strtod(c->parser->previous.start, NULL);
+    cw_emit_bytes(c->chunk, OP_CONSTANT, cw_make_constant(c, MAKE_FLOAT(value)), c->parser->previous.line);
 }
 
-static void cw_parse_string(cwRuntime* cw, bool can_assign)
+static void cw_parse_string(cwCompiler* c, bool can_assign)
 {
-    cwString* value = cw_str_copy(cw, cw->previous.start + 1, cw->previous.end - cw->previous.start - 2);
-    cw_emit_bytes(cw->chunk, OP_CONSTANT, cw_make_constant(cw, MAKE_OBJECT(value)), cw->previous.line);
+    cwString* value = cw_str_intern(c->engine, c->parser->previous.start + 1, c->parser->previous.end - c->parser->previous.start - 2);
+    cw_emit_bytes(c->chunk, OP_CONSTANT, cw_make_constant(c, MAKE_OBJECT(value)), c->parser->previous.line);
 }
 
-static void cw_parse_grouping(cwRuntime* cw, bool can_assign)
+static void cw_parse_grouping(cwCompiler* c, bool can_assign)
 {
-    cw_parse_expression(cw);
-    cw_consume(cw, TOKEN_RPAREN, "Expect ')' after expression.");
+    cw_parse_expression(c);
+    cw_consume(c, TOKEN_RPAREN, "Expect ')' after expression.");
 }
 
-static void cw_parse_unary(cwRuntime* cw, bool can_assign)
+static void cw_parse_unary(cwCompiler* c, bool can_assign)
 {
-    cwTokenType operator = cw->previous.type;
-    cw_parse_precedence(cw, PREC_UNARY);
+    cwTokenType operator = c->parser->previous.type;
+    cw_parse_precedence(c, PREC_UNARY);
 
     switch (operator)
     {
-    case TOKEN_EXCLAMATION: cw_emit_byte(cw->chunk, OP_NOT,    cw->previous.line); break;
-    case TOKEN_MINUS:       cw_emit_byte(cw->chunk, OP_NEGATE, cw->previous.line); break;
+    case TOKEN_EXCLAMATION: cw_emit_byte(c->chunk, OP_NOT,    c->parser->previous.line); break;
+    case TOKEN_MINUS:       cw_emit_byte(c->chunk, OP_NEGATE, c->parser->previous.line); break;
     }
 }
 
-static void cw_parse_binary(cwRuntime* cw, bool can_assign)
+static void cw_parse_binary(cwCompiler* c, bool can_assign)
 {
-    cwTokenType operator = cw->previous.type;
-    cw_parse_precedence(cw, (Precedence)(rules[operator].precedence + 1));
+    cwTokenType operator = c->parser->previous.type;
+    cw_parse_precedence(c, (Precedence)(rules[operator].precedence + 1));
 
     switch (operator)
     {
-    case TOKEN_EQ:        cw_emit_byte(cw->chunk, OP_EQ,       cw->previous.line); break;
-    case TOKEN_NOTEQ:     cw_emit_byte(cw->chunk, OP_NOTEQ,    cw->previous.line); break;
-    case TOKEN_LT:        cw_emit_byte(cw->chunk, OP_LT,       cw->previous.line); break;
-    case TOKEN_LTEQ:      cw_emit_byte(cw->chunk, OP_LTEQ,     cw->previous.line); break;
-    case TOKEN_GT:        cw_emit_byte(cw->chunk, OP_GT,       cw->previous.line); break;
-    case TOKEN_GTEQ:      cw_emit_byte(cw->chunk, OP_GTEQ,     cw->previous.line); break;
-    case TOKEN_PLUS:      cw_emit_byte(cw->chunk, OP_ADD,      cw->previous.line); break;
-    case TOKEN_MINUS:     cw_emit_byte(cw->chunk, OP_SUBTRACT, cw->previous.line); break;
-    case TOKEN_ASTERISK:  cw_emit_byte(cw->chunk, OP_MULTIPLY, cw->previous.line); break;
-    case TOKEN_SLASH:     cw_emit_byte(cw->chunk, OP_DIVIDE,   cw->previous.line); break;
+    case TOKEN_EQ:        cw_emit_byte(c->chunk, OP_EQ,       c->parser->previous.line); break;
+    case TOKEN_NOTEQ:     cw_emit_byte(c->chunk, OP_NOTEQ,    c->parser->previous.line); break;
+    case TOKEN_LT:        cw_emit_byte(c->chunk, OP_LT,       c->parser->previous.line); break;
+    case TOKEN_LTEQ:      cw_emit_byte(c->chunk, OP_LTEQ,     c->parser->previous.line); break;
+    case TOKEN_GT:        cw_emit_byte(c->chunk, OP_GT,       c->parser->previous.line); break;
+    case TOKEN_GTEQ:      cw_emit_byte(c->chunk, OP_GTEQ,     c->parser->previous.line); break;
+    case TOKEN_PLUS:      cw_emit_byte(c->chunk, OP_ADD,      c->parser->previous.line); break;
+    case TOKEN_MINUS:     cw_emit_byte(c->chunk, OP_SUBTRACT, c->parser->previous.line); break;
+    case TOKEN_ASTERISK:  cw_emit_byte(c->chunk, OP_MULTIPLY, c->parser->previous.line); break;
+    case TOKEN_SLASH:     cw_emit_byte(c->chunk, OP_DIVIDE,   c->parser->previous.line); break;
+    }
+}
+
+static void cw_parse_and(cwCompiler* c, bool can_assign)
+{
+    int end_jump = cw_emit_jump(c->chunk, OP_JUMP_IF_FALSE, c->parser->previous.line);
+
+    cw_emit_byte(c->chunk, OP_POP, c->parser->previous.line);
+    cw_parse_precedence(c, PREC_AND);
+
+    cw_patch_jump(c, end_jump);
+}
+
+static void cw_parse_or(cwCompiler* c, bool can_assign)
+{
+    int else_jump = cw_emit_jump(c->chunk, OP_JUMP_IF_FALSE, c->parser->previous.line);
+    int end_jump  = cw_emit_jump(c->chunk, OP_JUMP, c->parser->previous.line);
+
+    cw_patch_jump(c, else_jump);
+    cw_emit_byte(c->chunk, OP_POP, c->parser->previous.line);
+
+    cw_parse_precedence(c, PREC_OR);
+    cw_patch_jump(c, end_jump);
+}
+
+static void cw_parse_literal(cwCompiler* c, bool can_assign)
+{
+    switch (c->parser->previous.type)
+    {
+    case TOKEN_FALSE: cw_emit_byte(c->chunk, OP_FALSE, c->parser->previous.line); break;
+    case TOKEN_NULL:  cw_emit_byte(c->chunk, OP_NULL, c->parser->previous.line); break;
+    case TOKEN_TRUE:  cw_emit_byte(c->chunk, OP_TRUE, c->parser->previous.line); break;
+    }
+}
+
+/*
+ * The body of a parallel loop can read globals and write only its own locals
+ * and the reduction variables, which are globals of the runtime a block runs
+ * in. Locals of the enclosing scopes are out of reach of the body. Containers
+ * can only be modified through locals of the body, except for the element at
+ * the loop index of an array, which no other block writes.
+ */
+static void cw_check_parallel_access(cwCompiler* c, cwToken* name, int local, bool assign)
+{
+    if (local >= 0)
+    {
+        /* slot 1 is the loop variable */
+        if (assign && local == 1) cw_syntax_error_at(c->parser, name, "Can't assign to the loop variable.");
+        return;
+    }
+
+    for (int i = 0; i < c->reductions->count; ++i)
+    {
+        if (cw_identifiers_equal(name, &c->reductions->names[i])) return;
+    }
+
+    for (cwCompiler* enclosing = c->enclosing; enclosing; enclosing = enclosing->enclosing)
+    {
+        if (cw_resolve_local(enclosing, name) >= 0)
+        {
+            cw_syntax_error_at(c->parser, name, "Can't use locals of the enclosing scope in a parallel loop.");
+            return;
+        }
+    }
+
+    if (assign) cw_syntax_error_at(c->parser, name, "Can only assign locals and reduction variables in a parallel loop.");
+}
+
+static bool cw_is_modifier(const cwToken* name)
+{
+    static const char* modifiers[] = { "push", "remove", "fill", "scale", "add", "mul", "sort" };
+    for (size_t i = 0; i < sizeof(modifiers) / sizeof(modifiers[0]); ++i)
+    {
+        size_t len = strlen(modifiers[i]);
+        if ((size_t)(name->end - name->start) == len && memcmp(name->start, modifiers[i], len) == 0) return true;
     }
+    return false;
 }
 
-static void cw_parse_and(cwRuntime* cw, bool can_assign)
+/* the target of a write ends where the last read of a local ended */
+static void cw_check_parallel_write(cwCompiler* c, int target_end, const char* message)
 {
-    int end_jump = cw_emit_jump(cw->chunk, OP_JUMP_IF_FALSE, cw->previous.line);
+    if (c->reductions && c->local_end != target_end) cw_syntax_error_at(c->parser, &c->parser->previous, message);
+}
 
-    cw_emit_byte(cw->chunk, OP_POP, cw->previous.line);
-    cw_parse_precedence(cw, PREC_AND);
+static void cw_parse_variable(cwCompiler* c, bool can_assign)
+{
+    cwToken name = c->parser->previous;
+    if (can_assign && cw_match(c, TOKEN_ASSIGN))
+    {
+        cw_parse_expression(c);
+        cw_emit_variable(c, &name, true);
+    }
+    else
+    {
+        cw_emit_variable(c, &name, false);
+    }
+}
 
-    cw_patch_jump(cw, end_jump);
+/* first_end is set to the end of the first argument */
+static uint8_t cw_parse_arguments(cwCompiler* c, int* first_end)
+{
+    uint8_t argc = 0;
+    if (c->parser->current.type != TOKEN_RPAREN)
+    {
+        do
+        {
+            cw_parse_expression(c);
+            if (argc == 0 && first_end) *first_end = c->chunk->len;
+            if (argc == UINT8_MAX) cw_syntax_error_at(c->parser, &c->parser->previous, "Can't have more than 255 arguments.");
+            argc++;
+        } while (cw_match(c, TOKEN_COMMA));
+    }
+    cw_consume(c, TOKEN_RPAREN, "Expect ')' after arguments.");
+    return argc;
 }
 
-static void cw_parse_or(cwRuntime* cw, bool can_assign)
+static void cw_parse_call(cwCompiler* c, bool can_assign)
 {
-    int else_jump = cw_emit_jump(cw->chunk, OP_JUMP_IF_FALSE, cw->previous.line);
-    int end_jump  = cw_emit_jump(cw->chunk, OP_JUMP, cw->previous.line);
+    bool modifier = c->modifier_end == c->chunk->len;
+    int first_end = -1;
+    uint8_t argc = cw_parse_arguments(c, &first_end);
+    if (modifier) cw_check_parallel_write(c, first_end, "Can only modify locals in a parallel loop.");
+    cw_emit_bytes(c->chunk, OP_CALL, argc, c->parser->previous.line);
+}
 
-    cw_patch_jump(cw, else_jump);
-    cw_emit_byte(cw->chunk, OP_POP, cw->previous.line);
+/* resume(coroutine) or resume(coroutine, value) evaluates to the next yielded value */
+static void cw_parse_resume(cwCompiler* c, bool can_assign)
+{
+    cw_consume(c, TOKEN_LPAREN, "Expect '(' after 'resume'.");
+    cw_parse_expression(c);
+    if (cw_match(c, TOKEN_COMMA)) cw_parse_expression(c);
+    else                          cw_emit_byte(c->chunk, OP_NULL, c->parser->previous.line);
+    cw_consume(c, TOKEN_RPAREN, "Expect ')' after arguments.");
+    cw_emit_byte(c->chunk, OP_RESUME, c->parser->previous.line);
+}
 
-    cw_parse_precedence(cw, PREC_OR);
-    cw_patch_jump(cw, end_jump);
+/* yield value evaluates to the value passed to the next resume */
+static void cw_parse_yield(cwCompiler* c, bool can_assign)
+{
+    cwTokenType next = c->parser->current.type;
+    if (next == TOKEN_SEMICOLON || next == TOKEN_RPAREN || next == TOKEN_COMMA)
+        cw_emit_byte(c->chunk, OP_NULL, c->parser->previous.line);
+    else
+        cw_parse_precedence(c, PREC_ASSIGNMENT);
+    cw_emit_byte(c->chunk, OP_YIELD, c->parser->previous.line);
 }
 
-static void cw_parse_literal(cwRuntime* cw, bool can_assign)
+/* [a, b, c] is an int32 array if all elements are integers and a float32 array otherwise */
+static void cw_parse_array(cwCompiler* c, bool can_assign)
 {
-    switch (cw->previous.type)
+    uint8_t count = 0;
+    if (c->parser->current.type != TOKEN_RBRACKET)
     {
-    case TOKEN_FALSE: cw_emit_byte(cw->chunk, OP_FALSE, cw->previous.line); break;
-    case TOKEN_NULL:  cw_emit_byte(cw->chunk, OP_NULL, cw->previous.line); break;
-    case TOKEN_TRUE:  cw_emit_byte(cw->chunk, OP_TRUE, cw->previous.line); break;
+        do
+        {
+            cw_parse_expression(c);
+            if (count == UINT8_MAX) cw_syntax_error_at(c->parser, &c->parser->previous, "Can't have more than 255 elements in an array literal.");
+            count++;
+        } while (cw_match(c, TOKEN_COMMA));
     }
+    cw_consume(c, TOKEN_RBRACKET, "Expect ']' after array elements.");
+    cw_emit_bytes(c->chunk, OP_ARRAY, count, c->parser->previous.line);
 }
 
-static void cw_parse_variable(cwRuntime* cw, bool can_assign)
+/* string literals as keys are looked up with an inline cache */
+static void cw_parse_index(cwCompiler* c, bool can_assign)
 {
-    uint8_t get_op, set_op;
-    int arg = cw_resolve_local(cw, &cw->previous);
-    if (arg >= 0)
+    int key_start = c->chunk->len;
+    cw_parse_expression(c);
+    cw_consume(c, TOKEN_RBRACKET, "Expect ']' after index.");
+
+    /* slot 1 is the loop variable of a parallel loop */
+    bool loop_index = c->chunk->len == key_start + 2 && c->chunk->bytes[key_start] == OP_GET_LOCAL
+        && c->chunk->bytes[key_start + 1] == 1;
+
+    int key = -1;
+    if (c->chunk->len == key_start + 2 && c->chunk->bytes[key_start] == OP_CONSTANT
+        && IS_STRING(c->chunk->constants[c->chunk->bytes[key_start + 1]]))
+    {
+        key = c->chunk->bytes[key_start + 1];
+        c->chunk->len = key_start;
+    }
+
+    uint8_t op;
+    if (can_assign && cw_match(c, TOKEN_ASSIGN))
     {
-        get_op = OP_GET_LOCAL;
-        set_op = OP_SET_LOCAL;
+        if (!loop_index) cw_check_parallel_write(c, key_start, "Can only modify locals and the element at the loop index in a parallel loop.");
+        cw_parse_expression(c);
+        op = key < 0 ? OP_INDEX_SET : OP_MAP_SET;
     }
     else
     {
-        arg = cw_identifier_constant(cw, &cw->previous);
-        get_op = OP_GET_GLOBAL;
-        set_op = OP_SET_GLOBAL;
+        op = key < 0 ? OP_INDEX_GET : OP_MAP_GET;
     }
 
-    if (can_assign && cw_match(cw, TOKEN_ASSIGN))
+    cw_emit_byte(c->chunk, op, c->parser->previous.line);
+    if (key < 0) return;
+
+    /* OP_MAP_GET key cache */
+    uint16_t cache = cw_make_cache(c);
+    cw_emit_byte(c->chunk, (uint8_t)key, c->parser->previous.line);
+    cw_emit_bytes(c->chunk, (cache >> 8) & 0xff, cache & 0xff, c->parser->previous.line);
+}
+
+/*
+ * record.field looks the slot of the field up with an inline cache and
+ * record.method(args) dispatches through the call site of the instruction
+ */
+static void cw_parse_dot(cwCompiler* c, bool can_assign)
+{
+    int target_end = c->chunk->len;
+    cw_consume(c, TOKEN_IDENTIFIER, "Expect field name after '.'.");
+    uint8_t name = cw_identifier_constant(c, &c->parser->previous);
+
+    if (cw_match(c, TOKEN_LPAREN))
     {
-        cw_parse_expression(cw);
-        cw_emit_bytes(cw->chunk, set_op, (uint8_t)arg, cw->previous.line);
+        /* OP_INVOKE name argc site */
+        uint8_t argc = cw_parse_arguments(c, NULL);
+        uint16_t site = cw_make_call_site(c);
+        cw_emit_bytes(c->chunk, OP_INVOKE, name, c->parser->previous.line);
+        cw_emit_byte(c->chunk, argc, c->parser->previous.line);
+        cw_emit_bytes(c->chunk, (site >> 8) & 0xff, site & 0xff, c->parser->previous.line);
+        return;
     }
-    else 
+
+    uint8_t op = OP_GET_FIELD;
+    if (can_assign && cw_match(c, TOKEN_ASSIGN))
+    {
+        cw_check_parallel_write(c, target_end, "Can only set fields of locals in a parallel loop.");
+        cw_parse_expression(c);
+        op = OP_SET_FIELD;
+    }
+
+    /* OP_GET_FIELD name cache */
+    uint16_t cache = cw_make_cache(c);
+    cw_emit_bytes(c->chunk, op, name, c->parser->previous.line);
+    cw_emit_bytes(c->chunk, (cache >> 8) & 0xff, cache & 0xff, c->parser->previous.line);
+}
+
+/* { name: value, "key": value } */
+static void cw_parse_map(cwCompiler* c, bool can_assign)
+{
+    uint8_t count = 0;
+    if (c->parser->current.type != TOKEN_RBRACE)
     {
-        cw_emit_bytes(cw->chunk, get_op, (uint8_t)arg, cw->previous.line);
+        do
+        {
+            if (cw_match(c, TOKEN_IDENTIFIER))
+            {
+                cw_emit_bytes(c->chunk, OP_CONSTANT, cw_identifier_constant(c, &c->parser->previous), c->parser->previous.line);
+            }
+            else
+            {
+                cw_consume(c, TOKEN_STRING, "Expect name or string as key.");
+                cw_parse_string(c, false);
+            }
+
+            cw_consume(c, TOKEN_COLON, "Expect ':' after key.");
+            cw_parse_expression(c);
+            if (count == UINT8_MAX) cw_syntax_error_at(c->parser, &c->parser->previous, "Can't have more than 255 entries in a map literal.");
+            count++;
+        } while (cw_match(c, TOKEN_COMMA));
     }
+    cw_consume(c, TOKEN_RBRACE, "Expect '}' after map entries.");
+    cw_emit_bytes(c->chunk, OP_MAP, count, c->parser->previous.line);
 }
 
 /* --------------------------| utility |------------------------------------------------- */
-void cw_advance(cwRuntime* cw)
+void cw_emit_variable(cwCompiler* c, cwToken* name, bool assign)
+{
+    int local = cw_resolve_local(c, name);
+    if (c->reductions) cw_check_parallel_access(c, name, local, assign);
+
+    if (local >= 0)
+        cw_emit_bytes(c->chunk, assign ? OP_SET_LOCAL : OP_GET_LOCAL, (uint8_t)local, c->parser->previous.line);
+    else
+        cw_emit_bytes(c->chunk, assign ? OP_SET_GLOBAL : OP_GET_GLOBAL, cw_identifier_constant(c, name), c->parser->previous.line);
+
+    if (assign || !c->reductions) return;
+    if (local >= 0)                c->local_end = c->chunk->len;
+    else if (cw_is_modifier(name)) c->modifier_end = c->chunk->len;
+}
+
+void cw_advance(cwCompiler* c)
 {
-    cw->previous = cw->current;
-    const char* cursor = cw->previous.end;
-    int line = cw->previous.line;
+    c->parser->previous = c->parser->current;
+    const char* cursor = c->parser->previous.end;
+    int line = c->parser->previous.line;
     while (true)
     {
-        cursor = cw_scan_token(cw, &cw->current, cursor, line);
-        if (!cw->error) break;
+        /* the scanner reports invalid tokens and leaves their end unset */
+        cursor = cw_scan_token(c->parser, &c->parser->current, cursor, line);
+        if (c->parser->current.end == cursor) break;
     }
 }
 
-void cw_consume(cwRuntime* cw, cwTokenType type, const char* message)
+void cw_consume(cwCompiler* c, cwTokenType type, const char* message)
 {
-    if (cw->current.type == type)   cw_advance(cw);
-    else                            cw_syntax_error_at(cw, &cw->current, message);
+    if (c->parser->current.type == type)   cw_advance(c);
+    else                                   cw_syntax_error_at(c->parser, &c->parser->current, message);
 }
 
-bool cw_match(cwRuntime* cw, cwTokenType type)
+bool cw_match(cwCompiler* c, cwTokenType type)
 {
-    if (cw->current.type != type) return false;
-    cw_advance(cw);
+    if (c->parser->current.type != type) return false;
+    cw_advance(c);
     return true;
 }
 
-void cw_parser_synchronize(cwRuntime* cw)
+void cw_parser_synchronize(cwCompiler* c)
 {
-    cw->panic = false;
+    c->parser->panic = false;
 
-    while (cw->current.type != TOKEN_EOF)
+    while (c->parser->current.type != TOKEN_EOF)
     {
-        if (cw->previous.type == TOKEN_SEMICOLON) return;
-        switch (cw->current.type)
+        if (c->parser->previous.type == TOKEN_SEMICOLON) return;
+        switch (c->parser->current.type)
         {
         case TOKEN_IF:
         case TOKEN_FOR:
+        case TOKEN_PARALLEL:
         case TOKEN_WHILE:
         case TOKEN_LET:
         case TOKEN_FUNC:
@@ -260,6 +500,6 @@ void cw_parser_synchronize(cwRuntime* cw)
             return;
         }
 
-        cw_advance(cw);
+        cw_advance(c);
     }
 }
\ No newline at end of file
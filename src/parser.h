@@ -3,6 +3,15 @@
 
 #include "scanner.h"
 
+struct cwParser
+{
+    cwToken current;
+    cwToken previous;
+
+    bool error;
+    bool panic;
+};
+
 typedef enum
 {
     PREC_NONE,
@@ -18,12 +27,15 @@ typedef enum
     PREC_PRIMARY
 } Precedence;
 
-void cw_parse_precedence(cwRuntime* cw, Precedence precedence);
+void cw_parse_precedence(cwCompiler* c, Precedence precedence);
 
 /* utility */
-void cw_advance(cwRuntime* cw);
-void cw_consume(cwRuntime* cw, cwTokenType type, const char* message);
-bool cw_match(cwRuntime* cw, cwTokenType type);
-void cw_parser_synchronize(cwRuntime* cw);
+void cw_advance(cwCompiler* c);
+void cw_consume(cwCompiler* c, cwTokenType type, const char* message);
+bool cw_match(cwCompiler* c, cwTokenType type);
+void cw_parser_synchronize(cwCompiler* c);
+
+/* emits the access to a local or global variable */
+void cw_emit_variable(cwCompiler* c, cwToken* name, bool assign);
 
 #endif /* !CLOCKWORK_PARSER_H */
\ No newline at end of file
@@ -0,0 +1,147 @@
+#include "record.h"
+
+#include "memory.h"
+#include "runtime.h"
+
+/* --------------------------| shapes |-------------------------------------------------- */
+static uint32_t cw_shape_ids = 0;
+
+cwShape* cw_shape_new(cwEngine* engine, cwString* name)
+{
+    cwShape* shape = (cwShape*)cw_object_alloc(&engine->objects, sizeof(cwShape), OBJ_SHAPE);
+    shape->obj.frozen = true;
+    shape->name = name;
+    shape->fields = NULL;
+    shape->field_count = 0;
+    cw_table_init(&shape->slots);
+    shape->method_names = NULL;
+    shape->methods = NULL;
+    shape->method_count = 0;
+    cw_table_init(&shape->method_slots);
+
+    /* shapes past the last id are never cached and always looked up */
+    uint32_t id = CW_ATOMIC_ADD(&cw_shape_ids, 1);
+    shape->id = id <= CW_SHAPE_ID_MAX ? id : 0;
+    return shape;
+}
+
+void cw_shape_free(cwShape* shape)
+{
+    CW_FREE_ARRAY(cwString*, shape->fields, shape->field_count);
+    cw_table_free(&shape->slots);
+    CW_FREE_ARRAY(cwString*, shape->method_names, shape->method_count);
+    CW_FREE_ARRAY(cwFunction*, shape->methods, shape->method_count);
+    cw_table_free(&shape->method_slots);
+    cw_reallocate(shape, sizeof(cwShape), 0);
+}
+
+bool cw_shape_add_field(cwShape* shape, cwString* name)
+{
+    if (shape->field_count == CW_RECORD_FIELDS_MAX || cw_table_find(&shape->slots, name)
+        || cw_table_find(&shape->method_slots, name)) return false;
+
+    shape->fields = CW_GROW_ARRAY(cwString*, shape->fields, shape->field_count, shape->field_count + 1);
+    shape->fields[shape->field_count] = name;
+    cw_table_insert(&shape->slots, name, MAKE_INT(shape->field_count));
+    shape->field_count++;
+    return true;
+}
+
+int cw_shape_slot(const cwShape* shape, const cwString* name)
+{
+    const cwValue* slot = cw_table_find(&shape->slots, name);
+    return slot ? AS_INT(*slot) : -1;
+}
+
+bool cw_shape_add_method(cwShape* shape, cwString* name, cwFunction* method)
+{
+    if (shape->method_count == CW_SHAPE_METHODS_MAX || cw_table_find(&shape->slots, name)
+        || cw_table_find(&shape->method_slots, name)) return false;
+
+    int count = shape->method_count;
+    shape->method_names = CW_GROW_ARRAY(cwString*, shape->method_names, count, count + 1);
+    shape->methods = CW_GROW_ARRAY(cwFunction*, shape->methods, count, count + 1);
+    shape->method_names[count] = name;
+    shape->methods[count] = method;
+    cw_table_insert(&shape->method_slots, name, MAKE_INT(count));
+    shape->method_count++;
+    return true;
+}
+
+int cw_shape_method(const cwShape* shape, const cwString* name)
+{
+    const cwValue* index = cw_table_find(&shape->method_slots, name);
+    return index ? AS_INT(*index) : -1;
+}
+
+int cw_shape_find_slot(const cwShape* shape, const cwString* name, uint32_t* cache)
+{
+    int slot = cw_shape_slot(shape, name);
+    if (slot >= 0 && shape->id) CW_ATOMIC_STORE_RELAXED(cache, shape->id << 8 | (uint32_t)slot);
+    return slot;
+}
+
+/* --------------------------| dispatch |------------------------------------------------ */
+/* entries of the global cache are checked against the method names of the shape */
+static uint32_t cw_method_cache[CW_METHOD_CACHE_SIZE];
+
+static cwFunction* cw_shape_megamorphic(cwShape* shape, const cwString* name)
+{
+    uint32_t* slot = &cw_method_cache[(shape->id * 2654435761u ^ name->hash) & (CW_METHOD_CACHE_SIZE - 1)];
+    uint32_t entry = CW_ATOMIC_LOAD_RELAXED(slot);
+    if ((entry >> 8) == shape->id && (entry & 0xff) < shape->method_count && shape->method_names[entry & 0xff] == name)
+        return shape->methods[entry & 0xff];
+
+    int index = cw_shape_method(shape, name);
+    if (index < 0) return NULL;
+
+    CW_ATOMIC_STORE_RELAXED(slot, shape->id << 8 | (uint32_t)index);
+    return shape->methods[index];
+}
+
+cwFunction* cw_shape_lookup(cwShape* shape, const cwString* name, cwCallSite* site)
+{
+    /* shapes past the last id can't be told apart in caches */
+    if (!shape->id)
+    {
+        cw_site_count(&site->misses);
+        int index = cw_shape_method(shape, name);
+        return index < 0 ? NULL : shape->methods[index];
+    }
+
+    if (CW_ATOMIC_LOAD_RELAXED(&site->entries[CW_CALL_SITE_ENTRIES - 1]) != UINT32_MAX)
+    {
+        cw_site_count(&site->megamorphic);
+        return cw_shape_megamorphic(shape, name);
+    }
+
+    cw_site_count(&site->misses);
+    int index = cw_shape_method(shape, name);
+    if (index < 0) return NULL;
+
+    /* another thread can take the same entry first, the next one is tried then */
+    uint32_t entry = shape->id << 8 | (uint32_t)index;
+    for (int i = 0; i < CW_CALL_SITE_ENTRIES; ++i)
+    {
+        uint32_t expected = UINT32_MAX;
+        if (CW_ATOMIC_CAS(&site->entries[i], &expected, entry) || expected == entry) break;
+    }
+    return shape->methods[index];
+}
+
+/* --------------------------| records |------------------------------------------------- */
+cwRecord* cw_record_new(cwObject** objects, uint8_t depth, cwShape* shape)
+{
+    size_t size = sizeof(cwRecord) + sizeof(cwValue) * shape->field_count;
+    cwRecord* record = (cwRecord*)cw_object_alloc(objects, size, OBJ_RECORD);
+    record->obj.depth = depth;
+    record->shape = shape;
+    for (int i = 0; i < shape->field_count; ++i) record->fields[i] = MAKE_NULL();
+    return record;
+}
+
+void cw_record_free(cwRecord* record)
+{
+    cw_reallocate(record, sizeof(cwRecord) + sizeof(cwValue) * record->shape->field_count, 0);
+}
+
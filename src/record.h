@@ -0,0 +1,112 @@
+#ifndef CLOCKWORK_RECORD_H
+#define CLOCKWORK_RECORD_H
+
+#include "table.h"
+
+#define CW_RECORD_FIELDS_MAX UINT8_MAX
+#define CW_SHAPE_METHODS_MAX UINT8_MAX
+#define CW_METHOD_CACHE_SIZE 1024       /* power of two */
+#define CW_SHAPE_ID_MAX      0xfffffe   /* ids have to fit the upper 24 bits of a cache word */
+
+/*
+ * A shape is the layout declared with datatype: the names of the fields in
+ * the order of their slots. Shapes are created by the compiler, belong to
+ * the engine and never change, so records of one shape always keep a field
+ * at the same offset. Every shape gets an id that is unique in the process.
+ * Methods are functions that take the record as their first argument.
+ */
+typedef struct
+{
+    cwObject obj;
+    cwString* name;
+    uint32_t id;
+    cwString** fields;  /* names by slot */
+    uint8_t field_count;
+    Table slots;        /* name -> slot as int */
+
+    cwString** method_names;
+    cwFunction** methods;
+    uint8_t method_count;
+    Table method_slots; /* name -> index as int */
+} cwShape;
+
+/* records of a runtime store their fields in a fixed array of slots */
+typedef struct
+{
+    cwObject obj;
+    cwShape* shape;
+    cwValue fields[];
+} cwRecord;
+
+#define IS_SHAPE(value)  cw_is_obj_type(value, OBJ_SHAPE)
+#define AS_SHAPE(value)  ((cwShape*)AS_OBJECT(value))
+#define IS_RECORD(value) cw_is_obj_type(value, OBJ_RECORD)
+#define AS_RECORD(value) ((cwRecord*)AS_OBJECT(value))
+
+/* the caller holds the engine lock */
+cwShape* cw_shape_new(cwEngine* engine, cwString* name);
+void     cw_shape_free(cwShape* shape);
+
+/* false if the shape has the field already or is full */
+bool cw_shape_add_field(cwShape* shape, cwString* name);
+int  cw_shape_slot(const cwShape* shape, const cwString* name); /* -1 if there is no such field */
+
+/* false if the shape has a member of that name already or is full */
+bool cw_shape_add_method(cwShape* shape, cwString* name, cwFunction* method);
+int  cw_shape_method(const cwShape* shape, const cwString* name); /* -1 if there is no such method */
+
+/* fields are null, the depth is the fork depth of the runtime that owns objects */
+cwRecord* cw_record_new(cwObject** objects, uint8_t depth, cwShape* shape);
+void      cw_record_free(cwRecord* record);
+
+int cw_shape_find_slot(const cwShape* shape, const cwString* name, uint32_t* cache);
+
+/*
+ * Field lookup with an inline cache of the instruction. The cache word keeps
+ * the id of the shape seen last in its upper 24 bits and the slot of the
+ * field in the lower 8, so a hit is one compare and an indexed load. The
+ * word is written whole, a cache shared between threads is never torn.
+ */
+static inline int cw_shape_cached_slot(const cwShape* shape, const cwString* name, uint32_t* cache)
+{
+    uint32_t entry = CW_ATOMIC_LOAD_RELAXED(cache);
+    if ((entry >> 8) == shape->id) return (int)(entry & 0xff);
+    return cw_shape_find_slot(shape, name, cache);
+}
+
+static inline cwValue* cw_record_field(cwRecord* record, const cwString* name, uint32_t* cache)
+{
+    int slot = cw_shape_cached_slot(record->shape, name, cache);
+    return slot < 0 ? NULL : &record->fields[slot];
+}
+
+cwFunction* cw_shape_lookup(cwShape* shape, const cwString* name, cwCallSite* site);
+
+/* statistics are counted without a read-modify-write, a lost update is fine */
+static inline void cw_site_count(uint64_t* counter)
+{
+    CW_ATOMIC_STORE_RELAXED(counter, CW_ATOMIC_LOAD_RELAXED(counter) + 1);
+}
+
+/*
+ * Method dispatch with the inline cache of the call site. Entries are taken
+ * in order and never replaced, so the first free entry ends the search;
+ * once all are taken the site turns megamorphic and misses go to a global
+ * cache keyed by shape and name. NULL if the shape has no such method.
+ */
+static inline cwFunction* cw_shape_dispatch(cwShape* shape, const cwString* name, cwCallSite* site)
+{
+    for (int i = 0; i < CW_CALL_SITE_ENTRIES; ++i)
+    {
+        uint32_t entry = CW_ATOMIC_LOAD_RELAXED(&site->entries[i]);
+        if (entry == UINT32_MAX) break;
+        if ((entry >> 8) == shape->id)
+        {
+            cw_site_count(&site->hits);
+            return shape->methods[entry & 0xff];
+        }
+    }
+    return cw_shape_lookup(shape, name, site);
+}
+
+#endif /* !CLOCKWORK_RECORD_H */
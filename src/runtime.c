@@ -2,18 +2,187 @@
 
 #include <stdio.h>
 #include <stdarg.h>
+#include <string.h>
 
 #include "debug.h"
 #include "memory.h"
 #include "compiler.h"
+#include "snapshot.h"
+#include "natives.h"
+#include "array.h"
+#include "channel.h"
+#include "map.h"
+#include "record.h"
+#include "columns.h"
+#include "parallel.h"
+#include "vectorize.h"
+#include "scheduler.h"
 
-void cw_init(cwRuntime* cw)
+void cw_engine_init(cwEngine* engine, cwInternTable* atoms)
 {
-    cw->chunk = NULL;
-    cw->ip = NULL;
+    engine->atoms = atoms;
+    engine->objects = NULL;
+    engine->scheduler = NULL;
+    cw_table_init(&engine->strings);
+    cw_table_init(&engine->builtins);
+    cw_mutex_init(&engine->lock);
+    engine->runtimes = 0;
+
+    cw_define_natives(engine);
+}
+
+bool cw_engine_free(cwEngine* engine)
+{
+    /* the workers of the scheduler are the only runtimes that may be left */
+    int workers = engine->scheduler ? engine->scheduler->worker_count : 0;
+    if (CW_ATOMIC_LOAD(&engine->runtimes) > workers)
+    {
+        fprintf(stderr, "Engine is still used by %d runtimes.\n", engine->runtimes - workers);
+        return false;
+    }
+
+    if (engine->scheduler)
+    {
+        cw_scheduler_free(engine->scheduler);
+        CW_FREE_ARRAY(cwScheduler, engine->scheduler, 1);
+        engine->scheduler = NULL;
+    }
+
+    cw_table_free(&engine->strings);
+    cw_table_free(&engine->builtins);
+
+    /* channels go first, unreceived copies still point to frozen values and shapes */
+    for (cwObject** link = &engine->objects; *link;)
+    {
+        cwObject* object = *link;
+        if (object->type != OBJ_CHANNEL)
+        {
+            link = &object->next;
+            continue;
+        }
+        *link = object->next;
+        cw_channel_free((cwChannel*)object);
+    }
+
+    cw_free_objects(engine->objects);
+    engine->objects = NULL;
+    cw_mutex_free(&engine->lock);
+    return true;
+}
+
+cwScheduler* cw_engine_scheduler(cwEngine* engine)
+{
+    cwScheduler* scheduler = CW_ATOMIC_LOAD(&engine->scheduler);
+    if (scheduler) return scheduler;
+
+    cw_mutex_lock(&engine->lock);
+    scheduler = engine->scheduler;
+    if (!scheduler)
+    {
+        scheduler = CW_ALLOCATE(cwScheduler, 1);
+        cw_scheduler_init(scheduler, engine, NULL, 0);
+        CW_ATOMIC_STORE(&engine->scheduler, scheduler);
+    }
+    cw_mutex_unlock(&engine->lock);
+    return scheduler;
+}
+
+static cwString* cw_engine_rebase(cwEngine* engine, cwString* str)
+{
+    return cw_str_intern(engine, str->raw, str->len);
+}
+
+void cw_engine_merge(cwEngine* dst, cwEngine* src)
+{
+    cw_mutex_lock(&dst->lock);
+    cw_mutex_lock(&src->lock);
+
+    /* literals and natives of src stay alive until every function is rebased */
+    cwObject* rest = NULL;
+    cwObject* object = src->objects;
+    while (object)
+    {
+        cwObject* next = object->next;
+        if (object->type == OBJ_FUNCTION)
+        {
+            cwFunction* function = (cwFunction*)object;
+            if (function->name) function->name = cw_engine_rebase(dst, function->name);
+
+            cwChunk* chunk = &function->chunk;
+            for (size_t i = 0; i < chunk->const_len; ++i)
+            {
+                if (IS_STRING(chunk->constants[i]))
+                    chunk->constants[i] = MAKE_OBJECT(cw_engine_rebase(dst, AS_STRING(chunk->constants[i])));
+            }
+
+            object->next = dst->objects;
+            dst->objects = object;
+        }
+        else if (object->type == OBJ_SHAPE)
+        {
+            /* the slots are keyed by the rebased names */
+            cwShape* shape = (cwShape*)object;
+            shape->name = cw_engine_rebase(dst, shape->name);
+            cw_table_clear(&shape->slots);
+            for (int i = 0; i < shape->field_count; ++i)
+            {
+                shape->fields[i] = cw_engine_rebase(dst, shape->fields[i]);
+                cw_table_insert(&shape->slots, shape->fields[i], MAKE_INT(i));
+            }
+            cw_table_clear(&shape->method_slots);
+            for (int i = 0; i < shape->method_count; ++i)
+            {
+                shape->method_names[i] = cw_engine_rebase(dst, shape->method_names[i]);
+                cw_table_insert(&shape->method_slots, shape->method_names[i], MAKE_INT(i));
+            }
+
+            object->next = dst->objects;
+            dst->objects = object;
+        }
+        else
+        {
+            object->next = rest;
+            rest = object;
+        }
+        object = next;
+    }
+
+    src->objects = NULL;
+    cw_table_clear(&src->strings);
+    cw_table_clear(&src->builtins);
+    cw_free_objects(rest);
+
+    cw_mutex_unlock(&src->lock);
+    cw_mutex_unlock(&dst->lock);
+}
+
+void cw_define_native(cwEngine* engine, const char* name, cwNativeFn fn, int arity)
+{
+    cw_mutex_lock(&engine->lock);
+    cwString* key = cw_str_intern(engine, name, strlen(name));
+    cw_table_insert(&engine->builtins, key, MAKE_OBJECT(cw_native_new(engine, key, fn, arity)));
+    cw_mutex_unlock(&engine->lock);
+}
+
+void cw_init(cwRuntime* cw, cwEngine* engine)
+{
+    cw->engine = engine;
+    cw->parent = NULL;
+    cw->host = NULL;
+    cw->depth = 0;
+    cw->shared_arrays = false;
+    cw->coroutine = NULL;
+    cw->budget = 0;
+    cw->blocked = false;
+    CW_ATOMIC_ADD(&engine->runtimes, 1);
     cw->objects = NULL;
     cw_table_init(&cw->globals);
     cw_table_init(&cw->strings);
+
+    cw->vm.stack = CW_ALLOCATE(cwValue, CW_STACK_INIT);
+    cw->vm.stack_cap = CW_STACK_INIT;
+    cw->vm.frames = CW_ALLOCATE(cwCallFrame, CW_FRAMES_INIT);
+    cw->vm.frame_cap = CW_FRAMES_INIT;
     cw_reset_stack(cw);
 }
 
@@ -21,16 +190,535 @@ void cw_free(cwRuntime* cw)
 {
     cw_table_free(&cw->strings);
     cw_table_free(&cw->globals);
-    cw_free_objects(cw);
+    cw_free_objects(cw->objects);
+    cw->objects = NULL;
+
+    CW_FREE_ARRAY(cwValue, cw->vm.stack, cw->vm.stack_cap);
+    cw->vm.stack = NULL;
+    cw->vm.stack_cap = 0;
+
+    CW_FREE_ARRAY(cwCallFrame, cw->vm.frames, cw->vm.frame_cap);
+    cw->vm.frames = NULL;
+    cw->vm.frame_cap = 0;
+
+    CW_ATOMIC_SUB(&cw->engine->runtimes, 1);
 }
 
-static InterpretResult cw_run(cwRuntime* cw)
+void cw_fork(cwRuntime* cw, const cwRuntime* parent)
+{
+    /* nothing of the parent is copied, so forking does not depend on the size of its globals */
+    cw_init(cw, parent->engine);
+    cw->parent = parent;
+    cw->depth = parent->depth + 1;
+}
+
+void cw_reset(cwRuntime* cw, int flags)
+{
+    if (flags & CW_RESET_HEAP) flags |= CW_RESET_STACK | CW_RESET_GLOBALS;
+
+    if (flags & CW_RESET_STACK)   cw_reset_stack(cw);
+    if (flags & CW_RESET_GLOBALS) cw_table_clear(&cw->globals);
+    if (flags & CW_RESET_HEAP)
+    {
+        cw_table_clear(&cw->strings);
+        cw_free_objects(cw->objects);
+        cw->objects = NULL;
+    }
+}
+
+/* globals */
+static cwValue* cw_find_defined(const cwRuntime* cw, const cwString* name)
+{
+    for (const cwRuntime* rt = cw; rt; rt = rt->parent)
+    {
+        cwValue* value = cw_table_find(&rt->globals, name);
+        if (value) return value;
+    }
+    return NULL;
+}
+
+/* builtins of the engine can be shadowed by globals */
+cwValue* cw_find_global(const cwRuntime* cw, const cwString* name)
+{
+    cwValue* value = cw_find_defined(cw, name);
+    return value ? value : cw_table_find(&cw->engine->builtins, name);
+}
+
+bool cw_set_global(cwRuntime* cw, cwString* name, cwValue val)
+{
+    cwValue* value = cw_table_find(&cw->globals, name);
+    if (value)
+    {
+        *value = val;
+        return true;
+    }
+
+    /* globals of a parent are copied into the runtime on write */
+    if (!cw->parent || !cw_find_defined(cw->parent, name)) return false;
+
+    cw_table_insert(&cw->globals, name, val);
+    return true;
+}
+
+static bool cw_call(cwRuntime* cw, cwFunction* function, int argc)
+{
+    if (argc != function->arity)
+    {
+        cw_runtime_error(cw, "Expected %d arguments but got %d.", function->arity, argc);
+        return false;
+    }
+
+    if (cw->vm.frame_count >= cw->vm.frame_cap)
+    {
+        if (cw->vm.frame_cap >= CW_FRAMES_MAX)
+        {
+            cw_runtime_error(cw, "Stack overflow.");
+            return false;
+        }
+
+        int cap = CW_GROW_CAPACITY(cw->vm.frame_cap);
+        if (cap > CW_FRAMES_MAX) cap = CW_FRAMES_MAX;
+        cw->vm.frames = CW_GROW_ARRAY(cwCallFrame, cw->vm.frames, cw->vm.frame_cap, cap);
+        cw->vm.frame_cap = cap;
+    }
+
+    /* lazily compiled functions get their byte code on the first call */
+    if (!cw_compile_function(cw->engine, function))
+    {
+        cw_runtime_error(cw, "Could not compile function '%s'.", function->name ? function->name->raw : "<script>");
+        return false;
+    }
+
+    cwCallFrame* frame = &cw->vm.frames[cw->vm.frame_count++];
+    frame->function = function;
+    frame->ip = function->chunk.bytes;
+    frame->slots = cw->vm.stack + cw->vm.stack_index - argc - 1;
+    return true;
+}
+
+static bool cw_call_native(cwRuntime* cw, cwNative* native, int argc)
+{
+    if (native->arity >= 0 && argc != native->arity)
+    {
+        cw_runtime_error(cw, "Expected %d arguments but got %d.", native->arity, argc);
+        return false;
+    }
+
+    cwValue result = MAKE_NULL();
+    if (!native->fn(cw, argc, cw->vm.stack + cw->vm.stack_index - argc, &result)) return false;
+    if (cw->blocked) return true;
+
+    /* the result replaces the callee and its arguments */
+    cw->vm.stack_index -= argc + 1;
+    return cw_push_stack(cw, result);
+}
+
+static bool cw_check_key(cwRuntime* cw, cwValue key)
+{
+    if (IS_STRING(key)) return true;
+
+    cw_runtime_error(cw, "Map keys must be strings.");
+    return false;
+}
+
+static bool cw_check_index(cwRuntime* cw, cwValue target, cwValue index)
+{
+    if (!IS_ARRAY(target))
+    {
+        cw_runtime_error(cw, "Can only index arrays, maps and columns.");
+        return false;
+    }
+
+    if (!IS_INT(index))
+    {
+        cw_runtime_error(cw, "Index must be an integer.");
+        return false;
+    }
+
+    if (!cw_array_in_bounds(AS_ARRAY(target), AS_INT(index)))
+    {
+        cw_runtime_error(cw, "Index %d out of bounds for length %u.", AS_INT(index), AS_ARRAY(target)->len);
+        return false;
+    }
+    return true;
+}
+
+/* calling a shape creates a record with the arguments as fields */
+static bool cw_construct(cwRuntime* cw, cwShape* shape, int argc)
+{
+    if (argc != shape->field_count)
+    {
+        cw_runtime_error(cw, "Expected %d arguments but got %d.", shape->field_count, argc);
+        return false;
+    }
+
+    cwRecord* record = cw_record_new(&cw->objects, cw->depth, shape);
+    memcpy(record->fields, cw->vm.stack + cw->vm.stack_index - argc, sizeof(cwValue) * argc);
+
+    cw->vm.stack_index -= argc + 1;
+    return cw_push_stack(cw, MAKE_OBJECT(record));
+}
+
+static bool cw_check_row(cwRuntime* cw, const cwColumns* columns, cwValue index)
+{
+    if (!IS_INT(index))
+    {
+        cw_runtime_error(cw, "Index must be an integer.");
+        return false;
+    }
+
+    uint32_t len = cw_columns_len(columns);
+    if ((uint32_t)AS_INT(index) >= len)
+    {
+        cw_runtime_error(cw, "Index %d out of bounds for length %u.", AS_INT(index), len);
+        return false;
+    }
+    return true;
+}
+
+static bool cw_call_value(cwRuntime* cw, cwValue callee, int argc)
+{
+    if (IS_FUNCTION(callee)) return cw_call(cw, AS_FUNCTION(callee), argc);
+    if (IS_NATIVE(callee))   return cw_call_native(cw, AS_NATIVE(callee), argc);
+    if (IS_SHAPE(callee))    return cw_construct(cw, AS_SHAPE(callee), argc);
+
+    cw_runtime_error(cw, "Can only call functions.");
+    return false;
+}
+
+/*
+ * Fields other than those of records: a collection of columns gives out
+ * the column of a field and a row view the element of its row.
+ */
+static int cw_check_field(cwRuntime* cw, cwValue target, cwString* name, uint32_t* cache)
+{
+    const cwShape* shape = NULL;
+    if (IS_RECORD(target))       shape = AS_RECORD(target)->shape;
+    else if (IS_COLUMNS(target)) shape = AS_COLUMNS(target)->shape;
+    else if (IS_ROW(target))     shape = AS_ROW(target)->columns->shape;
+    else
+    {
+        cw_runtime_error(cw, "Only records, columns and rows have fields.");
+        return -1;
+    }
+
+    int slot = cw_shape_cached_slot(shape, name, cache);
+    if (slot < 0) cw_runtime_error(cw, "Undefined field '%s'.", name->raw);
+    return slot;
+}
+
+static bool cw_get_field(cwRuntime* cw, cwValue target, cwString* name, uint32_t* cache, cwValue* value)
+{
+    int slot = cw_check_field(cw, target, name, cache);
+    if (slot < 0) return false;
+
+    if (IS_COLUMNS(target))
+    {
+        *value = MAKE_OBJECT(AS_COLUMNS(target)->columns[slot]);
+        return true;
+    }
+
+    if (IS_ROW(target))
+    {
+        if (cw_row_get(AS_ROW(target), slot, value)) return true;
+
+        cw_runtime_error(cw, "Row %u out of bounds of column '%s'.", AS_ROW(target)->index, name->raw);
+        return false;
+    }
+
+    *value = AS_RECORD(target)->fields[slot];
+    return true;
+}
+
+/* --------------------------| ownership |------------------------------------------------ */
+static const cwObject* cw_owner(cwValue target)
+{
+    if (IS_ROW(target)) return &AS_ROW(target)->columns->obj;
+    return AS_OBJECT(target);
+}
+
+static const char* cw_container_name(const cwObject* object)
+{
+    switch (object->type)
+    {
+    case OBJ_ARRAY:  return "array";
+    case OBJ_MAP:    return "map";
+    case OBJ_RECORD: return "record";
+    default:         return "columns";
+    }
+}
+
+bool cw_is_writable(const cwRuntime* cw, cwValue target)
+{
+    const cwObject* object = cw_owner(target);
+    if (object->frozen) return false;
+
+    return object->depth == cw->depth || (cw->host && object->depth == cw->host->depth);
+}
+
+bool cw_check_write(cwRuntime* cw, cwValue target)
+{
+    if (cw_is_writable(cw, target)) return true;
+
+    const cwObject* object = cw_owner(target);
+    if (object->frozen) cw_runtime_error(cw, "Can't modify a frozen %s.", cw_container_name(object));
+    else                cw_runtime_error(cw, "Can't modify the %s of a parent runtime.", cw_container_name(object));
+    return false;
+}
+
+bool cw_is_element_writable(const cwRuntime* cw, cwValue target)
+{
+    if (cw->shared_arrays && !cw_owner(target)->frozen && !IS_MAP(target) && !IS_RECORD(target)) return true;
+    return cw_is_writable(cw, target);
+}
+
+static bool cw_check_element_write(cwRuntime* cw, cwValue target)
+{
+    return cw_is_element_writable(cw, target) || cw_check_write(cw, target);
+}
+
+/* values stored into a container of the host have to outlive the fork */
+static bool cw_check_store(cwRuntime* cw, cwValue target, cwValue* value)
+{
+    if (!cw_check_write(cw, target)) return false;
+
+    return cw_owner(target)->depth == cw->depth || cw_export(cw, value);
+}
+
+static bool cw_export_value(cwRuntime* cw, cwValue* value, int depth)
+{
+    if (cw_is_frozen(*value)) return true;
+
+    cwRuntime* host = cw->host;
+    if (IS_STRING(*value))
+    {
+        /* strings of the host and its parents are found again */
+        *value = MAKE_OBJECT(cw_str_copy(host, AS_STRING(*value)->raw, AS_STRING(*value)->len));
+        return true;
+    }
+
+    cwObject* object = AS_OBJECT(*value);
+    if (object->depth != cw->depth) return true;
+
+    if (depth >= CW_COPY_DEPTH_MAX)
+    {
+        cw_runtime_error(cw, "Can't export values nested this deep.");
+        return false;
+    }
+
+    switch (object->type)
+    {
+    case OBJ_ARRAY:
+        *value = MAKE_OBJECT(cw_array_copy(&host->objects, host->depth, AS_ARRAY(*value)));
+        return true;
+    case OBJ_MAP:
+    {
+        cwMap* map = cw_map_new(&host->objects, host->depth);
+
+        uint32_t position = 0;
+        cwString* key;
+        cwValue element;
+        while (cw_map_next(AS_MAP(*value), &position, &key, &element))
+        {
+            cwValue exported = MAKE_OBJECT(key);
+            if (!cw_export_value(cw, &exported, depth + 1) || !cw_export_value(cw, &element, depth + 1)) return false;
+            cw_map_set(map, AS_STRING(exported), element, NULL);
+        }
+
+        *value = MAKE_OBJECT(map);
+        return true;
+    }
+    case OBJ_RECORD:
+    {
+        cwRecord* source = AS_RECORD(*value);
+        cwRecord* record = cw_record_new(&host->objects, host->depth, source->shape);
+        for (int i = 0; i < source->shape->field_count; ++i)
+        {
+            record->fields[i] = source->fields[i];
+            if (!cw_export_value(cw, &record->fields[i], depth + 1)) return false;
+        }
+
+        *value = MAKE_OBJECT(record);
+        return true;
+    }
+    default:
+        cw_runtime_error(cw, "Only arrays, maps, records and strings can leave a fork.");
+        return false;
+    }
+}
+
+bool cw_export(cwRuntime* cw, cwValue* value)
+{
+    return cw_export_value(cw, value, 0);
+}
+
+static bool cw_set_field(cwRuntime* cw, cwValue target, cwString* name, uint32_t* cache, cwValue value)
+{
+    if (IS_RECORD(target) && !cw_check_store(cw, target, &value)) return false;
+    if (IS_ROW(target) && !cw_check_element_write(cw, target)) return false;
+
+    if (IS_RECORD(target))
+    {
+        cwValue* field = cw_record_field(AS_RECORD(target), name, cache);
+        if (field)
+        {
+            *field = value;
+            return true;
+        }
+    }
+
+    int slot = cw_check_field(cw, target, name, cache);
+    if (slot < 0) return false;
+
+    if (IS_COLUMNS(target))
+    {
+        cw_runtime_error(cw, "Can't replace the column of a field.");
+        return false;
+    }
+
+    if (!IS_NUMBER(value))
+    {
+        cw_runtime_error(cw, "Array elements must be numbers.");
+        return false;
+    }
+
+    if (cw_row_set(AS_ROW(target), slot, value)) return true;
+
+    cw_runtime_error(cw, "Row %u out of bounds of column '%s'.", AS_ROW(target)->index, name->raw);
+    return false;
+}
+
+/*
+ * The receiver is the first argument of a method, so the method is slid in
+ * under it as the callee. A field that holds a function is called without
+ * the receiver, which stays in the callee slot.
+ */
+static bool cw_invoke(cwRuntime* cw, cwString* name, int argc, cwCallSite* site)
+{
+    cwValue receiver = cw_peek_stack(cw, argc);
+    if (!IS_RECORD(receiver))
+    {
+        cw_runtime_error(cw, "Only records have methods.");
+        return false;
+    }
+
+    cwRecord* record = AS_RECORD(receiver);
+    cwFunction* method = cw_shape_dispatch(record->shape, name, site);
+    if (!method)
+    {
+        int slot = cw_shape_slot(record->shape, name);
+        if (slot < 0)
+        {
+            cw_runtime_error(cw, "Undefined method '%s'.", name->raw);
+            return false;
+        }
+        return cw_call_value(cw, record->fields[slot], argc);
+    }
+
+    if (argc + 1 != method->arity)
+    {
+        cw_runtime_error(cw, "Expected %d arguments but got %d.", method->arity - 1, argc);
+        return false;
+    }
+
+    if (!cw_push_stack(cw, MAKE_NULL())) return false;
+    cwValue* callee = cw->vm.stack + cw->vm.stack_index - argc - 2;
+    memmove(callee + 1, callee, sizeof(cwValue) * (argc + 1));
+    *callee = MAKE_OBJECT(method);
+    return cw_call(cw, method, argc + 1);
+}
+
+/* coroutines */
+cwCoroutine* cw_coroutine_new(cwRuntime* cw, cwFunction* function)
 {
-#define READ_BYTE()     (*cw->ip++)
-#define READ_SHORT()    (cw->ip += 2, (uint16_t)((cw->ip[-2] << 8) | cw->ip[-1]))
-#define READ_CONSTANT() (cw->chunk->constants[READ_BYTE()])
+    cwCoroutine* coroutine = (cwCoroutine*)cw_object_alloc(&cw->objects, sizeof(cwCoroutine), OBJ_COROUTINE);
+    coroutine->obj.depth = cw->depth;
+    coroutine->function = function;
+    coroutine->caller = NULL;
+    coroutine->state = CO_SUSPENDED;
+    coroutine->started = false;
+
+    cwVM* context = &coroutine->context;
+    context->stack = CW_ALLOCATE(cwValue, CW_COROUTINE_STACK_INIT);
+    context->stack_cap = CW_COROUTINE_STACK_INIT;
+    context->frames = CW_ALLOCATE(cwCallFrame, CW_COROUTINE_FRAMES_INIT);
+    context->frame_cap = CW_COROUTINE_FRAMES_INIT;
+    context->frame_count = 0;
+
+    /* the function is the callee of the first frame */
+    context->stack[0] = MAKE_OBJECT(function);
+    context->stack_index = 1;
+    return coroutine;
+}
+
+static void cw_swap_context(cwRuntime* cw, cwCoroutine* coroutine)
+{
+    cwVM vm = cw->vm;
+    cw->vm = coroutine->context;
+    coroutine->context = vm;
+}
+
+static bool cw_resume(cwRuntime* cw, cwValue target, cwValue value)
+{
+    if (!IS_COROUTINE(target))
+    {
+        cw_runtime_error(cw, "Can only resume coroutines.");
+        return false;
+    }
+
+    cwCoroutine* coroutine = AS_COROUTINE(target);
+    if (coroutine->state != CO_SUSPENDED)
+    {
+        if (coroutine->state == CO_DONE) cw_runtime_error(cw, "Can't resume a finished coroutine.");
+        else                             cw_runtime_error(cw, "Can't resume a running coroutine.");
+        return false;
+    }
+
+    cw_swap_context(cw, coroutine);
+    coroutine->caller = cw->coroutine;
+    coroutine->state = CO_RUNNING;
+    cw->coroutine = coroutine;
+
+    /* the first resume passes the value as argument, the others as result of yield */
+    if (coroutine->started) return cw_push_stack(cw, value);
+
+    coroutine->started = true;
+    int argc = coroutine->function->arity;
+    if (argc > 0 && !cw_push_stack(cw, value)) return false;
+    return cw_call(cw, coroutine->function, argc);
+}
+
+/* switches back to the caller of the running coroutine and passes it the value */
+static void cw_suspend(cwRuntime* cw, cwCoroutineState state, cwValue value)
+{
+    cwCoroutine* coroutine = cw->coroutine;
+    coroutine->state = state;
+    cw->coroutine = coroutine->caller;
+    coroutine->caller = NULL;
+    cw_swap_context(cw, coroutine);
+
+    /* the caller popped the value it resumed with, so there is room for the result */
+    cw_push_stack(cw, value);
+
+    /* a finished coroutine does not need its context anymore */
+    if (state == CO_DONE)
+    {
+        CW_FREE_ARRAY(cwValue, coroutine->context.stack, coroutine->context.stack_cap);
+        CW_FREE_ARRAY(cwCallFrame, coroutine->context.frames, coroutine->context.frame_cap);
+        coroutine->context = (cwVM){ 0 };
+    }
+}
+
+static InterpretResult cw_execute(cwRuntime* cw)
+{
+    cwCallFrame* frame = &cw->vm.frames[cw->vm.frame_count - 1];
+
+#define READ_BYTE()     (*frame->ip++)
+#define READ_SHORT()    (frame->ip += 2, (uint16_t)((frame->ip[-2] << 8) | frame->ip[-1]))
+#define READ_CONSTANT() (frame->function->chunk.constants[READ_BYTE()])
+#define PUSH(value)     do { if (!cw_push_stack(cw, value)) return INTERPRET_RUNTIME_ERROR; } while (false)
 #define BINARY_OP_NUM(op)                                                           \
-        if (!op(&cw->stack[cw->stack_index - 2], &cw->stack[cw->stack_index - 1]))  \
+        if (!op(&cw->vm.stack[cw->vm.stack_index - 2], &cw->vm.stack[cw->vm.stack_index - 1]))  \
         {                                                                           \
             cw_runtime_error(cw, "Operands must be two numbers.");                  \
             return INTERPRET_RUNTIME_ERROR;                                         \
@@ -45,22 +733,22 @@ static InterpretResult cw_run(cwRuntime* cw)
         }                                                                                           \
         cwValue b = cw_pop_stack(cw);                                                               \
         cwValue a = cw_pop_stack(cw);                                                               \
-        if (IS_FLOAT(a) || IS_FLOAT(b)) cw_push_stack(cw, MAKE_BOOL(AS_FLOAT(a) op AS_FLOAT(b)));   \
-        else                            cw_push_stack(cw, MAKE_BOOL(AS_INT(a) op AS_INT(b)));       \
+        if (IS_FLOAT(a) || IS_FLOAT(b)) PUSH(MAKE_BOOL(AS_FLOAT(a) op AS_FLOAT(b)));                \
+        else                            PUSH(MAKE_BOOL(AS_INT(a) op AS_INT(b)));                    \
     } break
 
     while (true)
     {
 #ifdef DEBUG_TRACE_EXECUTION
         printf("          ");
-        for (cwValue* slot = cw->stack; slot < cw->stack + cw->stack_index; ++slot)
+        for (cwValue* slot = cw->vm.stack; slot < cw->vm.stack + cw->vm.stack_index; ++slot)
         {
             printf("[ ");
             cw_print_value(*slot);
             printf(" ]");
         }
         printf("\n");
-        cw_disassemble_instruction(cw->chunk, (int)(cw->ip - cw->chunk->bytes));
+        cw_disassemble_instruction(&frame->function->chunk, (int)(frame->ip - frame->function->chunk.bytes));
 #endif
         uint8_t instruction;
         switch (instruction = READ_BYTE())
@@ -68,23 +756,23 @@ static InterpretResult cw_run(cwRuntime* cw)
             case OP_CONSTANT:
             {
                 cwValue constant = READ_CONSTANT();
-                cw_push_stack(cw, constant);
+                PUSH(constant);
                 break;
             }
-            case OP_NULL:     cw_push_stack(cw, MAKE_NULL()); break;
-            case OP_TRUE:     cw_push_stack(cw, MAKE_BOOL(true)); break;
-            case OP_FALSE:    cw_push_stack(cw, MAKE_BOOL(false)); break;
+            case OP_NULL:     PUSH(MAKE_NULL()); break;
+            case OP_TRUE:     PUSH(MAKE_BOOL(true)); break;
+            case OP_FALSE:    PUSH(MAKE_BOOL(false)); break;
             case OP_POP:      cw_pop_stack(cw); break;
             case OP_GET_LOCAL:
             {
                 uint8_t slot = READ_BYTE();
-                cw_push_stack(cw, cw->stack[slot]);
+                PUSH(frame->slots[slot]);
                 break;
             }
             case OP_SET_LOCAL:
             {
                 uint8_t slot = READ_BYTE();
-                cw->stack[slot] = cw_peek_stack(cw, 0);
+                frame->slots[slot] = cw_peek_stack(cw, 0);
                 break;
             }
             case OP_DEF_GLOBAL:
@@ -97,9 +785,8 @@ static InterpretResult cw_run(cwRuntime* cw)
             case OP_SET_GLOBAL:
             {
                 cwString* name = AS_STRING(READ_CONSTANT());
-                if (cw_table_insert(&cw->globals, name, cw_peek_stack(cw, 0)))
+                if (!cw_set_global(cw, name, cw_peek_stack(cw, 0)))
                 {
-                    cw_table_remove(&cw->globals, name); 
                     cw_runtime_error(cw, "Undefined variable '%s'.", name->raw);
                     return INTERPRET_RUNTIME_ERROR;
                 }
@@ -108,13 +795,13 @@ static InterpretResult cw_run(cwRuntime* cw)
             case OP_GET_GLOBAL:
             {
                 cwString* name = AS_STRING(READ_CONSTANT());
-                cwValue* value = cw_table_find(&cw->globals, name);
+                cwValue* value = cw_find_global(cw, name);
                 if (!value)
                 {
                     cw_runtime_error(cw, "Undefined variable '%s'.", name->raw);
                     return INTERPRET_RUNTIME_ERROR;
                 }
-                cw_push_stack(cw, *value);
+                PUSH(*value);
                 break;
             }
             case OP_EQ: case OP_NOTEQ:
@@ -122,7 +809,7 @@ static InterpretResult cw_run(cwRuntime* cw)
                 cwValue b = cw_pop_stack(cw);
                 cwValue a = cw_pop_stack(cw);
                 bool eq = cw_values_equal(a, b);
-                cw_push_stack(cw, MAKE_BOOL((instruction == OP_EQ ? eq : !eq)));
+                PUSH(MAKE_BOOL((instruction == OP_EQ ? eq : !eq)));
                 break;
             }
             case OP_LT:   BINARY_OP_BOOL(<);
@@ -135,11 +822,11 @@ static InterpretResult cw_run(cwRuntime* cw)
                 {
                     cwString* b = AS_STRING(cw_pop_stack(cw));
                     cwString* a = AS_STRING(cw_pop_stack(cw));
-                    cw_push_stack(cw, MAKE_OBJECT(cw_str_concat(cw, a, b)));
+                    PUSH(MAKE_OBJECT(cw_str_concat(cw, a, b)));
                     break;
                 }
 
-                if (!cw_value_add(&cw->stack[cw->stack_index - 2], &cw->stack[cw->stack_index - 1]))
+                if (!cw_value_add(&cw->vm.stack[cw->vm.stack_index - 2], &cw->vm.stack[cw->vm.stack_index - 1]))
                 {
                     cw_runtime_error(cw, "Operands must be two numbers or two strings.");
                     return INTERPRET_RUNTIME_ERROR;
@@ -159,75 +846,487 @@ static InterpretResult cw_run(cwRuntime* cw)
                 }
                 
                 cwValue val = cw_pop_stack(cw);
-                if (IS_FLOAT(val)) cw_push_stack(cw, MAKE_FLOAT(-AS_FLOAT(val)));
-                else               cw_push_stack(cw, MAKE_INT(-AS_INT(val)));
+                if (IS_FLOAT(val)) PUSH(MAKE_FLOAT(-AS_FLOAT(val)));
+                else               PUSH(MAKE_INT(-AS_INT(val)));
                 break;
             }
-            case OP_NOT:      cw_push_stack(cw, MAKE_BOOL(cw_is_falsey(cw_pop_stack(cw)))); break;
+            case OP_NOT:      PUSH(MAKE_BOOL(cw_is_falsey(cw_pop_stack(cw)))); break;
             case OP_JUMP_IF_FALSE:
             {
                 uint16_t offset = READ_SHORT();
-                if (cw_is_falsey(cw_peek_stack(cw, 0))) cw->ip += offset;
+                if (cw_is_falsey(cw_peek_stack(cw, 0))) frame->ip += offset;
                 break;
             }
             /* NOTE: combine OP_JUMP and OP_LOOP */
             case OP_JUMP:
             {
                 uint16_t offset = READ_SHORT();
-                cw->ip += offset;
+                frame->ip += offset;
                 break;
             }
             case OP_LOOP:
             {
                 uint16_t offset = READ_SHORT();
-                cw->ip -= offset;
+                frame->ip -= offset;
+                if (cw->budget && --cw->budget == 0) return INTERPRET_PREEMPTED;
                 break;
             }
             case OP_PRINT:
                 cw_print_value(cw_pop_stack(cw));
                 printf("\n");
                 break;
+            case OP_CALL:
+            {
+                int argc = READ_BYTE();
+                if (!cw_call_value(cw, cw_peek_stack(cw, argc), argc)) return INTERPRET_RUNTIME_ERROR;
+                if (cw->blocked)
+                {
+                    /* the native is called again when the fiber resumes */
+                    cw->blocked = false;
+                    frame->ip -= 2;
+                    return INTERPRET_PREEMPTED;
+                }
+                frame = &cw->vm.frames[cw->vm.frame_count - 1];
+                if (cw->budget && --cw->budget == 0) return INTERPRET_PREEMPTED;
+                break;
+            }
             case OP_RETURN:
-                return INTERPRET_OK;
+            {
+                cwValue result = cw_pop_stack(cw);
+                cw->vm.frame_count--;
+
+                /* the result replaces the callee and its arguments */
+                cw->vm.stack_index = frame->slots - cw->vm.stack;
+                if (cw->vm.frame_count == 0)
+                {
+                    if (!cw->coroutine)
+                    {
+                        PUSH(result);
+                        return INTERPRET_OK;
+                    }
+
+                    /* a finished coroutine returns to its caller */
+                    cw_suspend(cw, CO_DONE, result);
+                }
+                else
+                {
+                    PUSH(result);
+                }
+
+                frame = &cw->vm.frames[cw->vm.frame_count - 1];
+                break;
+            }
+            case OP_RESUME:
+            {
+                cwValue value = cw_pop_stack(cw);
+                cwValue target = cw_pop_stack(cw);
+                if (!cw_resume(cw, target, value)) return INTERPRET_RUNTIME_ERROR;
+                frame = &cw->vm.frames[cw->vm.frame_count - 1];
+                break;
+            }
+            case OP_PARALLEL:
+            {
+                cwFunction* body = AS_FUNCTION(READ_CONSTANT());
+                int count = READ_BYTE();
+
+                cwString* names[CW_REDUCTIONS_MAX];
+                uint8_t ops[CW_REDUCTIONS_MAX];
+                for (int i = 0; i < count; ++i)
+                {
+                    names[i] = AS_STRING(READ_CONSTANT());
+                    ops[i] = READ_BYTE();
+                }
+
+                /* the range and the reduction variables are replaced by the combined values */
+                cwValue* args = cw->vm.stack + cw->vm.stack_index - count - 2;
+                if (!cw_parallel_for(cw, body, args, names, ops, count)) return INTERPRET_RUNTIME_ERROR;
+                cw->vm.stack_index -= 2;
+                break;
+            }
+            case OP_VECTORIZE:
+            {
+                cwVectorLoop loop;
+                cw_vector_decode(frame->ip, &loop);
+                frame->ip += CW_VECTOR_OPERANDS;
+
+                /* skip the loop if it ran as a kernel */
+                if (cw_vector_loop(cw, &frame->function->chunk, frame->slots, &loop)) frame->ip += loop.skip;
+                break;
+            }
+            case OP_ARRAY:
+            {
+                int count = READ_BYTE();
+                cwValue* elements = cw->vm.stack + cw->vm.stack_index - count;
+
+                cwArrayType type = ARRAY_INT32;
+                for (int i = 0; i < count; ++i)
+                {
+                    if (!IS_NUMBER(elements[i]))
+                    {
+                        cw_runtime_error(cw, "Array elements must be numbers.");
+                        return INTERPRET_RUNTIME_ERROR;
+                    }
+                    if (IS_FLOAT(elements[i])) type = ARRAY_FLOAT32;
+                }
+
+                cwArray* array = cw_array_new(&cw->objects, cw->depth, type, count);
+                for (int i = 0; i < count; ++i) cw_array_set(array, i, elements[i]);
+
+                cw->vm.stack_index -= count;
+                PUSH(MAKE_OBJECT(array));
+                break;
+            }
+            case OP_INDEX_GET:
+            {
+                cwValue index = cw_pop_stack(cw);
+                cwValue target = cw_pop_stack(cw);
+                if (IS_MAP(target))
+                {
+                    if (!cw_check_key(cw, index)) return INTERPRET_RUNTIME_ERROR;
+
+                    /* missing keys read as null */
+                    cwValue* value = cw_map_find(AS_MAP(target), AS_STRING(index), NULL);
+                    PUSH(value ? *value : MAKE_NULL());
+                    break;
+                }
+
+                if (IS_COLUMNS(target))
+                {
+                    if (!cw_check_row(cw, AS_COLUMNS(target), index)) return INTERPRET_RUNTIME_ERROR;
+
+                    PUSH(MAKE_OBJECT(cw_row_new(&cw->objects, cw->depth, AS_COLUMNS(target), (uint32_t)AS_INT(index))));
+                    break;
+                }
+
+                if (!cw_check_index(cw, target, index)) return INTERPRET_RUNTIME_ERROR;
+
+                PUSH(cw_array_get(AS_ARRAY(target), AS_INT(index)));
+                break;
+            }
+            case OP_INDEX_SET:
+            {
+                cwValue value = cw_pop_stack(cw);
+                cwValue index = cw_pop_stack(cw);
+                cwValue target = cw_pop_stack(cw);
+                if (IS_MAP(target))
+                {
+                    /* the key is stored as well */
+                    if (!cw_check_key(cw, index)) return INTERPRET_RUNTIME_ERROR;
+                    if (!cw_check_store(cw, target, &index) || !cw_check_store(cw, target, &value)) return INTERPRET_RUNTIME_ERROR;
+
+                    cw_map_set(AS_MAP(target), AS_STRING(index), value, NULL);
+                    PUSH(value);
+                    break;
+                }
+
+                if (IS_COLUMNS(target))
+                {
+                    /* a record of the shape is stored into the row */
+                    if (!cw_check_row(cw, AS_COLUMNS(target), index)) return INTERPRET_RUNTIME_ERROR;
+                    if (!cw_check_element_write(cw, target))         return INTERPRET_RUNTIME_ERROR;
+                    if (!IS_RECORD(value) || !cw_columns_store(AS_COLUMNS(target), (uint32_t)AS_INT(index), AS_RECORD(value)))
+                    {
+                        cw_runtime_error(cw, "Expected a %s with numbers in every field.", AS_COLUMNS(target)->shape->name->raw);
+                        return INTERPRET_RUNTIME_ERROR;
+                    }
+
+                    PUSH(value);
+                    break;
+                }
+
+                if (!cw_check_index(cw, target, index))  return INTERPRET_RUNTIME_ERROR;
+                if (!cw_check_element_write(cw, target)) return INTERPRET_RUNTIME_ERROR;
+
+                if (!IS_NUMBER(value))
+                {
+                    cw_runtime_error(cw, "Array elements must be numbers.");
+                    return INTERPRET_RUNTIME_ERROR;
+                }
+
+                /* the assignment evaluates to the value */
+                cw_array_set(AS_ARRAY(target), AS_INT(index), value);
+                PUSH(value);
+                break;
+            }
+            case OP_MAP:
+            {
+                int count = READ_BYTE();
+                cwValue* entries = cw->vm.stack + cw->vm.stack_index - 2 * count;
+
+                cwMap* map = cw_map_new(&cw->objects, cw->depth);
+                for (int i = 0; i < count; ++i) cw_map_set(map, AS_STRING(entries[2 * i]), entries[2 * i + 1], NULL);
+
+                cw->vm.stack_index -= 2 * count;
+                PUSH(MAKE_OBJECT(map));
+                break;
+            }
+            case OP_MAP_GET:
+            {
+                cwString* key = AS_STRING(READ_CONSTANT());
+                uint32_t* cache = &frame->function->chunk.caches[READ_SHORT()];
+                cwValue target = cw_pop_stack(cw);
+                if (!IS_MAP(target))
+                {
+                    cw_runtime_error(cw, "Can only index maps with strings.");
+                    return INTERPRET_RUNTIME_ERROR;
+                }
+
+                cwValue* value = cw_map_find(AS_MAP(target), key, cache);
+                PUSH(value ? *value : MAKE_NULL());
+                break;
+            }
+            case OP_MAP_SET:
+            {
+                cwString* key = AS_STRING(READ_CONSTANT());
+                uint32_t* cache = &frame->function->chunk.caches[READ_SHORT()];
+                cwValue value = cw_pop_stack(cw);
+                cwValue target = cw_pop_stack(cw);
+                if (!IS_MAP(target))
+                {
+                    cw_runtime_error(cw, "Can only index maps with strings.");
+                    return INTERPRET_RUNTIME_ERROR;
+                }
+                if (!cw_check_store(cw, target, &value)) return INTERPRET_RUNTIME_ERROR;
+
+                cw_map_set(AS_MAP(target), key, value, cache);
+                PUSH(value);
+                break;
+            }
+            case OP_INVOKE:
+            {
+                cwString* name = AS_STRING(READ_CONSTANT());
+                int argc = READ_BYTE();
+                cwCallSite* site = &frame->function->chunk.sites[READ_SHORT()];
+                if (!cw_invoke(cw, name, argc, site)) return INTERPRET_RUNTIME_ERROR;
+                if (cw->blocked)
+                {
+                    cw->blocked = false;
+                    frame->ip -= 5;
+                    return INTERPRET_PREEMPTED;
+                }
+                frame = &cw->vm.frames[cw->vm.frame_count - 1];
+                if (cw->budget && --cw->budget == 0) return INTERPRET_PREEMPTED;
+                break;
+            }
+            case OP_GET_FIELD:
+            {
+                cwString* name = AS_STRING(READ_CONSTANT());
+                uint32_t* cache = &frame->function->chunk.caches[READ_SHORT()];
+                cwValue* top = &cw->vm.stack[cw->vm.stack_index - 1];
+                cwValue* field = IS_RECORD(*top) ? cw_record_field(AS_RECORD(*top), name, cache) : NULL;
+                if (field)
+                    *top = *field;
+                else if (!cw_get_field(cw, *top, name, cache, top))
+                    return INTERPRET_RUNTIME_ERROR;
+                break;
+            }
+            case OP_SET_FIELD:
+            {
+                cwString* name = AS_STRING(READ_CONSTANT());
+                uint32_t* cache = &frame->function->chunk.caches[READ_SHORT()];
+                cwValue value = cw_pop_stack(cw);
+                if (!cw_set_field(cw, cw_peek_stack(cw, 0), name, cache, value)) return INTERPRET_RUNTIME_ERROR;
+
+                cw->vm.stack[cw->vm.stack_index - 1] = value;
+                break;
+            }
+            case OP_ITERATE:
+            {
+                /* the loop keeps the iterated value, the position, the key and the value in locals */
+                cwValue* iter = frame->slots + READ_BYTE();
+                uint16_t offset = READ_SHORT();
+
+                uint32_t position = (uint32_t)AS_INT(iter[1]);
+                if (IS_MAP(iter[0]))
+                {
+                    cwString* key;
+                    if (cw_map_next(AS_MAP(iter[0]), &position, &key, &iter[3]))
+                    {
+                        iter[1] = MAKE_INT((int32_t)position);
+                        iter[2] = MAKE_OBJECT(key);
+                        break;
+                    }
+                }
+                else if (IS_COLUMNS(iter[0]))
+                {
+                    cwColumns* columns = AS_COLUMNS(iter[0]);
+                    if (position < cw_columns_len(columns))
+                    {
+                        /* the view of the last iteration moves on unless the loop replaced it */
+                        if (IS_ROW(iter[3]) && AS_ROW(iter[3])->columns == columns)
+                            AS_ROW(iter[3])->index = position;
+                        else
+                            iter[3] = MAKE_OBJECT(cw_row_new(&cw->objects, cw->depth, columns, position));
+
+                        iter[1] = MAKE_INT((int32_t)position + 1);
+                        iter[2] = MAKE_INT((int32_t)position);
+                        break;
+                    }
+                }
+                else if (IS_ARRAY(iter[0]))
+                {
+                    if (position < AS_ARRAY(iter[0])->len)
+                    {
+                        iter[1] = MAKE_INT((int32_t)position + 1);
+                        iter[2] = MAKE_INT((int32_t)position);
+                        iter[3] = cw_array_get(AS_ARRAY(iter[0]), position);
+                        break;
+                    }
+                }
+                else
+                {
+                    cw_runtime_error(cw, "Can only iterate over arrays, maps and columns.");
+                    return INTERPRET_RUNTIME_ERROR;
+                }
+
+                frame->ip += offset;
+                break;
+            }
+            case OP_YIELD:
+            {
+                if (!cw->coroutine && cw->budget)
+                {
+                    /* a fiber yields to the scheduler and resumes with null */
+                    cw_pop_stack(cw);
+                    PUSH(MAKE_NULL());
+                    return INTERPRET_PREEMPTED;
+                }
+
+                if (!cw->coroutine)
+                {
+                    cw_runtime_error(cw, "Can't yield outside of a coroutine.");
+                    return INTERPRET_RUNTIME_ERROR;
+                }
+
+                cw_suspend(cw, CO_SUSPENDED, cw_pop_stack(cw));
+                frame = &cw->vm.frames[cw->vm.frame_count - 1];
+                break;
+            }
         }
     }
 
 #undef BINARY_OP_NUM
+#undef PUSH
 #undef BINARY_OP_BOOL
 #undef READ_CONSTANT
+#undef READ_SHORT
 #undef READ_BYTE
 }
 
-InterpretResult cw_interpret(cwRuntime* cw, const char* src)
+static InterpretResult cw_run(cwRuntime* cw)
 {
-    cwChunk chunk;
-    cw_chunk_init(&chunk);
+    InterpretResult result = cw_execute(cw);
+    if (result == INTERPRET_OK || result == INTERPRET_PREEMPTED) return result;
 
-    InterpretResult result = INTERPRET_COMPILE_ERROR;
-    if (cw_compile(cw, src, &chunk))
+    /* errors end every coroutine up to the main context */
+    while (cw->coroutine)
     {
-        cw->chunk = &chunk;
-        cw->ip = cw->chunk->bytes;
+        cwCoroutine* coroutine = cw->coroutine;
+        coroutine->state = CO_DONE;
+        cw->coroutine = coroutine->caller;
+        coroutine->caller = NULL;
+        cw_swap_context(cw, coroutine);
+    }
+    cw_reset_stack(cw);
+    return result;
+}
+
+InterpretResult cw_interpret(cwRuntime* cw, const char* src)
+{
+    cwFunction* function = cw_compile(cw->engine, src);
+    if (!function) return INTERPRET_COMPILE_ERROR;
+
+    return cw_interpret_function(cw, function);
+}
 
-        result = cw_run(cw);
+InterpretResult cw_interpret_function(cwRuntime* cw, cwFunction* function)
+{
+    return cw_call_function(cw, function, NULL, 0, NULL);
+}
+
+bool cw_prepare_call(cwRuntime* cw, cwFunction* function, const cwValue* args, int argc)
+{
+    if (!cw_push_stack(cw, MAKE_OBJECT(function))) return false;
+    for (int i = 0; i < argc; ++i)
+    {
+        if (!cw_push_stack(cw, args[i])) return false;
     }
 
-    cw_chunk_free(&chunk);
-    return result;
+    return cw_call(cw, function, argc);
+}
+
+InterpretResult cw_continue(cwRuntime* cw, int budget)
+{
+    cw->budget = budget;
+    InterpretResult status = cw_run(cw);
+    cw->budget = 0;
+    return status;
+}
+
+bool cw_block(cwRuntime* cw)
+{
+    /* only fibers run with a budget */
+    if (!cw->budget) return false;
+
+    cw->blocked = true;
+    return true;
+}
+
+InterpretResult cw_call_function(cwRuntime* cw, cwFunction* function, const cwValue* args, int argc, cwValue* result)
+{
+    if (!cw_prepare_call(cw, function, args, argc)) return INTERPRET_RUNTIME_ERROR;
+
+    InterpretResult status = cw_run(cw);
+    if (status != INTERPRET_OK) return status;
+
+    cwValue value = cw_pop_stack(cw);
+    if (result) *result = value;
+    return INTERPRET_OK;
+}
+
+InterpretResult cw_interpret_image(cwRuntime* cw, const uint8_t* bytes, size_t len)
+{
+    cwFunction* function = cw_image_read(cw->engine, bytes, len);
+    if (!function) return INTERPRET_COMPILE_ERROR;
+
+    return cw_interpret_function(cw, function);
 }
 
 /* stack operations */
-void  cw_push_stack(cwRuntime* cw, cwValue val)
+static void cw_grow_stack(cwRuntime* cw)
 {
-    if (cw->stack_index >= CW_STACK_MAX)
+    size_t cap = CW_GROW_CAPACITY(cw->vm.stack_cap);
+    cwValue* stack = CW_ALLOCATE(cwValue, cap);
+    memcpy(stack, cw->vm.stack, sizeof(cwValue) * cw->vm.stack_index);
+
+    /* call frames point into the stack */
+    for (int i = 0; i < cw->vm.frame_count; ++i)
     {
-        cw_runtime_error(cw, "Stack overflow");
-        return;
+        cwCallFrame* frame = &cw->vm.frames[i];
+        frame->slots = stack + (frame->slots - cw->vm.stack);
+    }
+
+    CW_FREE_ARRAY(cwValue, cw->vm.stack, cw->vm.stack_cap);
+    cw->vm.stack = stack;
+    cw->vm.stack_cap = cap;
+}
+
+bool cw_push_stack(cwRuntime* cw, cwValue val)
+{
+    if (cw->vm.stack_index >= cw->vm.stack_cap)
+    {
+        if (cw->vm.stack_cap >= CW_STACK_MAX)
+        {
+            cw_runtime_error(cw, "Stack overflow.");
+            return false;
+        }
+        cw_grow_stack(cw);
     }
 
-    cw->stack[cw->stack_index++] = val;
+    cw->vm.stack[cw->vm.stack_index++] = val;
+    return true;
 }
 
-cwValue cw_pop_stack(cwRuntime* cw)         { return cw->stack[--cw->stack_index]; }
-void    cw_reset_stack(cwRuntime* cw)       { cw->stack_index = 0; }
-cwValue cw_peek_stack(cwRuntime* cw, int d) { return cw->stack[cw->stack_index - 1 - d]; }
\ No newline at end of file
+cwValue cw_pop_stack(cwRuntime* cw)         { return cw->vm.stack[--cw->vm.stack_index]; }
+void    cw_reset_stack(cwRuntime* cw)       { cw->vm.stack_index = 0; cw->vm.frame_count = 0; }
+cwValue cw_peek_stack(cwRuntime* cw, int d) { return cw->vm.stack[cw->vm.stack_index - 1 - d]; }
\ No newline at end of file
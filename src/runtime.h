@@ -8,55 +8,210 @@
 #include "common.h"
 #include "compiler.h"
 #include "table.h"
+#include "thread.h"
+#include "intern.h"
 
-#define DEBUG_PRINT_CODE
-#define DEBUG_TRACE_EXECUTION
-
-#define CW_STACK_MAX 256
+#define CW_FRAMES_INIT 8
+#define CW_FRAMES_MAX 64
+#define CW_STACK_INIT 256
+#define CW_STACK_MAX  (CW_FRAMES_MAX * (UINT8_MAX + 1))
 
 typedef enum
 {
     INTERPRET_OK,
     INTERPRET_COMPILE_ERROR,
-    INTERPRET_RUNTIME_ERROR
+    INTERPRET_RUNTIME_ERROR,
+    INTERPRET_PREEMPTED     /* the budget ran out, see cw_continue */
 } InterpretResult;
 
-struct cwRuntime
+typedef struct
+{
+    cwFunction* function;
+    uint8_t* ip;
+    cwValue* slots;
+} cwCallFrame;
+
+/*
+ * Execution state. Compiler and parser state are separate (see cwCompiler and
+ * cwParser) and only live during a compile. The value stack and the call
+ * frames start small and grow on demand up to CW_STACK_MAX and CW_FRAMES_MAX.
+ * The state is small enough to be swapped as a whole, which is how the VM
+ * switches between coroutines.
+ */
+typedef struct
 {
-    /* Compiler */
-    cwChunk* chunk;
+    size_t stack_index;
+    int frame_count;
+    cwValue* stack;
+    cwCallFrame* frames;
+    size_t stack_cap;
+    int frame_cap;
+} cwVM;
+
+/*
+ * A coroutine has a stack and call frames of its own. Resuming swaps them
+ * with the ones of the VM, so the coroutine keeps its context while the
+ * resumer's context is saved in the coroutine, and yielding swaps back.
+ * Switching never leaves cw_run and never touches the C stack.
+ */
+#define CW_COROUTINE_STACK_INIT  16
+#define CW_COROUTINE_FRAMES_INIT 2
 
-    cwLocal locals[UINT8_MAX + 1];
-    int local_count;
-    int scope_depth;
+typedef enum
+{
+    CO_SUSPENDED,
+    CO_RUNNING,
+    CO_DONE
+} cwCoroutineState;
 
-    /* Parser */
-    cwToken current;
-    cwToken previous;
-    
-    bool error;
-    bool panic;
+struct cwCoroutine
+{
+    cwObject obj;
+    cwFunction* function;
+    cwVM context;
+    cwCoroutine* caller;
+    cwCoroutineState state;
+    bool started;
+};
 
-    /* VM */
-    uint8_t* ip;
+cwCoroutine* cw_coroutine_new(cwRuntime* cw, cwFunction* function);
+
+/*
+ * The engine owns everything that is immutable once compiled: the interned
+ * literals and the compiled functions. Any number of runtimes (isolates)
+ * can share an engine, each with its own globals, stack and strings, and
+ * the runtimes may run on different threads. The lock serializes adding
+ * literals and functions to the engine. Runtimes count as references to
+ * their engine, which can only be freed after the last of them.
+ *
+ * Engines initialized with a shared intern table put their literals there
+ * instead of their own table, so literals stay pointer-equal across engines.
+ * The intern table has to outlive all engines that use it.
+ */
+struct cwEngine
+{
+    Table strings;
+    Table builtins;         /* natives visible to all runtimes after their globals */
+    cwInternTable* atoms;   /* optional, shared by several engines */
+    cwObject* objects;
+    cwScheduler* scheduler; /* workers for parallel loops, started on first use */
 
-    cwValue stack[CW_STACK_MAX];
-    size_t stack_index;
+    cwMutex lock;
+    int runtimes;
+};
+
+void cw_engine_init(cwEngine* engine, cwInternTable* atoms);
+bool cw_engine_free(cwEngine* engine);
+
+cwScheduler* cw_engine_scheduler(cwEngine* engine);
+
+/* moves the functions and shapes of src into dst and interns their literals in dst */
+void cw_engine_merge(cwEngine* dst, cwEngine* src);
+
+/* builtins should be defined before runtimes use the engine */
+void cw_define_native(cwEngine* engine, const char* name, cwNativeFn fn, int arity);
+
+/*
+ * A forked runtime refers to the runtime it was forked from as its parent.
+ * Globals and strings are looked up in the runtime first and then along the
+ * parent chain, while writes always go to the runtime itself. A global of a
+ * parent is therefore copied into the fork on the first assignment, and
+ * containers of a parent are read only in the fork, see cw_check_write.
+ * Parents must outlive their forks and must not run code while forks exist.
+ */
+struct cwRuntime
+{
+    cwVM vm;
+    cwEngine* engine;
+    const cwRuntime* parent;
+    cwRuntime* host;        /* a parent whose containers the fork may modify, see cw_export */
+    uint8_t depth;          /* number of parents */
+    bool shared_arrays;     /* elements of arrays and columns of parents can be set, see cw_parallel_for */
+    cwCoroutine* coroutine; /* the running coroutine, NULL for the main context */
+    int budget;             /* safepoints left before preemption, 0 never preempts */
+    bool blocked;           /* a native asked to be called again, see cw_block */
 
     Table globals;
-    Table strings;
+    Table strings;  /* strings created at runtime that are not literals */
 
     /* Garbage Collection */
     cwObject* objects;
 };
 
-void cw_init(cwRuntime* cw);
+void cw_init(cwRuntime* cw, cwEngine* engine);
 void cw_free(cwRuntime* cw);
 
+void cw_fork(cwRuntime* cw, const cwRuntime* parent);
+
+/*
+ * Resetting prepares a runtime for the next job without giving its memory
+ * back: the stack and the tables keep their capacity and the literals and
+ * functions of the engine are untouched. Freeing the heap also clears the
+ * stack and the globals, since they may refer to objects of the heap.
+ */
+#define CW_RESET_STACK   0x01
+#define CW_RESET_GLOBALS 0x02
+#define CW_RESET_HEAP    0x04
+#define CW_RESET_ALL     (CW_RESET_STACK | CW_RESET_GLOBALS | CW_RESET_HEAP)
+
+void cw_reset(cwRuntime* cw, int flags);
+
+/*
+ * Arrays, maps, records and columns belong to the runtime that created them.
+ * A fork reads the containers of its parents but may not modify them: the
+ * parent and other forks would see the change, and objects of the fork
+ * stored into them would be freed with the fork. Frozen containers can't be
+ * modified by anyone. cw_check_write reports the error.
+ *
+ * A fork that runs callbacks for its parent may get the parent as its host.
+ * It can modify the containers of the host then, and values stored into
+ * them are exported first.
+ */
+bool cw_is_writable(const cwRuntime* cw, cwValue target);
+bool cw_check_write(cwRuntime* cw, cwValue target);
+
+/* setting an element does not move the storage of an array, unlike push */
+bool cw_is_element_writable(const cwRuntime* cw, cwValue target);
+
+/*
+ * Copies the arrays, maps, records and strings of a fork in the value into
+ * the heap of its host, deeply. Values of the host, its parents and frozen
+ * values are kept. Other objects of the fork can't be exported.
+ */
+bool cw_export(cwRuntime* cw, cwValue* value);
+
+/* globals */
+cwValue* cw_find_global(const cwRuntime* cw, const cwString* name);
+bool     cw_set_global(cwRuntime* cw, cwString* name, cwValue val); /* false if the global is not defined */
+
 InterpretResult cw_interpret(cwRuntime* cw, const char* src);
+InterpretResult cw_interpret_function(cwRuntime* cw, cwFunction* function);
+InterpretResult cw_interpret_image(cwRuntime* cw, const uint8_t* bytes, size_t len);
+
+/* calls a function with arguments, the result is optional */
+InterpretResult cw_call_function(cwRuntime* cw, cwFunction* function, const cwValue* args, int argc, cwValue* result);
+
+/*
+ * Preemptible execution for fibers. cw_prepare_call sets up the call without
+ * running it. cw_continue runs until the call returns or the budget of
+ * safepoints (loop back-edges and calls) runs out, in which case it returns
+ * INTERPRET_PREEMPTED and a later cw_continue picks up where it stopped,
+ * possibly on another thread. A yield outside of a coroutine gives up the
+ * rest of the budget. The result of a finished call is left on the stack.
+ */
+bool            cw_prepare_call(cwRuntime* cw, cwFunction* function, const cwValue* args, int argc);
+InterpretResult cw_continue(cwRuntime* cw, int budget);
+
+/*
+ * A native that can not make progress calls cw_block and returns true. In a
+ * fiber the call is then suspended and made again when the fiber resumes, so
+ * the worker runs other fibers meanwhile. Elsewhere cw_block returns false
+ * and the native has to wait on its own.
+ */
+bool cw_block(cwRuntime* cw);
 
 /* stack operations */
-void    cw_push_stack(cwRuntime* cw, cwValue val);
+bool    cw_push_stack(cwRuntime* cw, cwValue val); /* false if the stack is full */
 cwValue cw_pop_stack(cwRuntime* cw);
 void    cw_reset_stack(cwRuntime* cw);
 cwValue cw_peek_stack(cwRuntime* cw, int distance); /* TODO: make peek return a pointer */
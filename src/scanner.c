@@ -1,7 +1,7 @@
 #include "scanner.h"
 
 #include "debug.h"
-#include "runtime.h"
+#include "parser.h"
 
 #include <string.h>
 
@@ -44,7 +44,16 @@ static cwTokenType cw_identifier_type(const char* start, const char* stream)
     case 'c': return cw_check_keyword(start, stream, 1, "ontinue", TOKEN_CONTINUE);
     case 'd': return cw_check_keyword(start, stream, 1, "atatype", TOKEN_DATATYPE);
     case 'e': return cw_check_keyword(start, stream, 1, "lse", TOKEN_ELSE);
-    case 'i': return cw_check_keyword(start, stream, 1, "f", TOKEN_IF);
+    case 'i':
+        if (stream - start > 1)
+        {
+            switch (start[1])
+            {
+            case 'f': return cw_check_keyword(start, stream, 2, "", TOKEN_IF);
+            case 'n': return cw_check_keyword(start, stream, 2, "", TOKEN_IN);
+            }
+        }
+        break;
     case 'f':
         if (stream - start > 1)
         {
@@ -59,16 +68,36 @@ static cwTokenType cw_identifier_type(const char* start, const char* stream)
     case 'l': return cw_check_keyword(start, stream, 1, "et", TOKEN_LET);
     case 'm': return cw_check_keyword(start, stream, 1, "ut", TOKEN_MUT);
     case 'n': return cw_check_keyword(start, stream, 1, "ull", TOKEN_NULL);
-    case 'p': return cw_check_keyword(start, stream, 1, "rint", TOKEN_PRINT);
-    case 'r': return cw_check_keyword(start, stream, 1, "eturn", TOKEN_RETURN);
-    case 't': return cw_check_keyword(start, stream, 1, "rue", TOKEN_RETURN);
+    case 'p':
+        if (stream - start > 1)
+        {
+            switch (start[1])
+            {
+            case 'a': return cw_check_keyword(start, stream, 2, "rallel", TOKEN_PARALLEL);
+            case 'r': return cw_check_keyword(start, stream, 2, "int", TOKEN_PRINT);
+            }
+        }
+        break;
+    case 'r':
+        if (stream - start > 2 && start[1] == 'e')
+        {
+            switch (start[2])
+            {
+            case 'd': return cw_check_keyword(start, stream, 3, "uce", TOKEN_REDUCE);
+            case 's': return cw_check_keyword(start, stream, 3, "ume", TOKEN_RESUME);
+            case 't': return cw_check_keyword(start, stream, 3, "urn", TOKEN_RETURN);
+            }
+        }
+        break;
+    case 't': return cw_check_keyword(start, stream, 1, "rue", TOKEN_TRUE);
     case 'w': return cw_check_keyword(start, stream, 1, "hile", TOKEN_WHILE);
+    case 'y': return cw_check_keyword(start, stream, 1, "ield", TOKEN_YIELD);
     }
 
     return TOKEN_IDENTIFIER;
 }
 
-const char* cw_scan_token(cwRuntime* cw, cwToken* token, const char* cursor, int line)
+const char* cw_scan_token(cwParser* parser, cwToken* token, const char* cursor, int line)
 {
 #define CW_TOKEN_CASE1(c, t) case c: token->type = t; cursor++; break;
 #define CW_TOKEN_CASE2(c1, t1, c2, t2) case c1:             \
@@ -125,7 +154,7 @@ const char* cw_scan_token(cwRuntime* cw, cwToken* token, const char* cursor, int
         {
             if (*cursor == '\0' || *cursor == '\n')
             {
-                cw_syntax_error(cw, line, "Unterminated string.");
+                cw_syntax_error(parser, line, "Unterminated string.");
                 return cursor;
             }
             cursor++;
@@ -141,7 +170,7 @@ const char* cw_scan_token(cwRuntime* cw, cwToken* token, const char* cursor, int
     CW_TOKEN_CASE1('}', TOKEN_RBRACE)
     CW_TOKEN_CASE1('[', TOKEN_LBRACKET)
     CW_TOKEN_CASE1(']', TOKEN_RBRACKET)
-    CW_TOKEN_CASE1('.', TOKEN_PERIOD)
+    CW_TOKEN_CASE2('.', TOKEN_PERIOD,   '.', TOKEN_RANGE)
     CW_TOKEN_CASE1(',', TOKEN_COMMA)
     CW_TOKEN_CASE1(':', TOKEN_COLON)
     CW_TOKEN_CASE1(';', TOKEN_SEMICOLON)
@@ -156,7 +185,7 @@ const char* cw_scan_token(cwRuntime* cw, cwToken* token, const char* cursor, int
     CW_TOKEN_CASE2('<', TOKEN_LT,           '=', TOKEN_LTEQ)
     CW_TOKEN_CASE2('>', TOKEN_GT,           '=', TOKEN_GTEQ)
     default:
-        cw_syntax_error(cw, line, "Unexpected character.");
+        cw_syntax_error(parser, line, "Unexpected character.");
         return ++cursor;
     }
 
@@ -31,6 +31,7 @@ typedef enum
     TOKEN_INC,      TOKEN_DEC,
     TOKEN_BIT_AND,  TOKEN_BIT_OR,
     TOKEN_AND,      TOKEN_OR,
+    TOKEN_RANGE,
 
     /* comparison tokens */
     TOKEN_EQ, TOKEN_NOTEQ,
@@ -58,7 +59,12 @@ typedef enum
     TOKEN_FUNC,
     TOKEN_DATATYPE,
     TOKEN_RETURN,
-    TOKEN_PRINT
+    TOKEN_PRINT,
+    TOKEN_RESUME,
+    TOKEN_YIELD,
+    TOKEN_IN,
+    TOKEN_PARALLEL,
+    TOKEN_REDUCE
 } cwTokenType;
 
 typedef enum
@@ -78,7 +84,7 @@ struct cwToken
     int line;
 };
 
-const char* cw_scan_token(cwRuntime* cw, cwToken* token, const char* cursor, int line);
+const char* cw_scan_token(cwParser* parser, cwToken* token, const char* cursor, int line);
 
 int cw_token_get_base(const cwToken* token);
 
@@ -0,0 +1,436 @@
+#include "scheduler.h"
+
+#include <stdio.h>
+
+#include "memory.h"
+
+/* the worker running on the current thread, if any */
+static __thread cwWorker* cw_current_worker = NULL;
+
+bool cw_job_init(cwJob* job, cwFunction* function, const cwValue* args, int argc)
+{
+    if (argc > CW_JOB_ARGS_MAX) return false;
+
+    job->function = function;
+    for (int i = 0; i < argc; ++i) job->args[i] = args[i];
+    job->argc = argc;
+    job->task = NULL;
+    job->data = NULL;
+
+    job->status = INTERPRET_OK;
+    job->result = MAKE_NULL();
+    job->fiber = false;
+    job->owned = false;
+    job->runtime = NULL;
+    job->worker = -1;
+
+    job->done = 0;
+    job->next = NULL;
+    return true;
+}
+
+void cw_job_init_task(cwJob* job, cwJobTask task, void* data)
+{
+    cw_job_init(job, NULL, NULL, 0);
+    job->task = task;
+    job->data = data;
+}
+
+/* --------------------------| deque |--------------------------------------------------- */
+#define CW_DEQUE_MASK (CW_DEQUE_SIZE - 1)
+
+static void cw_deque_init(cwDeque* deque)
+{
+    deque->top = 0;
+    deque->bottom = 0;
+}
+
+static bool cw_deque_push(cwDeque* deque, cwJob* job)
+{
+    int64_t bottom = CW_ATOMIC_LOAD_RELAXED(&deque->bottom);
+    int64_t top = CW_ATOMIC_LOAD(&deque->top);
+    if (bottom - top >= CW_DEQUE_SIZE) return false;
+
+    CW_ATOMIC_STORE_RELAXED(&deque->jobs[bottom & CW_DEQUE_MASK], job);
+    CW_ATOMIC_STORE(&deque->bottom, bottom + 1);
+    return true;
+}
+
+static int64_t cw_deque_free_slots(cwDeque* deque)
+{
+    return CW_DEQUE_SIZE - (CW_ATOMIC_LOAD_RELAXED(&deque->bottom) - CW_ATOMIC_LOAD(&deque->top));
+}
+
+static cwJob* cw_deque_pop(cwDeque* deque)
+{
+    int64_t bottom = CW_ATOMIC_LOAD_RELAXED(&deque->bottom) - 1;
+    CW_ATOMIC_STORE_RELAXED(&deque->bottom, bottom);
+    CW_ATOMIC_FENCE();
+    int64_t top = CW_ATOMIC_LOAD_RELAXED(&deque->top);
+
+    if (top > bottom)
+    {
+        /* empty */
+        CW_ATOMIC_STORE_RELAXED(&deque->bottom, bottom + 1);
+        return NULL;
+    }
+
+    cwJob* job = CW_ATOMIC_LOAD_RELAXED(&deque->jobs[bottom & CW_DEQUE_MASK]);
+    if (top == bottom)
+    {
+        /* the last job, race against thieves */
+        if (!CW_ATOMIC_CAS(&deque->top, &top, top + 1)) job = NULL;
+        CW_ATOMIC_STORE_RELAXED(&deque->bottom, bottom + 1);
+    }
+    return job;
+}
+
+static cwJob* cw_deque_steal(cwDeque* deque)
+{
+    int64_t top = CW_ATOMIC_LOAD(&deque->top);
+    CW_ATOMIC_FENCE();
+    int64_t bottom = CW_ATOMIC_LOAD(&deque->bottom);
+    if (top >= bottom) return NULL;
+
+    cwJob* job = CW_ATOMIC_LOAD_RELAXED(&deque->jobs[top & CW_DEQUE_MASK]);
+    return CW_ATOMIC_CAS(&deque->top, &top, top + 1) ? job : NULL;
+}
+
+/* --------------------------| worker |-------------------------------------------------- */
+static cwJob* cw_next_job(cwWorker* worker)
+{
+    cwScheduler* scheduler = worker->scheduler;
+
+    cwJob* job = cw_deque_pop(&worker->deque);
+    if (job) return job;
+
+    /* refill the deque with a batch of queued jobs, the others can steal them */
+    int64_t batch = cw_deque_free_slots(&worker->deque);
+    if (batch > CW_JOB_BATCH) batch = CW_JOB_BATCH;
+
+    int taken = 0;
+    cw_mutex_lock(&scheduler->lock);
+    while (scheduler->head && taken < batch)
+    {
+        cwJob* next = scheduler->head;
+        scheduler->head = next->next;
+        if (!scheduler->head) scheduler->tail = NULL;
+
+        if (taken++ == 0) job = next;
+        else              cw_deque_push(&worker->deque, next);
+    }
+    cw_mutex_unlock(&scheduler->lock);
+
+    if (taken > 0)
+    {
+        worker->stats.batches++;
+        if (taken > 1) cw_cond_broadcast(&scheduler->work);
+        return job;
+    }
+
+    for (int i = 1; i < scheduler->worker_count; ++i)
+    {
+        cwWorker* victim = &scheduler->workers[(worker->index + i) % scheduler->worker_count];
+        job = cw_deque_steal(&victim->deque);
+        if (job)
+        {
+            worker->stats.stolen++;
+            return job;
+        }
+    }
+    return NULL;
+}
+
+/* strings of the result are interned into the engine to survive the reset of the runtime */
+static cwValue cw_job_keep(cwEngine* engine, cwValue value)
+{
+    if (!IS_STRING(value)) return value;
+
+    cwString* str = AS_STRING(value);
+    cw_mutex_lock(&engine->lock);
+    str = cw_str_intern(engine, str->raw, str->len);
+    cw_mutex_unlock(&engine->lock);
+    return MAKE_OBJECT(str);
+}
+
+static void cw_enqueue(cwScheduler* scheduler, cwWorker* worker, cwJob* job);
+
+/* runs a time slice of a fiber, returns false if the fiber was preempted */
+static bool cw_run_fiber(cwWorker* worker, cwJob* job, cwValue* result)
+{
+    cwScheduler* scheduler = worker->scheduler;
+
+    if (!job->runtime)
+    {
+        job->runtime = CW_ALLOCATE(cwRuntime, 1);
+        job->owned = true;
+        if (scheduler->template) cw_fork(job->runtime, scheduler->template);
+        else                     cw_init(job->runtime, scheduler->engine);
+
+        job->status = cw_prepare_call(job->runtime, job->function, job->args, job->argc) ? INTERPRET_OK : INTERPRET_RUNTIME_ERROR;
+    }
+    else if (job->worker >= 0 && job->worker != worker->index)
+    {
+        worker->stats.migrated++;
+    }
+    job->worker = worker->index;
+
+    if (job->status == INTERPRET_OK) job->status = cw_continue(job->runtime, scheduler->quantum);
+
+    if (job->status == INTERPRET_PREEMPTED)
+    {
+        worker->stats.preempted++;
+        job->status = INTERPRET_OK;
+        cw_enqueue(scheduler, worker, job);
+        return false;
+    }
+
+    if (job->status == INTERPRET_OK) *result = cw_job_keep(scheduler->engine, cw_pop_stack(job->runtime));
+
+    if (job->owned)
+    {
+        cw_free(job->runtime);
+        CW_FREE_ARRAY(cwRuntime, job->runtime, 1);
+        job->runtime = NULL;
+    }
+    return true;
+}
+
+/* a nested job runs while a job that waits holds the runtime of the worker */
+static void cw_run_job(cwWorker* worker, cwJob* job, bool nested)
+{
+    cwScheduler* scheduler = worker->scheduler;
+    CW_ATOMIC_SUB(&scheduler->pending, 1);
+
+    cwValue result = MAKE_NULL();
+    if (job->task)
+    {
+        job->task(job->data);
+    }
+    else if (job->fiber)
+    {
+        if (!cw_run_fiber(worker, job, &result)) return;
+    }
+    else if (nested)
+    {
+        /* resetting the runtime of the worker would wipe the job that waits, this one gets its own */
+        cwRuntime runtime;
+        if (scheduler->template) cw_fork(&runtime, scheduler->template);
+        else                     cw_init(&runtime, scheduler->engine);
+
+        job->status = cw_call_function(&runtime, job->function, job->args, job->argc, &result);
+        if (job->status == INTERPRET_OK) result = cw_job_keep(scheduler->engine, result);
+        cw_free(&runtime);
+    }
+    else
+    {
+        job->status = cw_call_function(&worker->runtime, job->function, job->args, job->argc, &result);
+        if (job->status == INTERPRET_OK) result = cw_job_keep(scheduler->engine, result);
+        cw_reset(&worker->runtime, CW_RESET_ALL);
+    }
+    job->result = job->status == INTERPRET_OK ? result : MAKE_NULL();
+
+    worker->stats.executed++;
+    if (job->status != INTERPRET_OK) worker->stats.failed++;
+
+    CW_ATOMIC_STORE_SEQ(&job->done, 1);
+    CW_ATOMIC_SUB(&scheduler->outstanding, 1);
+
+    /* pairs with the fence in cw_scheduler_wait, either side sees the other */
+    CW_ATOMIC_FENCE();
+    if (CW_ATOMIC_LOAD_SEQ(&scheduler->waiters) > 0)
+    {
+        cw_mutex_lock(&scheduler->lock);
+        cw_cond_broadcast(&scheduler->done);
+        cw_mutex_unlock(&scheduler->lock);
+    }
+}
+
+static void* cw_worker_main(void* arg)
+{
+    cwWorker* worker = arg;
+    cwScheduler* scheduler = worker->scheduler;
+    cw_current_worker = worker;
+
+    while (true)
+    {
+        cwJob* job = cw_next_job(worker);
+        if (job)
+        {
+            cw_run_job(worker, job, false);
+            continue;
+        }
+
+        /* jobs are pending but in the hands of other workers */
+        if (CW_ATOMIC_LOAD(&scheduler->pending) > 0)
+        {
+            cw_thread_yield();
+            continue;
+        }
+
+        cw_mutex_lock(&scheduler->lock);
+        while (CW_ATOMIC_LOAD(&scheduler->pending) == 0 && !scheduler->stop)
+        {
+            cw_cond_wait(&scheduler->work, &scheduler->lock);
+        }
+        bool stop = scheduler->stop && CW_ATOMIC_LOAD(&scheduler->pending) == 0;
+        cw_mutex_unlock(&scheduler->lock);
+
+        if (stop) break;
+    }
+
+    cw_current_worker = NULL;
+    return NULL;
+}
+
+/* --------------------------| scheduler |----------------------------------------------- */
+void cw_scheduler_init(cwScheduler* scheduler, cwEngine* engine, const cwRuntime* template, int workers)
+{
+    if (workers <= 0) workers = cw_thread_count();
+
+    scheduler->engine = engine;
+    scheduler->template = template;
+    scheduler->quantum = CW_FIBER_QUANTUM;
+    scheduler->worker_count = workers;
+    scheduler->head = NULL;
+    scheduler->tail = NULL;
+    scheduler->pending = 0;
+    scheduler->outstanding = 0;
+    scheduler->waiters = 0;
+    scheduler->stop = false;
+
+    cw_mutex_init(&scheduler->lock);
+    cw_cond_init(&scheduler->work);
+    cw_cond_init(&scheduler->done);
+
+    /* all workers exist before the first thread starts stealing */
+    scheduler->workers = CW_ALLOCATE(cwWorker, workers);
+    for (int i = 0; i < workers; ++i)
+    {
+        cwWorker* worker = &scheduler->workers[i];
+        worker->scheduler = scheduler;
+        worker->index = i;
+        worker->stats = (cwWorkerStats){ 0 };
+        cw_deque_init(&worker->deque);
+
+        if (template) cw_fork(&worker->runtime, template);
+        else          cw_init(&worker->runtime, engine);
+    }
+
+    for (int i = 0; i < workers; ++i)
+    {
+        cwWorker* worker = &scheduler->workers[i];
+        cw_thread_create(&worker->thread, cw_worker_main, worker);
+    }
+}
+
+void cw_scheduler_free(cwScheduler* scheduler)
+{
+    /* workers finish the pending jobs before they stop */
+    cw_mutex_lock(&scheduler->lock);
+    scheduler->stop = true;
+    cw_cond_broadcast(&scheduler->work);
+    cw_mutex_unlock(&scheduler->lock);
+
+    for (int i = 0; i < scheduler->worker_count; ++i)
+    {
+        cw_thread_join(scheduler->workers[i].thread);
+        cw_free(&scheduler->workers[i].runtime);
+    }
+
+    CW_FREE_ARRAY(cwWorker, scheduler->workers, scheduler->worker_count);
+    scheduler->workers = NULL;
+    scheduler->worker_count = 0;
+
+    cw_cond_free(&scheduler->done);
+    cw_cond_free(&scheduler->work);
+    cw_mutex_free(&scheduler->lock);
+}
+
+/* makes a job runnable in the deque of the worker, or in the queue if there is none or it is full */
+static void cw_enqueue(cwScheduler* scheduler, cwWorker* worker, cwJob* job)
+{
+    /* counted first, so a worker stealing the job never sees a negative count */
+    CW_ATOMIC_ADD(&scheduler->pending, 1);
+    bool local = worker && cw_deque_push(&worker->deque, job);
+
+    cw_mutex_lock(&scheduler->lock);
+    if (!local)
+    {
+        job->next = NULL;
+        if (scheduler->tail) scheduler->tail->next = job;
+        else                 scheduler->head = job;
+        scheduler->tail = job;
+    }
+    cw_cond_signal(&scheduler->work);
+    cw_mutex_unlock(&scheduler->lock);
+}
+
+void cw_scheduler_submit(cwScheduler* scheduler, cwJob* job)
+{
+    job->done = 0;
+    CW_ATOMIC_ADD(&scheduler->outstanding, 1);
+
+    /* jobs submitted by a job go to the deque of its worker */
+    cwWorker* worker = cw_current_worker;
+    cw_enqueue(scheduler, worker && worker->scheduler == scheduler ? worker : NULL, job);
+}
+
+void cw_scheduler_spawn(cwScheduler* scheduler, cwJob* job)
+{
+    job->fiber = true;
+    cw_scheduler_submit(scheduler, job);
+}
+
+/* waits until the counter is zero, workers run other jobs instead of blocking */
+static void cw_scheduler_wait(cwScheduler* scheduler, int* counter, int until)
+{
+    cwWorker* worker = cw_current_worker;
+    if (worker && worker->scheduler == scheduler)
+    {
+        while (CW_ATOMIC_LOAD_SEQ(counter) != until)
+        {
+            cwJob* job = cw_next_job(worker);
+            if (job) cw_run_job(worker, job, true);
+            else     cw_thread_yield();
+        }
+        return;
+    }
+
+    cw_mutex_lock(&scheduler->lock);
+    CW_ATOMIC_ADD(&scheduler->waiters, 1);
+    CW_ATOMIC_FENCE();
+    while (CW_ATOMIC_LOAD_SEQ(counter) != until)
+    {
+        cw_cond_wait(&scheduler->done, &scheduler->lock);
+    }
+    CW_ATOMIC_SUB(&scheduler->waiters, 1);
+    cw_mutex_unlock(&scheduler->lock);
+}
+
+void cw_scheduler_await(cwScheduler* scheduler, cwJob* job)
+{
+    cw_scheduler_wait(scheduler, &job->done, 1);
+}
+
+void cw_scheduler_await_all(cwScheduler* scheduler)
+{
+    cw_scheduler_wait(scheduler, &scheduler->outstanding, 0);
+}
+
+void cw_scheduler_stats(const cwScheduler* scheduler, int worker, cwWorkerStats* stats)
+{
+    *stats = scheduler->workers[worker].stats;
+}
+
+void cw_scheduler_print_stats(const cwScheduler* scheduler)
+{
+    for (int i = 0; i < scheduler->worker_count; ++i)
+    {
+        const cwWorkerStats* stats = &scheduler->workers[i].stats;
+        printf("worker %2d: %llu executed, %llu stolen, %llu batches, %llu failed, %llu preempted, %llu migrated\n", i,
+            (unsigned long long)stats->executed, (unsigned long long)stats->stolen,
+            (unsigned long long)stats->batches, (unsigned long long)stats->failed,
+            (unsigned long long)stats->preempted, (unsigned long long)stats->migrated);
+    }
+}
@@ -0,0 +1,123 @@
+#ifndef CLOCKWORK_SCHEDULER_H
+#define CLOCKWORK_SCHEDULER_H
+
+#include "runtime.h"
+
+#define CW_JOB_ARGS_MAX 8
+#define CW_DEQUE_SIZE   256 /* power of two */
+#define CW_JOB_BATCH    16  /* jobs a worker takes from the queue at once */
+#define CW_FIBER_QUANTUM 1024 /* safepoints a fiber runs before it is preempted */
+
+typedef void (*cwJobTask)(void* data);
+
+/*
+ * A job calls a compiled function with arguments on one of the workers.
+ * Arguments must not refer to objects of a runtime; strings in the result
+ * are interned into the engine, so the result outlives the worker's reset.
+ *
+ * A job spawned as a fiber runs in a runtime of its own instead of the
+ * worker's. Fibers are preempted at safepoints or when they yield and go
+ * back to the deque of their worker, from where any other worker can steal
+ * them, so fibers migrate between threads while they are suspended.
+ * A fiber can also be given a runtime prepared with cw_prepare_call, which
+ * is left to the owner of the job when the fiber finishes.
+ *
+ * A task job runs a C function instead, for natives that spread their own
+ * work over the workers. Tasks must not touch the runtime of the worker.
+ */
+typedef struct cwJob
+{
+    cwFunction* function;
+    cwValue args[CW_JOB_ARGS_MAX];
+    int argc;
+
+    cwJobTask task;
+    void* data;
+
+    bool fiber;
+    bool owned;         /* the runtime was created for the fiber and is freed with it */
+    cwRuntime* runtime; /* runtime of a started fiber */
+    int worker;         /* worker that ran the fiber last */
+
+    InterpretResult status;
+    cwValue result;
+    int done;
+
+    struct cwJob* next; /* link in the queue of submitted jobs */
+} cwJob;
+
+bool cw_job_init(cwJob* job, cwFunction* function, const cwValue* args, int argc);
+void cw_job_init_task(cwJob* job, cwJobTask task, void* data);
+
+/*
+ * Work-stealing deque (Chase-Lev). Only the owning worker pushes and pops at
+ * the bottom, any other worker steals from the top.
+ */
+typedef struct
+{
+    int64_t top;
+    int64_t bottom;
+    cwJob* jobs[CW_DEQUE_SIZE];
+} cwDeque;
+
+/* counters are updated by the worker only and read without synchronization */
+typedef struct
+{
+    uint64_t executed;  /* jobs run by the worker */
+    uint64_t stolen;    /* jobs taken from the deque of another worker */
+    uint64_t batches;   /* times the worker refilled its deque from the queue */
+    uint64_t failed;    /* jobs that ended with an error */
+    uint64_t preempted; /* times a fiber was suspended on the worker */
+    uint64_t migrated;  /* fibers resumed on the worker after running on another */
+} cwWorkerStats;
+
+typedef struct
+{
+    cwScheduler* scheduler;
+    cwRuntime runtime;
+    cwThread thread;
+    cwDeque deque;
+    cwWorkerStats stats;
+    int index;
+} cwWorker;
+
+/*
+ * The scheduler runs jobs on a fixed set of worker threads, each with its
+ * own runtime. Submitted jobs are queued; an idle worker takes a batch of
+ * them into its deque and workers without work steal from the others, so a
+ * long job never blocks the jobs queued behind it. Runtimes are reset after
+ * every job, so jobs never see each other's globals.
+ */
+struct cwScheduler
+{
+    cwEngine* engine;
+    const cwRuntime* template;
+    int quantum;        /* safepoints per time slice of a fiber */
+    cwWorker* workers;
+    int worker_count;
+
+    cwMutex lock;
+    cwCond work;        /* signaled when jobs are submitted */
+    cwCond done;        /* signaled when jobs complete and someone waits */
+    cwJob* head;
+    cwJob* tail;
+
+    int pending;        /* jobs submitted but not started */
+    int outstanding;    /* jobs submitted but not completed */
+    int waiters;
+    bool stop;
+};
+
+/* workers fork the template if given, a count of 0 uses one worker per processor */
+void cw_scheduler_init(cwScheduler* scheduler, cwEngine* engine, const cwRuntime* template, int workers);
+void cw_scheduler_free(cwScheduler* scheduler);
+
+void cw_scheduler_submit(cwScheduler* scheduler, cwJob* job);
+void cw_scheduler_spawn(cwScheduler* scheduler, cwJob* job);
+void cw_scheduler_await(cwScheduler* scheduler, cwJob* job);
+void cw_scheduler_await_all(cwScheduler* scheduler);
+
+void cw_scheduler_stats(const cwScheduler* scheduler, int worker, cwWorkerStats* stats);
+void cw_scheduler_print_stats(const cwScheduler* scheduler);
+
+#endif /* !CLOCKWORK_SCHEDULER_H */
@@ -0,0 +1,743 @@
+#include "snapshot.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "memory.h"
+#include "runtime.h"
+#include "array.h"
+#include "map.h"
+#include "record.h"
+
+/* --------------------------| buffer |--------------------------------------------------- */
+void cw_buffer_init(cwBuffer* buffer)
+{
+    buffer->bytes = NULL;
+    buffer->len = 0;
+    buffer->cap = 0;
+}
+
+void cw_buffer_free(cwBuffer* buffer)
+{
+    CW_FREE_ARRAY(uint8_t, buffer->bytes, buffer->cap);
+    cw_buffer_init(buffer);
+}
+
+/* --------------------------| writer |--------------------------------------------------- */
+typedef struct
+{
+    cwBuffer* buffer;
+    Table pool;     /* maps strings to their index in the image */
+    uint32_t count;
+
+    /* shapes by their index in the image, records refer to them too */
+    const cwShape** shapes;
+    uint32_t shape_count;
+    uint32_t shape_cap;
+
+    int depth;      /* nesting of maps and records */
+    bool compiled;  /* functions have to be compiled, chunk images carry no source */
+} cwWriter;
+
+static void cw_writer_init(cwWriter* writer, cwBuffer* buffer)
+{
+    writer->buffer = buffer;
+    cw_table_init(&writer->pool);
+    writer->count = 0;
+    writer->shapes = NULL;
+    writer->shape_count = 0;
+    writer->shape_cap = 0;
+    writer->depth = 0;
+    writer->compiled = false;
+}
+
+static void cw_writer_free(cwWriter* writer)
+{
+    cw_table_free(&writer->pool);
+    CW_FREE_ARRAY(const cwShape*, writer->shapes, writer->shape_cap);
+}
+
+static void cw_write_bytes(cwWriter* writer, const void* src, size_t size)
+{
+    cwBuffer* buffer = writer->buffer;
+    if (buffer->cap < buffer->len + size)
+    {
+        size_t old_cap = buffer->cap;
+        while (buffer->cap < buffer->len + size) buffer->cap = CW_GROW_CAPACITY(buffer->cap);
+        buffer->bytes = CW_GROW_ARRAY(uint8_t, buffer->bytes, old_cap, buffer->cap);
+    }
+
+    memcpy(buffer->bytes + buffer->len, src, size);
+    buffer->len += size;
+}
+
+static void cw_write_u8(cwWriter* writer, uint8_t val)   { cw_write_bytes(writer, &val, sizeof(val)); }
+static void cw_write_u32(cwWriter* writer, uint32_t val) { cw_write_bytes(writer, &val, sizeof(val)); }
+
+/* strings are written in full the first time they appear and by index afterwards */
+static void cw_write_string(cwWriter* writer, cwString* str)
+{
+    cwValue* index = cw_table_find(&writer->pool, str);
+    if (index)
+    {
+        cw_write_u32(writer, (uint32_t)AS_INT(*index));
+        return;
+    }
+
+    cw_table_insert(&writer->pool, str, MAKE_INT(writer->count));
+    cw_write_u32(writer, writer->count++);
+    cw_write_u32(writer, (uint32_t)str->len);
+    cw_write_bytes(writer, str->raw, str->len);
+}
+
+static bool cw_write_function(cwWriter* writer, const cwFunction* function);
+
+/* shapes are written like strings, in full once and by index afterwards */
+static bool cw_write_shape(cwWriter* writer, const cwShape* shape)
+{
+    for (uint32_t i = 0; i < writer->shape_count; ++i)
+    {
+        if (writer->shapes[i] != shape) continue;
+
+        cw_write_u32(writer, i);
+        return true;
+    }
+
+    if (writer->shape_cap < writer->shape_count + 1)
+    {
+        uint32_t old_cap = writer->shape_cap;
+        writer->shape_cap = CW_GROW_CAPACITY(old_cap);
+        writer->shapes = CW_GROW_ARRAY(const cwShape*, writer->shapes, old_cap, writer->shape_cap);
+    }
+    writer->shapes[writer->shape_count] = shape;
+    cw_write_u32(writer, writer->shape_count++);
+
+    cw_write_string(writer, shape->name);
+    cw_write_u8(writer, shape->field_count);
+    for (int i = 0; i < shape->field_count; ++i) cw_write_string(writer, shape->fields[i]);
+
+    bool result = true;
+    cw_write_u8(writer, shape->method_count);
+    for (int i = 0; i < shape->method_count; ++i)
+    {
+        cw_write_string(writer, shape->method_names[i]);
+        if (!cw_write_function(writer, shape->methods[i])) result = false;
+    }
+    return result;
+}
+
+static bool cw_write_value(cwWriter* writer, cwValue val);
+
+static void cw_write_array(cwWriter* writer, const cwArray* array)
+{
+    cw_write_u8(writer, (uint8_t)array->type);
+    cw_write_u32(writer, array->len);
+    cw_write_bytes(writer, array->data, cw_array_element_size(array->type) * array->len);
+}
+
+/* containers are written by value, one that contains itself can't be written */
+static bool cw_write_map(cwWriter* writer, const cwMap* map)
+{
+    if (++writer->depth > CW_COPY_DEPTH_MAX) return false;
+
+    bool result = true;
+    cw_write_u32(writer, map->count);
+
+    uint32_t position = 0;
+    cwString* key;
+    cwValue element;
+    while (result && cw_map_next(map, &position, &key, &element))
+    {
+        cw_write_string(writer, key);
+        result = cw_write_value(writer, element);
+    }
+
+    writer->depth--;
+    return result;
+}
+
+static bool cw_write_record(cwWriter* writer, const cwRecord* record)
+{
+    if (++writer->depth > CW_COPY_DEPTH_MAX) return false;
+
+    bool result = cw_write_shape(writer, record->shape);
+    for (int i = 0; i < record->shape->field_count && result; ++i)
+    {
+        result = cw_write_value(writer, record->fields[i]);
+    }
+
+    writer->depth--;
+    return result;
+}
+
+static bool cw_write_value(cwWriter* writer, cwValue val)
+{
+    cw_write_u8(writer, (uint8_t)val.type);
+    switch (val.type)
+    {
+    case VAL_NULL:   return true;
+    case VAL_BOOL:
+    case VAL_INT:    cw_write_u32(writer, (uint32_t)val.as.ival); return true;
+    case VAL_FLOAT:  cw_write_bytes(writer, &val.as.fval, sizeof(float)); return true;
+    case VAL_OBJECT:
+        cw_write_u8(writer, (uint8_t)OBJECT_TYPE(val));
+        switch (OBJECT_TYPE(val))
+        {
+        case OBJ_STRING:   cw_write_string(writer, AS_STRING(val)); return true;
+        case OBJ_FUNCTION: return cw_write_function(writer, AS_FUNCTION(val));
+        case OBJ_SHAPE:    return cw_write_shape(writer, AS_SHAPE(val));
+        }
+
+        /* frozen containers are restored into the engine, the others into the runtime */
+        cw_write_u8(writer, AS_OBJECT(val)->frozen);
+        switch (OBJECT_TYPE(val))
+        {
+        case OBJ_ARRAY:    cw_write_array(writer, AS_ARRAY(val)); return true;
+        case OBJ_MAP:      return cw_write_map(writer, AS_MAP(val));
+        case OBJ_RECORD:   return cw_write_record(writer, AS_RECORD(val));
+        }
+    }
+
+    return false;
+}
+
+static bool cw_write_chunk(cwWriter* writer, const cwChunk* chunk)
+{
+    cw_write_u32(writer, (uint32_t)chunk->len);
+    cw_write_bytes(writer, chunk->bytes, chunk->len);
+    cw_write_bytes(writer, chunk->lines, sizeof(int) * chunk->len);
+
+    bool result = true;
+    cw_write_u32(writer, (uint32_t)chunk->const_len);
+    for (size_t i = 0; i < chunk->const_len; ++i)
+    {
+        if (!cw_write_value(writer, chunk->constants[i])) result = false;
+    }
+
+    /* caches and call sites start out empty in every image */
+    cw_write_u32(writer, (uint32_t)chunk->cache_len);
+    cw_write_u32(writer, (uint32_t)chunk->site_len);
+    return result;
+}
+
+/* functions of snapshots that were never called are written as source and stay lazy */
+static bool cw_write_function(cwWriter* writer, const cwFunction* function)
+{
+    cw_write_u8(writer, function->name != NULL);
+    if (function->name) cw_write_string(writer, function->name);
+    cw_write_u32(writer, (uint32_t)function->arity);
+
+    bool compiled = cw_function_compiled(function);
+    cw_write_u8(writer, compiled);
+    if (compiled) return cw_write_chunk(writer, &function->chunk);
+    if (writer->compiled) return false;
+
+    cw_write_u32(writer, (uint32_t)function->line);
+    cw_write_u32(writer, (uint32_t)function->source_len);
+    cw_write_bytes(writer, function->source, function->source_len);
+    return true;
+}
+
+/* --------------------------| reader |--------------------------------------------------- */
+typedef struct
+{
+    cwEngine* engine;   /* strings and functions are restored as literals */
+    cwRuntime* runtime; /* owns the arrays, maps and records of snapshots, NULL in chunk images */
+    const uint8_t* cursor;
+    const uint8_t* end;
+    bool error;
+
+    /* strings in the order they appear in the image */
+    cwString** strings;
+    uint32_t count;
+    uint32_t cap;
+
+    /* shapes in the order they appear in the image */
+    cwShape** shapes;
+    uint32_t shape_count;
+    uint32_t shape_cap;
+
+    int depth;
+} cwReader;
+
+static void cw_reader_init(cwReader* reader, cwEngine* engine, cwRuntime* runtime, const uint8_t* bytes, size_t len)
+{
+    reader->engine = engine;
+    reader->runtime = runtime;
+    reader->cursor = bytes;
+    reader->end = bytes + len;
+    reader->error = false;
+    reader->strings = NULL;
+    reader->count = 0;
+    reader->cap = 0;
+    reader->shapes = NULL;
+    reader->shape_count = 0;
+    reader->shape_cap = 0;
+    reader->depth = 0;
+
+    /* reading adds literals and functions to the engine */
+    cw_mutex_lock(&engine->lock);
+}
+
+static void cw_reader_free(cwReader* reader)
+{
+    cw_mutex_unlock(&reader->engine->lock);
+    CW_FREE_ARRAY(cwString*, reader->strings, reader->cap);
+    CW_FREE_ARRAY(cwShape*, reader->shapes, reader->shape_cap);
+}
+
+static bool cw_read_bytes(cwReader* reader, void* dst, size_t size)
+{
+    if (reader->error || (size_t)(reader->end - reader->cursor) < size)
+    {
+        reader->error = true;
+        return false;
+    }
+
+    memcpy(dst, reader->cursor, size);
+    reader->cursor += size;
+    return true;
+}
+
+static uint8_t cw_read_u8(cwReader* reader)
+{
+    uint8_t val = 0;
+    cw_read_bytes(reader, &val, sizeof(val));
+    return val;
+}
+
+static uint32_t cw_read_u32(cwReader* reader)
+{
+    uint32_t val = 0;
+    cw_read_bytes(reader, &val, sizeof(val));
+    return val;
+}
+
+static cwString* cw_read_string(cwReader* reader)
+{
+    uint32_t index = cw_read_u32(reader);
+    if (reader->error) return NULL;
+    if (index < reader->count) return reader->strings[index];
+
+    /* a string that is not in the pool yet has to be the next one */
+    uint32_t len = cw_read_u32(reader);
+    if (index != reader->count || (size_t)(reader->end - reader->cursor) < len)
+    {
+        reader->error = true;
+        return NULL;
+    }
+
+    if (reader->cap < reader->count + 1)
+    {
+        uint32_t old_cap = reader->cap;
+        reader->cap = CW_GROW_CAPACITY(old_cap);
+        reader->strings = CW_GROW_ARRAY(cwString*, reader->strings, old_cap, reader->cap);
+    }
+
+    cwString* str = cw_str_intern(reader->engine, (const char*)reader->cursor, len);
+    reader->strings[reader->count++] = str;
+    reader->cursor += len;
+    return str;
+}
+
+static cwFunction* cw_read_function(cwReader* reader);
+
+/* shapes get a new id in every process that reads them */
+static cwShape* cw_read_shape(cwReader* reader)
+{
+    uint32_t index = cw_read_u32(reader);
+    if (reader->error) return NULL;
+    if (index < reader->shape_count) return reader->shapes[index];
+
+    cwString* name = index == reader->shape_count ? cw_read_string(reader) : NULL;
+    uint8_t count = cw_read_u8(reader);
+    if (!name || reader->error)
+    {
+        reader->error = true;
+        return NULL;
+    }
+
+    cwShape* shape = cw_shape_new(reader->engine, name);
+    if (reader->shape_cap < reader->shape_count + 1)
+    {
+        uint32_t old_cap = reader->shape_cap;
+        reader->shape_cap = CW_GROW_CAPACITY(old_cap);
+        reader->shapes = CW_GROW_ARRAY(cwShape*, reader->shapes, old_cap, reader->shape_cap);
+    }
+    reader->shapes[reader->shape_count++] = shape;
+
+    for (int i = 0; i < count && !reader->error; ++i)
+    {
+        cwString* field = cw_read_string(reader);
+        if (field && !cw_shape_add_field(shape, field)) reader->error = true;
+    }
+
+    count = cw_read_u8(reader);
+    for (int i = 0; i < count && !reader->error; ++i)
+    {
+        cwString* name = cw_read_string(reader);
+        cwFunction* method = name ? cw_read_function(reader) : NULL;
+        if (method && !cw_shape_add_method(shape, name, method)) reader->error = true;
+    }
+    return reader->error ? NULL : shape;
+}
+
+static cwValue cw_read_value(cwReader* reader);
+
+/* the reader holds the engine lock, frozen containers are linked into the engine */
+static cwObject** cw_read_heap(cwReader* reader, bool frozen)
+{
+    if (frozen) return &reader->engine->objects;
+    return reader->runtime ? &reader->runtime->objects : NULL;
+}
+
+static cwArray* cw_read_array(cwReader* reader, cwObject** heap)
+{
+    uint8_t type = cw_read_u8(reader);
+    uint32_t len = cw_read_u32(reader);
+    if (reader->error || type > ARRAY_FLOAT64) return NULL;
+
+    size_t size = cw_array_element_size((cwArrayType)type) * len;
+    if ((size_t)(reader->end - reader->cursor) < size) return NULL;
+
+    cwArray* array = cw_array_new(heap, 0, (cwArrayType)type, len);
+    cw_read_bytes(reader, array->data, size);
+    return array;
+}
+
+static cwMap* cw_read_map(cwReader* reader, cwObject** heap)
+{
+    uint32_t count = cw_read_u32(reader);
+    if (reader->error || count > (size_t)(reader->end - reader->cursor)) return NULL;
+
+    cwMap* map = cw_map_new(heap, 0);
+    for (uint32_t i = 0; i < count && !reader->error; ++i)
+    {
+        cwString* key = cw_read_string(reader);
+        cwValue element = cw_read_value(reader);
+        if (!reader->error) cw_map_set(map, key, element, NULL);
+    }
+    return reader->error ? NULL : map;
+}
+
+static cwRecord* cw_read_record(cwReader* reader, cwObject** heap)
+{
+    cwShape* shape = cw_read_shape(reader);
+    if (!shape) return NULL;
+
+    cwRecord* record = cw_record_new(heap, 0, shape);
+    for (int i = 0; i < shape->field_count && !reader->error; ++i)
+    {
+        record->fields[i] = cw_read_value(reader);
+    }
+    return reader->error ? NULL : record;
+}
+
+/* containers of the runtime only appear in snapshots */
+static cwObject* cw_read_container(cwReader* reader, cwObjectType type)
+{
+    bool frozen = cw_read_u8(reader);
+    cwObject** heap = cw_read_heap(reader, frozen);
+    if (reader->error || !heap || reader->depth >= CW_COPY_DEPTH_MAX) return NULL;
+
+    cwObject* object = NULL;
+    reader->depth++;
+    switch (type)
+    {
+    case OBJ_ARRAY:  object = (cwObject*)cw_read_array(reader, heap); break;
+    case OBJ_MAP:    object = (cwObject*)cw_read_map(reader, heap); break;
+    case OBJ_RECORD: object = (cwObject*)cw_read_record(reader, heap); break;
+    default: break;
+    }
+    reader->depth--;
+
+    if (!object) return NULL;
+
+    object->frozen = frozen;
+    object->depth = frozen ? 0 : reader->runtime->depth;
+    return object;
+}
+
+static cwValue cw_read_value(cwReader* reader)
+{
+    switch (cw_read_u8(reader))
+    {
+    case VAL_NULL:  return MAKE_NULL();
+    case VAL_BOOL:  return MAKE_BOOL((int32_t)cw_read_u32(reader));
+    case VAL_INT:   return MAKE_INT((int32_t)cw_read_u32(reader));
+    case VAL_FLOAT:
+    {
+        float fval = 0.0f;
+        cw_read_bytes(reader, &fval, sizeof(float));
+        return MAKE_FLOAT(fval);
+    }
+    case VAL_OBJECT:
+    {
+        uint8_t type = cw_read_u8(reader);
+        switch (type)
+        {
+        case OBJ_STRING:
+        {
+            cwString* str = cw_read_string(reader);
+            if (str) return MAKE_OBJECT(str);
+            break;
+        }
+        case OBJ_FUNCTION:
+        {
+            cwFunction* function = cw_read_function(reader);
+            if (function) return MAKE_OBJECT(function);
+            break;
+        }
+        case OBJ_SHAPE:
+        {
+            cwShape* shape = cw_read_shape(reader);
+            if (shape) return MAKE_OBJECT(shape);
+            break;
+        }
+        case OBJ_ARRAY:
+        case OBJ_MAP:
+        case OBJ_RECORD:
+        {
+            cwObject* object = cw_read_container(reader, (cwObjectType)type);
+            if (object) return MAKE_OBJECT(object);
+            break;
+        }
+        }
+        break;
+    }
+    }
+
+    reader->error = true;
+    return MAKE_NULL();
+}
+
+static bool cw_read_chunk(cwReader* reader, cwChunk* chunk)
+{
+    uint32_t len = cw_read_u32(reader);
+    if (reader->error || (size_t)(reader->end - reader->cursor) < len * (1 + sizeof(int))) return false;
+
+    chunk->bytes = CW_ALLOCATE(uint8_t, len);
+    chunk->lines = CW_ALLOCATE(int, len);
+    chunk->len = len;
+    chunk->cap = len;
+    cw_read_bytes(reader, chunk->bytes, len);
+    cw_read_bytes(reader, chunk->lines, sizeof(int) * len);
+
+    uint32_t const_len = cw_read_u32(reader);
+    if (reader->error || const_len > (size_t)(reader->end - reader->cursor)) return false;
+
+    chunk->constants = CW_ALLOCATE(cwValue, const_len);
+    chunk->const_cap = const_len;
+    for (uint32_t i = 0; i < const_len && !reader->error; ++i)
+    {
+        chunk->constants[chunk->const_len++] = cw_read_value(reader);
+    }
+
+    uint32_t cache_len = cw_read_u32(reader);
+    if (reader->error || cache_len > UINT16_MAX + 1) return false;
+
+    chunk->caches = CW_ALLOCATE(uint32_t, cache_len);
+    chunk->cache_len = cache_len;
+    for (uint32_t i = 0; i < cache_len; ++i) chunk->caches[i] = UINT32_MAX;
+
+    uint32_t site_len = cw_read_u32(reader);
+    if (reader->error || site_len > UINT16_MAX + 1) return false;
+
+    chunk->sites = CW_ALLOCATE(cwCallSite, site_len);
+    chunk->site_len = site_len;
+    for (uint32_t i = 0; i < site_len; ++i) cw_call_site_init(&chunk->sites[i]);
+
+    return !reader->error;
+}
+
+static cwFunction* cw_read_function(cwReader* reader)
+{
+    cwFunction* function = cw_function_new(reader->engine);
+    if (cw_read_u8(reader)) function->name = cw_read_string(reader);
+    function->arity = (int)cw_read_u32(reader);
+
+    if (cw_read_u8(reader))
+    {
+        cw_read_chunk(reader, &function->chunk);
+    }
+    else
+    {
+        function->line = (int)cw_read_u32(reader);
+        uint32_t len = cw_read_u32(reader);
+        if (!reader->error && (size_t)(reader->end - reader->cursor) >= len)
+        {
+            function->source = CW_ALLOCATE(char, len + 1);
+            function->source_len = len;
+            cw_read_bytes(reader, function->source, len);
+            function->source[len] = '\0';
+        }
+        else
+        {
+            reader->error = true;
+        }
+    }
+
+    return reader->error ? NULL : function;
+}
+
+/* --------------------------| snapshot |------------------------------------------------- */
+static void cw_write_strings(cwWriter* writer, const Table* strings)
+{
+    for (uint32_t i = 0; i < strings->capacity; ++i)
+    {
+        cwString* str = strings->entries[i].key;
+        if (str) cw_write_string(writer, str);
+    }
+}
+
+bool cw_snapshot_write(cwRuntime* cw, cwBuffer* buffer)
+{
+    cwWriter writer;
+    cw_writer_init(&writer, buffer);
+
+    /* no literals may be added to the engine while its strings are written */
+    cw_mutex_lock(&cw->engine->lock);
+
+    cw_write_u32(&writer, CW_SNAPSHOT_MAGIC);
+    cw_write_u32(&writer, CW_SNAPSHOT_VERSION);
+
+    /* string pool with the literals of the engine and the strings of the runtime and its parents */
+    uint32_t count = cw->engine->strings.size;
+    for (const cwRuntime* rt = cw; rt; rt = rt->parent) count += rt->strings.size;
+
+    cw_write_u32(&writer, count);
+    cw_write_strings(&writer, &cw->engine->strings);
+    for (const cwRuntime* rt = cw; rt; rt = rt->parent) cw_write_strings(&writer, &rt->strings);
+
+    /* the table size also counts tombstones, so the count is patched afterwards */
+    bool result = true;
+    size_t globals_offset = buffer->len;
+    cw_write_u32(&writer, 0);
+
+    /* a fork is written flattened, globals it has overwritten hide the ones of its parents */
+    uint32_t globals = 0;
+    for (const cwRuntime* rt = cw; rt; rt = rt->parent)
+    {
+        for (uint32_t i = 0; i < rt->globals.capacity; ++i)
+        {
+            TableEntry* entry = &rt->globals.entries[i];
+            if (!entry->key || cw_find_global(cw, entry->key) != &entry->val) continue;
+
+            cw_write_string(&writer, entry->key);
+            if (!cw_write_value(&writer, entry->val)) result = false;
+            globals++;
+        }
+    }
+    memcpy(buffer->bytes + globals_offset, &globals, sizeof(uint32_t));
+
+    cw_mutex_unlock(&cw->engine->lock);
+    cw_writer_free(&writer);
+    return result;
+}
+
+bool cw_snapshot_read(cwRuntime* cw, const uint8_t* bytes, size_t len)
+{
+    cwReader reader;
+    cw_reader_init(&reader, cw->engine, cw, bytes, len);
+
+    if (cw_read_u32(&reader) != CW_SNAPSHOT_MAGIC)   reader.error = true;
+    if (cw_read_u32(&reader) != CW_SNAPSHOT_VERSION) reader.error = true;
+
+    /* intern the string pool; the rest of the image refers to strings by index */
+    uint32_t count = cw_read_u32(&reader);
+    for (uint32_t i = 0; i < count && !reader.error; ++i)
+    {
+        cw_read_string(&reader);
+    }
+
+    /* fix up globals */
+    uint32_t globals = cw_read_u32(&reader);
+    for (uint32_t i = 0; i < globals && !reader.error; ++i)
+    {
+        cwString* key = cw_read_string(&reader);
+        cwValue val = cw_read_value(&reader);
+        if (!reader.error) cw_table_insert(&cw->globals, key, val);
+    }
+
+    cw_reader_free(&reader);
+    return !reader.error;
+}
+
+bool cw_snapshot_save(cwRuntime* cw, const char* path)
+{
+    cwBuffer buffer;
+    cw_buffer_init(&buffer);
+
+    bool result = cw_snapshot_write(cw, &buffer) && cw_write_file(path, &buffer);
+
+    cw_buffer_free(&buffer);
+    return result;
+}
+
+bool cw_snapshot_load(cwRuntime* cw, const char* path)
+{
+    cwBuffer buffer;
+    cw_buffer_init(&buffer);
+
+    bool result = cw_read_file(path, &buffer) && cw_snapshot_read(cw, buffer.bytes, buffer.len);
+
+    cw_buffer_free(&buffer);
+    return result;
+}
+
+/* --------------------------| chunk images |--------------------------------------------- */
+bool cw_image_write(const cwFunction* function, cwBuffer* buffer)
+{
+    cwWriter writer;
+    cw_writer_init(&writer, buffer);
+    writer.compiled = true;
+
+    cw_write_u32(&writer, CW_IMAGE_MAGIC);
+    cw_write_u32(&writer, CW_SNAPSHOT_VERSION);
+    bool result = cw_write_function(&writer, function);
+
+    cw_writer_free(&writer);
+    return result;
+}
+
+cwFunction* cw_image_read(cwEngine* engine, const uint8_t* bytes, size_t len)
+{
+    cwReader reader;
+    cw_reader_init(&reader, engine, NULL, bytes, len);
+
+    cwFunction* function = NULL;
+    if (cw_read_u32(&reader) == CW_IMAGE_MAGIC && cw_read_u32(&reader) == CW_SNAPSHOT_VERSION)
+        function = cw_read_function(&reader);
+
+    cw_reader_free(&reader);
+    return function;
+}
+
+/* --------------------------| files |---------------------------------------------------- */
+bool cw_write_file(const char* path, const cwBuffer* buffer)
+{
+    FILE* file = fopen(path, "wb");
+    if (!file) return false;
+
+    bool result = fwrite(buffer->bytes, sizeof(uint8_t), buffer->len, file) == buffer->len;
+    fclose(file);
+    return result;
+}
+
+bool cw_read_file(const char* path, cwBuffer* buffer)
+{
+    FILE* file = fopen(path, "rb");
+    if (!file) return false;
+
+    fseek(file, 0L, SEEK_END);
+    size_t filesize = ftell(file);
+    rewind(file);
+
+    size_t old_cap = buffer->cap;
+    buffer->cap = filesize;
+    buffer->bytes = CW_GROW_ARRAY(uint8_t, buffer->bytes, old_cap, buffer->cap);
+    buffer->len = fread(buffer->bytes, sizeof(uint8_t), filesize, file);
+
+    fclose(file);
+    return buffer->len == filesize;
+}
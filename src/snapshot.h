@@ -0,0 +1,51 @@
+#ifndef CLOCKWORK_SNAPSHOT_H
+#define CLOCKWORK_SNAPSHOT_H
+
+#include "common.h"
+
+#define CW_SNAPSHOT_MAGIC   0x53535743  /* "CWSS" */
+#define CW_IMAGE_MAGIC      0x4b435743  /* "CWCK" */
+#define CW_SNAPSHOT_VERSION 6
+
+/* growable byte buffer used to build serialized images */
+typedef struct
+{
+    uint8_t* bytes;
+    size_t len;
+    size_t cap;
+} cwBuffer;
+
+void cw_buffer_init(cwBuffer* buffer);
+void cw_buffer_free(cwBuffer* buffer);
+
+/*
+ * A snapshot contains every interned string and the globals table of an
+ * initialized runtime, including the functions and datatypes stored in
+ * globals. Strings are stored as indices into the string pool, so the image
+ * does not depend on the addresses of the runtime that wrote it. Restoring reads the image
+ * in one go and fixes the indices up to freshly interned strings instead of
+ * executing the prelude again. Arrays, maps and records in globals are
+ * written by value and rebuilt in the heap of the runtime, frozen ones in
+ * the engine; a map that contains itself can't be written.
+ */
+bool cw_snapshot_write(cwRuntime* cw, cwBuffer* buffer);
+bool cw_snapshot_read(cwRuntime* cw, const uint8_t* bytes, size_t len);
+
+bool cw_snapshot_save(cwRuntime* cw, const char* path);
+bool cw_snapshot_load(cwRuntime* cw, const char* path);
+
+/*
+ * A chunk image holds the compiled script function together with the
+ * strings and functions of its constants. Images are produced at build time
+ * and can be read straight from memory, so loading them skips scanning and
+ * parsing. The literals of an image belong to the engine it is read into.
+ * Every function in the image has to be compiled (see cw_compile_all).
+ */
+bool        cw_image_write(const cwFunction* function, cwBuffer* buffer);
+cwFunction* cw_image_read(cwEngine* engine, const uint8_t* bytes, size_t len);
+
+/* files */
+bool cw_write_file(const char* path, const cwBuffer* buffer);
+bool cw_read_file(const char* path, cwBuffer* buffer);
+
+#endif /* !CLOCKWORK_SNAPSHOT_H */
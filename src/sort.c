@@ -0,0 +1,588 @@
+#include "sort.h"
+
+#include <string.h>
+
+#include "debug.h"
+#include "memory.h"
+#include "scheduler.h"
+
+/* --------------------------| keys |---------------------------------------------------- */
+/* signs are flipped and negative floats inverted, so the keys compare like the elements */
+static void cw_encode_keys(cwArrayType type, void* data, size_t len)
+{
+    switch (type)
+    {
+    case ARRAY_INT32:
+        for (size_t i = 0; i < len; ++i) ((uint32_t*)data)[i] ^= 0x80000000u;
+        break;
+    case ARRAY_FLOAT32:
+        for (size_t i = 0; i < len; ++i)
+        {
+            uint32_t bits = ((uint32_t*)data)[i];
+            ((uint32_t*)data)[i] = bits & 0x80000000u ? ~bits : bits ^ 0x80000000u;
+        }
+        break;
+    case ARRAY_FLOAT64:
+        for (size_t i = 0; i < len; ++i)
+        {
+            uint64_t bits = ((uint64_t*)data)[i];
+            ((uint64_t*)data)[i] = bits & 0x8000000000000000u ? ~bits : bits ^ 0x8000000000000000u;
+        }
+        break;
+    }
+}
+
+static void cw_decode_keys(cwArrayType type, void* data, size_t len)
+{
+    switch (type)
+    {
+    case ARRAY_INT32:
+        for (size_t i = 0; i < len; ++i) ((uint32_t*)data)[i] ^= 0x80000000u;
+        break;
+    case ARRAY_FLOAT32:
+        for (size_t i = 0; i < len; ++i)
+        {
+            uint32_t key = ((uint32_t*)data)[i];
+            ((uint32_t*)data)[i] = key & 0x80000000u ? key ^ 0x80000000u : ~key;
+        }
+        break;
+    case ARRAY_FLOAT64:
+        for (size_t i = 0; i < len; ++i)
+        {
+            uint64_t key = ((uint64_t*)data)[i];
+            ((uint64_t*)data)[i] = key & 0x8000000000000000u ? key ^ 0x8000000000000000u : ~key;
+        }
+        break;
+    }
+}
+
+/* --------------------------| radix sort |---------------------------------------------- */
+/* least significant byte first, passes where every key has the same byte are skipped */
+#define CW_RADIX_SORT(name, type)                                                           \
+    static void name(type* keys, type* tmp, size_t len)                                     \
+    {                                                                                       \
+        type* src = keys;                                                                   \
+        type* dst = tmp;                                                                    \
+        for (size_t shift = 0; shift < sizeof(type) * 8; shift += 8)                        \
+        {                                                                                   \
+            size_t counts[256] = { 0 };                                                     \
+            for (size_t i = 0; i < len; ++i) counts[(src[i] >> shift) & 0xff]++;           \
+            if (counts[(src[0] >> shift) & 0xff] == len) continue;                          \
+                                                                                            \
+            size_t offset = 0;                                                              \
+            for (int digit = 0; digit < 256; ++digit)                                       \
+            {                                                                               \
+                size_t count = counts[digit];                                               \
+                counts[digit] = offset;                                                     \
+                offset += count;                                                            \
+            }                                                                               \
+            for (size_t i = 0; i < len; ++i) dst[counts[(src[i] >> shift) & 0xff]++] = src[i]; \
+                                                                                            \
+            type* swap = src;                                                               \
+            src = dst;                                                                      \
+            dst = swap;                                                                     \
+        }                                                                                   \
+        if (src != keys) memcpy(keys, src, sizeof(type) * len);                             \
+    }
+
+CW_RADIX_SORT(cw_radix_sort32, uint32_t)
+CW_RADIX_SORT(cw_radix_sort64, uint64_t)
+
+static void cw_radix_sort(size_t width, void* keys, void* tmp, size_t len)
+{
+    if (len < 2) return;
+
+    if (width == sizeof(uint32_t)) cw_radix_sort32(keys, tmp, len);
+    else                           cw_radix_sort64(keys, tmp, len);
+}
+
+/* --------------------------| merging |------------------------------------------------- */
+/*
+ * Split finds how many elements of a are among the first k of the merged
+ * output, with ties going to a. Merging the ranges between two splits
+ * gives that part of the output independently of the other parts.
+ */
+#define CW_MERGE(name, type)                                                                \
+    static size_t name##_split(const type* a, size_t na, const type* b, size_t nb, size_t k) \
+    {                                                                                       \
+        size_t lo = k > nb ? k - nb : 0;                                                    \
+        size_t hi = k < na ? k : na;                                                        \
+        while (lo < hi)                                                                     \
+        {                                                                                   \
+            size_t i = lo + (hi - lo) / 2;                                                  \
+            if (a[i] <= b[k - i - 1]) lo = i + 1;                                           \
+            else                      hi = i;                                               \
+        }                                                                                   \
+        return lo;                                                                          \
+    }                                                                                       \
+                                                                                            \
+    static void name(const type* a, size_t na, const type* b, size_t nb, type* out, size_t k0, size_t k1) \
+    {                                                                                       \
+        size_t i = name##_split(a, na, b, nb, k0);                                          \
+        size_t j = k0 - i;                                                                  \
+        size_t i_end = name##_split(a, na, b, nb, k1);                                      \
+        size_t j_end = k1 - i_end;                                                          \
+        while (i < i_end && j < j_end) *out++ = b[j] < a[i] ? b[j++] : a[i++];              \
+        while (i < i_end) *out++ = a[i++];                                                  \
+        while (j < j_end) *out++ = b[j++];                                                  \
+    }
+
+CW_MERGE(cw_merge32, uint32_t)
+CW_MERGE(cw_merge64, uint64_t)
+
+/* --------------------------| parallel sort |------------------------------------------- */
+typedef struct
+{
+    cwArrayType type;
+    size_t width;
+    uint8_t* src;
+    uint8_t* dst;
+    size_t lo, hi;          /* block to sort, or the part of the output to merge */
+    size_t a, mid, b;       /* runs [a, mid) and [mid, b) of src merged into dst */
+} cwSortTask;
+
+/* the block is sorted in place with the same block of dst as scratch space */
+static void cw_sort_block(void* data)
+{
+    cwSortTask* task = data;
+    uint8_t* keys = task->src + task->lo * task->width;
+    cw_encode_keys(task->type, keys, task->hi - task->lo);
+    cw_radix_sort(task->width, keys, task->dst + task->lo * task->width, task->hi - task->lo);
+}
+
+static void cw_merge_block(void* data)
+{
+    cwSortTask* task = data;
+    size_t na = task->mid - task->a;
+    size_t nb = task->b - task->mid;
+    size_t k0 = task->lo - task->a;
+    size_t k1 = task->hi - task->a;
+    if (task->width == sizeof(uint32_t))
+    {
+        const uint32_t* src = (const uint32_t*)task->src;
+        cw_merge32(src + task->a, na, src + task->mid, nb, (uint32_t*)task->dst + task->lo, k0, k1);
+    }
+    else
+    {
+        const uint64_t* src = (const uint64_t*)task->src;
+        cw_merge64(src + task->a, na, src + task->mid, nb, (uint64_t*)task->dst + task->lo, k0, k1);
+    }
+}
+
+static void cw_sort_run(cwScheduler* scheduler, cwSortTask* tasks, int count, cwJobTask task)
+{
+    cwJob* jobs = CW_ALLOCATE(cwJob, count);
+    for (int i = 0; i < count; ++i)
+    {
+        cw_job_init_task(&jobs[i], task, &tasks[i]);
+        cw_scheduler_submit(scheduler, &jobs[i]);
+    }
+    for (int i = 0; i < count; ++i) cw_scheduler_await(scheduler, &jobs[i]);
+    CW_FREE_ARRAY(cwJob, jobs, count);
+}
+
+/* returns the buffer that holds the sorted keys */
+static uint8_t* cw_sort_parallel(cwScheduler* scheduler, cwArray* array, uint8_t* tmp)
+{
+    size_t len = array->len;
+    size_t width = cw_array_element_size(array->type);
+    int workers = scheduler->worker_count;
+    cwSortTask base = { .type = array->type, .width = width, .src = array->data, .dst = tmp };
+
+    /* a round has at most a piece per worker and a remainder per pair of runs */
+    int runs = workers;
+    size_t* bounds = CW_ALLOCATE(size_t, workers + 1);
+    cwSortTask* tasks = CW_ALLOCATE(cwSortTask, 2 * workers);
+    for (int r = 0; r < runs; ++r)
+    {
+        bounds[r] = len * r / runs;
+        tasks[r] = base;
+        tasks[r].lo = len * r / runs;
+        tasks[r].hi = len * (r + 1) / runs;
+    }
+    bounds[runs] = len;
+    cw_sort_run(scheduler, tasks, runs, cw_sort_block);
+
+    /* every round merges pairs of runs, cut into pieces by their share of the output */
+    while (runs > 1)
+    {
+        int count = 0;
+        for (int r = 0; r < runs; r += 2)
+        {
+            size_t a = bounds[r];
+            size_t mid = bounds[r + 1];
+            size_t b = r + 1 < runs ? bounds[r + 2] : mid;
+            size_t pieces = (size_t)workers * (b - a) / len;
+            if (pieces == 0) pieces = 1;
+
+            for (size_t p = 0; p < pieces; ++p)
+            {
+                cwSortTask* task = &tasks[count++];
+                *task = base;
+                task->a = a;
+                task->mid = mid;
+                task->b = b;
+                task->lo = a + (b - a) * p / pieces;
+                task->hi = a + (b - a) * (p + 1) / pieces;
+            }
+        }
+        cw_sort_run(scheduler, tasks, count, cw_merge_block);
+
+        for (int r = 0; r < runs; r += 2) bounds[r / 2] = bounds[r];
+        runs = (runs + 1) / 2;
+        bounds[runs] = len;
+
+        uint8_t* swap = base.src;
+        base.src = base.dst;
+        base.dst = swap;
+    }
+
+    CW_FREE_ARRAY(cwSortTask, tasks, 2 * workers);
+    CW_FREE_ARRAY(size_t, bounds, workers + 1);
+    return base.src;
+}
+
+void cw_sort_array(cwEngine* engine, cwArray* array)
+{
+    size_t len = array->len;
+    if (len < 2) return;
+
+    size_t width = cw_array_element_size(array->type);
+    uint8_t* tmp = CW_ALLOCATE(uint8_t, width * len);
+
+    cwScheduler* scheduler = len >= CW_SORT_PARALLEL_MIN ? cw_engine_scheduler(engine) : NULL;
+    if (scheduler && scheduler->worker_count > 1)
+    {
+        uint8_t* sorted = cw_sort_parallel(scheduler, array, tmp);
+        if (sorted != array->data) memcpy(array->data, sorted, width * len);
+    }
+    else
+    {
+        cw_encode_keys(array->type, array->data, len);
+        cw_radix_sort(width, array->data, tmp, len);
+    }
+    cw_decode_keys(array->type, array->data, len);
+
+    CW_FREE_ARRAY(uint8_t, tmp, width * len);
+}
+
+/* --------------------------| comparison sorts |---------------------------------------- */
+/* sorts of indices into the array, so elements keep their full precision until they are moved */
+typedef bool (*cwLessFn)(void* ctx, uint32_t a, uint32_t b);
+
+static void cw_merge_sort(uint32_t* idx, uint32_t* tmp, size_t len, cwLessFn less, void* ctx)
+{
+    uint32_t* src = idx;
+    uint32_t* dst = tmp;
+    for (size_t run = 1; run < len; run *= 2)
+    {
+        for (size_t a = 0; a < len; a += 2 * run)
+        {
+            size_t mid = a + run < len ? a + run : len;
+            size_t b = mid + run < len ? mid + run : len;
+            size_t i = a, j = mid, k = a;
+            while (i < mid && j < b) dst[k++] = less(ctx, src[j], src[i]) ? src[j++] : src[i++];
+            while (i < mid) dst[k++] = src[i++];
+            while (j < b) dst[k++] = src[j++];
+        }
+
+        uint32_t* swap = src;
+        src = dst;
+        dst = swap;
+    }
+    if (src != idx) memcpy(idx, src, sizeof(uint32_t) * len);
+}
+
+static inline void cw_swap_index(uint32_t* idx, size_t a, size_t b)
+{
+    uint32_t tmp = idx[a];
+    idx[a] = idx[b];
+    idx[b] = tmp;
+}
+
+static void cw_insertion_sort(uint32_t* idx, size_t len, cwLessFn less, void* ctx)
+{
+    for (size_t i = 1; i < len; ++i)
+    {
+        uint32_t value = idx[i];
+        size_t j = i;
+        for (; j > 0 && less(ctx, value, idx[j - 1]); --j) idx[j] = idx[j - 1];
+        idx[j] = value;
+    }
+}
+
+static void cw_sift_down(uint32_t* heap, size_t root, size_t len, cwLessFn less, void* ctx)
+{
+    while (true)
+    {
+        size_t child = 2 * root + 1;
+        if (child >= len) return;
+        if (child + 1 < len && less(ctx, heap[child], heap[child + 1])) child++;
+        if (!less(ctx, heap[root], heap[child])) return;
+
+        cw_swap_index(heap, root, child);
+        root = child;
+    }
+}
+
+static void cw_heap_sort(uint32_t* idx, size_t len, cwLessFn less, void* ctx)
+{
+    for (size_t i = len / 2; i-- > 0;) cw_sift_down(idx, i, len, less, ctx);
+    for (size_t end = len; end-- > 1;)
+    {
+        cw_swap_index(idx, 0, end);
+        cw_sift_down(idx, 0, end, less, ctx);
+    }
+}
+
+/* quicksort that falls back to heapsort when partitioning goes badly */
+static void cw_intro_sort(uint32_t* idx, size_t len, int depth, cwLessFn less, void* ctx)
+{
+    while (len > 16)
+    {
+        if (depth-- == 0)
+        {
+            cw_heap_sort(idx, len, less, ctx);
+            return;
+        }
+
+        /* the median of three becomes the pivot at the front */
+        size_t mid = len / 2;
+        if (less(ctx, idx[mid], idx[0])) cw_swap_index(idx, 0, mid);
+        if (less(ctx, idx[len - 1], idx[mid]))
+        {
+            cw_swap_index(idx, mid, len - 1);
+            if (less(ctx, idx[mid], idx[0])) cw_swap_index(idx, 0, mid);
+        }
+        cw_swap_index(idx, 0, mid);
+
+        uint32_t pivot = idx[0];
+        size_t i = 0, j = len;
+        while (true)
+        {
+            do ++i; while (i < len && less(ctx, idx[i], pivot));
+            do --j; while (j > 0 && less(ctx, pivot, idx[j]));
+            if (i >= j) break;
+            cw_swap_index(idx, i, j);
+        }
+        cw_swap_index(idx, 0, j);
+
+        /* recursion takes the smaller side, so the stack stays logarithmic */
+        if (j < len - j - 1)
+        {
+            cw_intro_sort(idx, j, depth, less, ctx);
+            idx += j + 1;
+            len -= j + 1;
+        }
+        else
+        {
+            cw_intro_sort(idx + j + 1, len - j - 1, depth, less, ctx);
+            len = j;
+        }
+    }
+    cw_insertion_sort(idx, len, less, ctx);
+}
+
+static void cw_permute(cwArray* array, const uint32_t* idx)
+{
+    size_t width = cw_array_element_size(array->type);
+    const uint8_t* data = array->data;
+    uint8_t* sorted = CW_ALLOCATE(uint8_t, width * array->len);
+    for (uint32_t i = 0; i < array->len; ++i) memcpy(sorted + i * width, data + idx[i] * width, width);
+
+    memcpy(array->data, sorted, width * array->len);
+    CW_FREE_ARRAY(uint8_t, sorted, width * array->len);
+}
+
+/* --------------------------| callbacks |----------------------------------------------- */
+/* functions of the script run in a fork, since the calling runtime is inside a native */
+typedef struct
+{
+    cwRuntime runtime;
+    cwFunction* function;
+    const cwArray* array;
+    const char* failure;    /* reported if the function fails */
+    const char* error;
+} cwCallback;
+
+static void cw_callback_init(cwCallback* callback, cwRuntime* cw, cwFunction* function, const cwArray* array, const char* failure)
+{
+    cw_fork(&callback->runtime, cw);
+    callback->function = function;
+    callback->array = array;
+    callback->failure = failure;
+    callback->error = NULL;
+}
+
+static bool cw_callback_call(cwCallback* callback, cwValue* args, int argc, cwValue* result)
+{
+    if (callback->error) return false;
+    if (cw_call_function(&callback->runtime, callback->function, args, argc, result) == INTERPRET_OK) return true;
+
+    callback->error = callback->failure;
+    return false;
+}
+
+static bool cw_compare_less(void* ctx, uint32_t a, uint32_t b)
+{
+    cwCallback* callback = ctx;
+    cwValue args[2] = { cw_array_get(callback->array, a), cw_array_get(callback->array, b) };
+    cwValue result;
+    if (!cw_callback_call(callback, args, 2, &result)) return false;
+
+    if (IS_BOOL(result))  return AS_BOOL(result);
+    if (IS_INT(result))   return AS_INT(result) < 0;
+    if (IS_FLOAT(result)) return AS_FLOAT(result) < 0.0f;
+
+    callback->error = "Comparison functions must return a boolean or a number.";
+    return false;
+}
+
+static bool cw_key_less(void* ctx, uint32_t a, uint32_t b)
+{
+    const double* keys = ctx;
+    return keys[a] < keys[b];
+}
+
+bool cw_sort_by(cwRuntime* cw, cwArray* array, cwFunction* function, bool stable)
+{
+    if (function->arity != 1 && function->arity != 2)
+    {
+        cw_runtime_error(cw, "Expected a key function with one or a comparison function with two parameters.");
+        return false;
+    }
+
+    uint32_t len = array->len;
+    uint32_t* idx = CW_ALLOCATE(uint32_t, len);
+    for (uint32_t i = 0; i < len; ++i) idx[i] = i;
+
+    cwCallback callback;
+    bool keyed = function->arity == 1;
+    cw_callback_init(&callback, cw, function, array, keyed ? "Key function failed." : "Comparison function failed.");
+
+    /* keys are computed once, sorting them does not call back */
+    double* keys = NULL;
+    if (keyed)
+    {
+        keys = CW_ALLOCATE(double, len);
+        for (uint32_t i = 0; i < len && !callback.error; ++i)
+        {
+            cwValue arg = cw_array_get(array, i);
+            cwValue key;
+            if (!cw_callback_call(&callback, &arg, 1, &key)) break;
+
+            if (IS_INT(key))        keys[i] = AS_INT(key);
+            else if (IS_FLOAT(key)) keys[i] = AS_FLOAT(key);
+            else                    callback.error = "Key functions must return numbers.";
+        }
+    }
+
+    cwLessFn less = keyed ? cw_key_less : cw_compare_less;
+    void* ctx = keyed ? (void*)keys : (void*)&callback;
+    if (!callback.error && stable)
+    {
+        uint32_t* tmp = CW_ALLOCATE(uint32_t, len);
+        cw_merge_sort(idx, tmp, len, less, ctx);
+        CW_FREE_ARRAY(uint32_t, tmp, len);
+    }
+    else if (!callback.error)
+    {
+        int depth = 0;
+        for (uint32_t n = len; n > 1; n >>= 1) depth += 2;
+        cw_intro_sort(idx, len, depth, less, ctx);
+    }
+
+    if (!callback.error) cw_permute(array, idx);
+
+    cw_free(&callback.runtime);
+    if (keys) CW_FREE_ARRAY(double, keys, len);
+    CW_FREE_ARRAY(uint32_t, idx, len);
+
+    if (callback.error)
+    {
+        cw_runtime_error(cw, callback.error);
+        return false;
+    }
+    return true;
+}
+
+/* --------------------------| search and partition |------------------------------------ */
+static double cw_element(const cwArray* array, uint32_t index)
+{
+    switch (array->type)
+    {
+    case ARRAY_INT32:   return ((const int32_t*)array->data)[index];
+    case ARRAY_FLOAT32: return ((const float*)array->data)[index];
+    case ARRAY_FLOAT64: return ((const double*)array->data)[index];
+    }
+    return 0.0;
+}
+
+uint32_t cw_array_search(const cwArray* array, cwValue value)
+{
+    double target = IS_INT(value) ? (double)AS_INT(value) : (double)AS_FLOAT(value);
+    uint32_t lo = 0;
+    uint32_t hi = array->len;
+    while (lo < hi)
+    {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (cw_element(array, mid) < target) lo = mid + 1;
+        else                                 hi = mid;
+    }
+    return lo;
+}
+
+bool cw_partition(cwRuntime* cw, cwArray* array, cwValue pivot, uint32_t* count)
+{
+    uint32_t len = array->len;
+    bool* front = CW_ALLOCATE(bool, len);
+
+    const char* error = NULL;
+    if (IS_FUNCTION(pivot))
+    {
+        cwCallback callback;
+        cw_callback_init(&callback, cw, AS_FUNCTION(pivot), array, "Predicate failed.");
+        for (uint32_t i = 0; i < len; ++i)
+        {
+            cwValue arg = cw_array_get(array, i);
+            cwValue result;
+            if (!cw_callback_call(&callback, &arg, 1, &result)) break;
+            front[i] = !cw_is_falsey(result);
+        }
+        error = callback.error;
+        cw_free(&callback.runtime);
+    }
+    else
+    {
+        double target = IS_INT(pivot) ? (double)AS_INT(pivot) : (double)AS_FLOAT(pivot);
+        for (uint32_t i = 0; i < len; ++i) front[i] = cw_element(array, i) < target;
+    }
+
+    if (!error)
+    {
+        size_t width = cw_array_element_size(array->type);
+        const uint8_t* data = array->data;
+        uint8_t* out = CW_ALLOCATE(uint8_t, width * len);
+        uint32_t n = 0;
+        for (uint32_t i = 0; i < len; ++i)
+        {
+            if (front[i]) memcpy(out + width * n++, data + width * i, width);
+        }
+        *count = n;
+        for (uint32_t i = 0; i < len; ++i)
+        {
+            if (!front[i]) memcpy(out + width * n++, data + width * i, width);
+        }
+
+        memcpy(array->data, out, width * len);
+        CW_FREE_ARRAY(uint8_t, out, width * len);
+    }
+    CW_FREE_ARRAY(bool, front, len);
+
+    if (error)
+    {
+        cw_runtime_error(cw, error);
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,37 @@
+#ifndef CLOCKWORK_SORT_H
+#define CLOCKWORK_SORT_H
+
+#include "array.h"
+#include "runtime.h"
+
+#define CW_SORT_PARALLEL_MIN (1 << 17) /* elements before sorting is spread over the workers */
+
+/*
+ * Sorts the elements of an array in place by value. Elements are turned
+ * into unsigned keys that keep their order and radix sorted, which is
+ * stable. Large arrays are cut into one block per worker of the engine,
+ * the blocks are sorted on the workers and merged pairwise, every merge
+ * split at the same points of its output so all workers take part.
+ */
+void cw_sort_array(cwEngine* engine, cwArray* array);
+
+/*
+ * Sorts with a function of the script: a function of one parameter gives
+ * the key of an element, keys are computed once per element and sorted
+ * without calling back; a function of two parameters compares elements and
+ * returns true or a negative number if the first goes first. Functions run
+ * in a fork of the runtime. Stable sorting merges, unstable sorting is an
+ * introsort that needs fewer comparisons.
+ */
+bool cw_sort_by(cwRuntime* cw, cwArray* array, cwFunction* function, bool stable);
+
+/* first index whose element is not less than the value, the array has to be sorted */
+uint32_t cw_array_search(const cwArray* array, cwValue value);
+
+/*
+ * Moves the elements less than a number or those a function returns true
+ * for to the front, keeping the order on both sides, and counts them.
+ */
+bool cw_partition(cwRuntime* cw, cwArray* array, cwValue pivot, uint32_t* count);
+
+#endif /* !CLOCKWORK_SORT_H */
@@ -3,203 +3,546 @@
 #include "parser.h"
 
 #include "debug.h"
+#include "memory.h"
 #include "runtime.h"
+#include "vectorize.h"
+#include "record.h"
+
+#include <string.h>
 
 /* --------------------------| declarations |-------------------------------------------- */
-static void cw_parse_decl_var(cwRuntime* cw, bool mut)
+static void cw_parse_decl_var(cwCompiler* c, bool mut)
 {
     /* parse variable name */
-    cw_consume(cw, TOKEN_IDENTIFIER, "Expect variable name.");
+    cw_consume(c, TOKEN_IDENTIFIER, "Expect variable name.");
 
     /* declare variable */
-    if (cw->scope_depth > 0)
+    if (c->scope_depth > 0) cw_declare_local(c, &c->parser->previous);
+
+    uint8_t id = (c->scope_depth <= 0) ? cw_identifier_constant(c, &c->parser->previous) : 0;
+
+    /* parse variable initialization value */
+    if (cw_match(c, TOKEN_ASSIGN)) cw_parse_expression(c);
+    else                           cw_syntax_error_at(c->parser, &c->parser->previous, "Undefined variable.");
+
+    /* define variable */
+    cw_consume(c, TOKEN_SEMICOLON, "Expect terminator after var declaration.");
+    if (c->scope_depth > 0)
+        cw_mark_initialized(c);
+    else
+        cw_emit_bytes(c->chunk, OP_DEF_GLOBAL, id, c->parser->previous.line);
+}
+
+/*
+ * Function bodies are not compiled with the declaration. The parameters are
+ * parsed for the arity and the body is only skimmed to find its closing
+ * brace. The source from the parameter list to the end of the body is kept
+ * in the function and compiled on the first call (see cw_compile_function).
+ */
+static cwFunction* cw_parse_function(cwCompiler* c, cwToken name)
+{
+    cwFunction* function = cw_function_new(c->engine);
+    function->name = cw_str_intern(c->engine, name.start, name.end - name.start);
+    function->line = c->parser->current.line;
+    const char* start = c->parser->current.start;
+
+    cw_consume(c, TOKEN_LPAREN, "Expect '(' after function name.");
+    if (c->parser->current.type != TOKEN_RPAREN)
     {
-        cwToken* name = &cw->previous;
-        for (int i = cw->local_count - 1; i >= 0; i--)
+        do
         {
-            cwLocal* local = &cw->locals[i];
-            if (local->depth != -1 && local->depth < cw->scope_depth) break;
+            if (++function->arity > UINT8_MAX)
+                cw_syntax_error_at(c->parser, &c->parser->current, "Can't have more than 255 parameters.");
+            cw_consume(c, TOKEN_IDENTIFIER, "Expect parameter name.");
+        } while (cw_match(c, TOKEN_COMMA));
+    }
+    cw_consume(c, TOKEN_RPAREN, "Expect ')' after parameters.");
+    cw_consume(c, TOKEN_LBRACE, "Expect '{' before function body.");
 
-            if (cw_identifiers_equal(name, &local->name))
-                cw_syntax_error_at(cw, &cw->previous, "Already a variable with this name in this scope.");
-        }
+    /* skim the body */
+    int depth = 1;
+    while (depth > 0 && c->parser->current.type != TOKEN_EOF)
+    {
+        cw_advance(c);
+        if (c->parser->previous.type == TOKEN_LBRACE) depth++;
+        if (c->parser->previous.type == TOKEN_RBRACE) depth--;
+    }
+    if (depth > 0) cw_syntax_error_at(c->parser, &c->parser->current, "Expect '}' after function body.");
 
-        cw_add_local(cw, name);
+    function->source_len = c->parser->previous.end - start;
+    function->source = CW_ALLOCATE(char, function->source_len + 1);
+    memcpy(function->source, start, function->source_len);
+    function->source[function->source_len] = '\0';
+    return function;
+}
+
+static void cw_parse_decl_func(cwCompiler* c)
+{
+    cw_consume(c, TOKEN_IDENTIFIER, "Expect function name.");
+    cwToken name = c->parser->previous;
+
+    /* functions are initialized right away so they can refer to themselves */
+    uint8_t id = 0;
+    if (c->scope_depth > 0)
+    {
+        cw_declare_local(c, &name);
+        cw_mark_initialized(c);
+    }
+    else
+    {
+        id = cw_identifier_constant(c, &name);
     }
-    
-    uint8_t id = (cw->scope_depth <= 0) ? cw_identifier_constant(cw, &cw->previous) : 0;
 
-    /* parse variable initialization value */
-    if (cw_match(cw, TOKEN_ASSIGN)) cw_parse_expression(cw);
-    else                            cw_syntax_error_at(cw, &cw->previous, "Undefined variable.");
+    cwFunction* function = cw_parse_function(c, name);
+    cw_emit_bytes(c->chunk, OP_CONSTANT, cw_make_constant(c, MAKE_OBJECT(function)), c->parser->previous.line);
+    if (c->scope_depth <= 0) cw_emit_bytes(c->chunk, OP_DEF_GLOBAL, id, c->parser->previous.line);
+}
 
-    /* define variable */
-    cw_consume(cw, TOKEN_SEMICOLON, "Expect terminator after var declaration.");
-    if (cw->scope_depth > 0)
-        cw->locals[cw->local_count - 1].depth = cw->scope_depth; /* mark initialized */
+/*
+ * datatype Point { x, y; function len(self) { ... } } creates the shape of
+ * the records once at compile time and binds it like a function, calling it
+ * creates a record. Methods follow the fields and take the record first.
+ */
+static void cw_parse_decl_datatype(cwCompiler* c)
+{
+    cw_consume(c, TOKEN_IDENTIFIER, "Expect datatype name.");
+    cwToken name = c->parser->previous;
+
+    uint8_t id = 0;
+    if (c->scope_depth > 0) cw_declare_local(c, &name);
+    else                    id = cw_identifier_constant(c, &name);
+
+    cwShape* shape = cw_shape_new(c->engine, cw_str_intern(c->engine, name.start, name.end - name.start));
+
+    cw_consume(c, TOKEN_LBRACE, "Expect '{' after datatype name.");
+    if (c->parser->current.type == TOKEN_IDENTIFIER)
+    {
+        do
+        {
+            cw_consume(c, TOKEN_IDENTIFIER, "Expect field name.");
+            cwToken* field = &c->parser->previous;
+            if (!cw_shape_add_field(shape, cw_str_intern(c->engine, field->start, field->end - field->start)))
+            {
+                if (shape->field_count == CW_RECORD_FIELDS_MAX)
+                    cw_syntax_error_at(c->parser, field, "Can't have more than 255 fields.");
+                else
+                    cw_syntax_error_at(c->parser, field, "Duplicate member name.");
+            }
+        } while (cw_match(c, TOKEN_COMMA));
+        cw_match(c, TOKEN_SEMICOLON);
+    }
+
+    while (cw_match(c, TOKEN_FUNC))
+    {
+        cw_consume(c, TOKEN_IDENTIFIER, "Expect method name.");
+        cwToken method = c->parser->previous;
+        cwFunction* function = cw_parse_function(c, method);
+        if (function->arity == 0)
+            cw_syntax_error_at(c->parser, &method, "Methods take the record as their first parameter.");
+        else if (shape->method_count == CW_SHAPE_METHODS_MAX)
+            cw_syntax_error_at(c->parser, &method, "Can't have more than 255 methods.");
+        else if (!cw_shape_add_method(shape, function->name, function))
+            cw_syntax_error_at(c->parser, &method, "Duplicate member name.");
+    }
+    cw_consume(c, TOKEN_RBRACE, "Expect '}' after datatype body.");
+
+    cw_emit_bytes(c->chunk, OP_CONSTANT, cw_make_constant(c, MAKE_OBJECT(shape)), c->parser->previous.line);
+    if (c->scope_depth > 0)
+        cw_mark_initialized(c);
     else
-        cw_emit_bytes(cw->chunk, OP_DEF_GLOBAL, id, cw->previous.line);
+        cw_emit_bytes(c->chunk, OP_DEF_GLOBAL, id, c->parser->previous.line);
 }
 
-int cw_parse_declaration(cwRuntime* cw)
+int cw_parse_declaration(cwCompiler* c)
 {
-    if (cw_match(cw, TOKEN_LET))    cw_parse_decl_var(cw, false);
-    if (cw_match(cw, TOKEN_MUT))    cw_parse_decl_var(cw, true);
-    else                            cw_parse_statement(cw); 
+    if (cw_match(c, TOKEN_FUNC))            cw_parse_decl_func(c);
+    else if (cw_match(c, TOKEN_LET))        cw_parse_decl_var(c, false);
+    else if (cw_match(c, TOKEN_MUT))        cw_parse_decl_var(c, true);
+    else if (cw_match(c, TOKEN_DATATYPE))   cw_parse_decl_datatype(c);
+    else                                    cw_parse_statement(c);
 
-    if (cw->panic) cw_parser_synchronize(cw);
+    if (c->parser->panic) cw_parser_synchronize(c);
 
     return 1;
 }
 
 /* --------------------------| statements |---------------------------------------------- */
-static inline void cw_begin_scope(cwRuntime* cw) { cw->scope_depth++; }
-static inline void cw_end_scope(cwRuntime* cw)
+static inline void cw_begin_scope(cwCompiler* c) { c->scope_depth++; }
+static inline void cw_end_scope(cwCompiler* c)
 { 
-    cw->scope_depth--;
+    c->scope_depth--;
 
     /* pop locals */
-    while (cw->local_count > 0 && cw->locals[cw->local_count - 1].depth > cw->scope_depth)
+    while (c->local_count > 0 && c->locals[c->local_count - 1].depth > c->scope_depth)
     {
-        cw_emit_byte(cw->chunk, OP_POP, cw->previous.line);
-        cw->local_count--;
+        cw_emit_byte(c->chunk, OP_POP, c->parser->previous.line);
+        c->local_count--;
     }
 }
 
-static int cw_parse_stmt_expr(cwRuntime* cw)
+static int cw_parse_stmt_expr(cwCompiler* c)
 {
-    cw_parse_expression(cw);
-    cw_consume(cw, TOKEN_SEMICOLON, "Expect terminator after expression.");
-    cw_emit_byte(cw->chunk, OP_POP, cw->previous.line);
+    cw_parse_expression(c);
+    cw_consume(c, TOKEN_SEMICOLON, "Expect terminator after expression.");
+    cw_emit_byte(c->chunk, OP_POP, c->parser->previous.line);
 }
 
-static int cw_parse_stmt_block(cwRuntime* cw)
+static int cw_parse_stmt_block(cwCompiler* c)
 {
-    cw_begin_scope(cw);
+    cw_begin_scope(c);
 
-    while (cw->current.type != TOKEN_RBRACE && cw->current.type != TOKEN_EOF)
-        cw_parse_declaration(cw);
+    while (c->parser->current.type != TOKEN_RBRACE && c->parser->current.type != TOKEN_EOF)
+        cw_parse_declaration(c);
 
-    cw_consume(cw, TOKEN_RBRACE, "Expect '}' after block.");
-    cw_end_scope(cw);
+    cw_consume(c, TOKEN_RBRACE, "Expect '}' after block.");
+    cw_end_scope(c);
 }
 
-static int cw_parse_stmt_if(cwRuntime* cw)
+static int cw_parse_stmt_if(cwCompiler* c)
 {
-    cw_consume(cw, TOKEN_LPAREN, "Expect '(' after 'if'.");
-    cw_parse_expression(cw);
-    cw_consume(cw, TOKEN_RPAREN, "Expect ')' after condition.");
+    cw_consume(c, TOKEN_LPAREN, "Expect '(' after 'if'.");
+    cw_parse_expression(c);
+    cw_consume(c, TOKEN_RPAREN, "Expect ')' after condition.");
 
-    int then_jump = cw_emit_jump(cw->chunk, OP_JUMP_IF_FALSE, cw->previous.line);
-    cw_emit_byte(cw->chunk, OP_POP, cw->previous.line);
-    cw_parse_statement(cw);
+    int then_jump = cw_emit_jump(c->chunk, OP_JUMP_IF_FALSE, c->parser->previous.line);
+    cw_emit_byte(c->chunk, OP_POP, c->parser->previous.line);
+    cw_parse_statement(c);
 
-    int else_jump = cw_emit_jump(cw->chunk, OP_JUMP, cw->previous.line);
+    int else_jump = cw_emit_jump(c->chunk, OP_JUMP, c->parser->previous.line);
 
-    cw_patch_jump(cw, then_jump);
-    cw_emit_byte(cw->chunk, OP_POP, cw->previous.line);
+    cw_patch_jump(c, then_jump);
+    cw_emit_byte(c->chunk, OP_POP, c->parser->previous.line);
 
-    if (cw_match(cw, TOKEN_ELSE)) cw_parse_statement(cw);
-    cw_patch_jump(cw, else_jump);
+    if (cw_match(c, TOKEN_ELSE)) cw_parse_statement(c);
+    cw_patch_jump(c, else_jump);
 
     return 1;
 }
 
-static int cw_parse_stmt_while(cwRuntime* cw)
+static int cw_parse_stmt_while(cwCompiler* c)
 {
-    int loop_start = cw->chunk->len;
+    int loop_start = c->chunk->len;
 
-    cw_consume(cw, TOKEN_LPAREN, "Expect '(' after 'while'.");
-    cw_parse_expression(cw);
-    cw_consume(cw, TOKEN_RPAREN, "Expect ')' after condition.");
+    cw_consume(c, TOKEN_LPAREN, "Expect '(' after 'while'.");
+    cw_parse_expression(c);
+    cw_consume(c, TOKEN_RPAREN, "Expect ')' after condition.");
 
-    int exit_jump = cw_emit_jump(cw->chunk, OP_JUMP_IF_FALSE, cw->previous.line);
-    cw_emit_byte(cw->chunk, OP_POP, cw->previous.line);
-    cw_parse_statement(cw);
-    cw_emit_loop(cw, loop_start);
+    int exit_jump = cw_emit_jump(c->chunk, OP_JUMP_IF_FALSE, c->parser->previous.line);
+    cw_emit_byte(c->chunk, OP_POP, c->parser->previous.line);
+    cw_parse_statement(c);
+    cw_emit_loop(c, loop_start);
 
-    cw_patch_jump(cw, exit_jump);
-    cw_emit_byte(cw->chunk, OP_POP, cw->previous.line);
+    cw_patch_jump(c, exit_jump);
+    cw_emit_byte(c->chunk, OP_POP, c->parser->previous.line);
+}
+
+/*
+ * for (key, value in iterable) statement
+ *
+ * Iterates over the entries of a map or the indices and elements of an
+ * array. The iterated value and the position are kept in hidden locals next
+ * to the loop variables, which OP_ITERATE updates in place, so the loop does
+ * not allocate anything per element.
+ */
+static bool cw_next_token_is(cwCompiler* c, cwTokenType type)
+{
+    cwParser scratch = *c->parser;
+    cwToken next;
+    cw_scan_token(&scratch, &next, c->parser->current.end, c->parser->current.line);
+    return next.type == type;
+}
+
+static int cw_parse_stmt_for_in(cwCompiler* c)
+{
+    cw_consume(c, TOKEN_IDENTIFIER, "Expect loop variable name.");
+    cwToken key = c->parser->previous;
+    cwToken value = { .start = "", .end = "" };
+    if (cw_match(c, TOKEN_COMMA))
+    {
+        cw_consume(c, TOKEN_IDENTIFIER, "Expect loop variable name.");
+        value = c->parser->previous;
+    }
+
+    cw_consume(c, TOKEN_IN, "Expect 'in' after loop variables.");
+    cw_parse_expression(c);
+    cw_consume(c, TOKEN_RPAREN, "Expect ')' after for clauses.");
+
+    /* iterable, position, key, value */
+    int line = c->parser->previous.line;
+    cwToken hidden = { .start = "", .end = "" };
+    uint8_t slot = (uint8_t)c->local_count;
+    cw_add_local(c, &hidden);
+    cw_mark_initialized(c);
+
+    cw_emit_bytes(c->chunk, OP_CONSTANT, cw_make_constant(c, MAKE_INT(0)), line);
+    cw_add_local(c, &hidden);
+    cw_mark_initialized(c);
+
+    cw_emit_byte(c->chunk, OP_NULL, line);
+    cw_add_local(c, &key);
+    cw_mark_initialized(c);
+
+    cw_emit_byte(c->chunk, OP_NULL, line);
+    cw_add_local(c, &value);
+    cw_mark_initialized(c);
+
+    /* OP_ITERATE slot exit */
+    int loop_start = c->chunk->len;
+    cw_emit_bytes(c->chunk, OP_ITERATE, slot, line);
+    cw_emit_bytes(c->chunk, 0xff, 0xff, line);
+    int exit_jump = c->chunk->len - 2;
+
+    cw_parse_statement(c);
+    cw_emit_loop(c, loop_start);
+    cw_patch_jump(c, exit_jump);
+
+    cw_end_scope(c);
+    return 1;
 }
 
 /* NOTE: maybe switch to "for x in ..." notation */
-static int cw_parse_stmt_for(cwRuntime* cw)
+static int cw_parse_stmt_for(cwCompiler* c)
 {
-    cw_begin_scope(cw);
-    cw_consume(cw, TOKEN_LPAREN, "Expect '(' after 'for'.");
+    cw_begin_scope(c);
+    cw_consume(c, TOKEN_LPAREN, "Expect '(' after 'for'.");
+
+    if (c->parser->current.type == TOKEN_IDENTIFIER && (cw_next_token_is(c, TOKEN_COMMA) || cw_next_token_is(c, TOKEN_IN)))
+        return cw_parse_stmt_for_in(c);
 
     /* initializer clause. */
-    if (cw_match(cw, TOKEN_SEMICOLON))  { } /* no initializer. */
-    else if (cw_match(cw, TOKEN_LET))   cw_parse_decl_var(cw, false);
-    else if (cw_match(cw, TOKEN_MUT))   cw_parse_decl_var(cw, true);
-    else                                cw_parse_stmt_expr(cw);
+    int locals = c->local_count;
+    if (cw_match(c, TOKEN_SEMICOLON))  { } /* no initializer. */
+    else if (cw_match(c, TOKEN_LET))   cw_parse_decl_var(c, false);
+    else if (cw_match(c, TOKEN_MUT))   cw_parse_decl_var(c, true);
+    else                               cw_parse_stmt_expr(c);
 
-    int loop_start = cw->chunk->len;
+    int loop_start = c->chunk->len;
+    cwLoopShape shape = { .counter = c->local_count == locals + 1 ? locals : -1, .start = loop_start };
 
     /* condition clause. */
     int exit_jump = -1;
-    if (!cw_match(cw, TOKEN_SEMICOLON))
+    if (!cw_match(c, TOKEN_SEMICOLON))
     {
-        cw_parse_expression(cw);
-        cw_consume(cw, TOKEN_SEMICOLON, "Expect ';' after loop condition.");
+        cw_parse_expression(c);
+        cw_consume(c, TOKEN_SEMICOLON, "Expect ';' after loop condition.");
+        shape.cond_end = c->chunk->len;
 
         /* jump out of the loop if the condition is false. */
-        exit_jump = cw_emit_jump(cw->chunk, OP_JUMP_IF_FALSE, cw->previous.line);
-        cw_emit_byte(cw->chunk, OP_POP, cw->previous.line); /* pop condition. */
+        exit_jump = cw_emit_jump(c->chunk, OP_JUMP_IF_FALSE, c->parser->previous.line);
+        cw_emit_byte(c->chunk, OP_POP, c->parser->previous.line); /* pop condition. */
     }
     
     /* increment clause. */
-    if (!cw_match(cw, TOKEN_RPAREN))
+    if (!cw_match(c, TOKEN_RPAREN))
     {
-        int body_jump = cw_emit_jump(cw->chunk, OP_JUMP, cw->previous.line);
-        int inc_start = cw->chunk->len;
-        cw_parse_expression(cw);
-        cw_emit_byte(cw->chunk, OP_POP, cw->previous.line);
-        cw_consume(cw, TOKEN_RPAREN, "Expect ')' after for clauses.");
-
-        cw_emit_loop(cw, loop_start);
+        int body_jump = cw_emit_jump(c->chunk, OP_JUMP, c->parser->previous.line);
+        int inc_start = c->chunk->len;
+        cw_parse_expression(c);
+        cw_emit_byte(c->chunk, OP_POP, c->parser->previous.line);
+        cw_consume(c, TOKEN_RPAREN, "Expect ')' after for clauses.");
+
+        shape.step_start = inc_start;
+        shape.step_end = c->chunk->len;
+        cw_emit_loop(c, loop_start);
         loop_start = inc_start;
-        cw_patch_jump(cw, body_jump);
+        cw_patch_jump(c, body_jump);
     }
 
-    cw_parse_statement(cw);
-    cw_emit_loop(cw, loop_start);
+    shape.body_start = c->chunk->len;
+    cw_parse_statement(c);
+    shape.body_end = c->chunk->len;
+    cw_emit_loop(c, loop_start);
 
     /* patch condition jump. */
     if (exit_jump > 0)
     {
-        cw_patch_jump(cw, exit_jump);
-        cw_emit_byte(cw->chunk, OP_POP, cw->previous.line); /* pop condition. */
+        cw_patch_jump(c, exit_jump);
+        cw_emit_byte(c->chunk, OP_POP, c->parser->previous.line); /* pop condition. */
     }
 
-    cw_end_scope(cw);
+    /* counting loops over arrays may run as a kernel */
+    if (shape.counter >= 0 && exit_jump > 0 && shape.step_end > 0) cw_vectorize(c, &shape);
+
+    cw_end_scope(c);
+}
+
+/*
+ * parallel for (i in a..b) reduce (+ sum, max hi) statement
+ *
+ * The body is compiled as a function of the index range of a block, which
+ * OP_PARALLEL runs for every block on the workers of the engine. The current
+ * values of the reduction variables are passed to the instruction and the
+ * combined values are assigned back to the variables afterwards.
+ */
+static bool cw_token_is(const cwToken* token, const char* name)
+{
+    size_t len = strlen(name);
+    return token->type == TOKEN_IDENTIFIER && (size_t)(token->end - token->start) == len && memcmp(token->start, name, len) == 0;
+}
+
+static bool cw_parse_reductions(cwCompiler* c, cwReductions* reductions)
+{
+    cw_consume(c, TOKEN_LPAREN, "Expect '(' after 'reduce'.");
+    do
+    {
+        cwToken op = c->parser->current;
+        cw_advance(c);
+
+        cwReduceOp reduce;
+        if (op.type == TOKEN_PLUS)          reduce = REDUCE_SUM;
+        else if (cw_token_is(&op, "min"))   reduce = REDUCE_MIN;
+        else if (cw_token_is(&op, "max"))   reduce = REDUCE_MAX;
+        else
+        {
+            cw_syntax_error_at(c->parser, &op, "Expect '+', 'min' or 'max' as reduction.");
+            return false;
+        }
+
+        cw_consume(c, TOKEN_IDENTIFIER, "Expect reduction variable name.");
+        if (reductions->count == CW_REDUCTIONS_MAX)
+        {
+            cw_syntax_error_at(c->parser, &c->parser->previous, "Too many reduction variables.");
+            return false;
+        }
+
+        for (int i = 0; i < reductions->count; ++i)
+        {
+            if (cw_identifiers_equal(&reductions->names[i], &c->parser->previous))
+            {
+                cw_syntax_error_at(c->parser, &c->parser->previous, "Already a reduction variable.");
+                return false;
+            }
+        }
+
+        reductions->names[reductions->count] = c->parser->previous;
+        reductions->ops[reductions->count] = reduce;
+        reductions->count++;
+    } while (cw_match(c, TOKEN_COMMA));
+    cw_consume(c, TOKEN_RPAREN, "Expect ')' after reductions.");
+    return true;
+}
+
+static int cw_parse_stmt_parallel(cwCompiler* c)
+{
+    cw_consume(c, TOKEN_FOR, "Expect 'for' after 'parallel'.");
+    cw_consume(c, TOKEN_LPAREN, "Expect '(' after 'for'.");
+    cw_consume(c, TOKEN_IDENTIFIER, "Expect loop variable name.");
+    cwToken index = c->parser->previous;
+
+    /* the range ends up on the stack */
+    cw_consume(c, TOKEN_IN, "Expect 'in' after loop variable.");
+    cw_parse_expression(c);
+    cw_consume(c, TOKEN_RANGE, "Expect '..' in range.");
+    cw_parse_expression(c);
+    cw_consume(c, TOKEN_RPAREN, "Expect ')' after range.");
+
+    cwReductions reductions = { .count = 0 };
+    if (cw_match(c, TOKEN_REDUCE) && !cw_parse_reductions(c, &reductions)) return 0;
+
+    for (int i = 0; i < reductions.count; ++i)
+        cw_emit_variable(c, &reductions.names[i], false);
+
+    /* body(index, end) runs the loop for the indices of one block */
+    cwCompiler body;
+    cwFunction* function = cw_function_new(c->engine);
+    function->name = cw_str_intern(c->engine, "parallel", 8);
+    function->arity = 2;
+    cw_compiler_nest(&body, c, function);
+    body.reductions = &reductions;
+
+    cwToken end = { .start = "", .end = "" };
+    cw_add_local(&body, &index);
+    cw_mark_initialized(&body);
+    cw_add_local(&body, &end);
+    cw_mark_initialized(&body);
+
+    int loop_start = body.chunk->len;
+    cw_emit_bytes(body.chunk, OP_GET_LOCAL, 1, c->parser->previous.line);
+    cw_emit_bytes(body.chunk, OP_GET_LOCAL, 2, c->parser->previous.line);
+    cw_emit_byte(body.chunk, OP_LT, c->parser->previous.line);
+    cwLoopShape shape = { .counter = 1, .start = loop_start, .cond_end = body.chunk->len };
+    int exit_jump = cw_emit_jump(body.chunk, OP_JUMP_IF_FALSE, c->parser->previous.line);
+    cw_emit_byte(body.chunk, OP_POP, c->parser->previous.line);
+
+    shape.body_start = body.chunk->len;
+    cw_parse_statement(&body);
+    shape.body_end = body.chunk->len;
+
+    shape.step_start = body.chunk->len;
+    cw_emit_bytes(body.chunk, OP_GET_LOCAL, 1, c->parser->previous.line);
+    cw_emit_bytes(body.chunk, OP_CONSTANT, cw_make_constant(&body, MAKE_INT(1)), c->parser->previous.line);
+    cw_emit_byte(body.chunk, OP_ADD, c->parser->previous.line);
+    cw_emit_bytes(body.chunk, OP_SET_LOCAL, 1, c->parser->previous.line);
+    cw_emit_byte(body.chunk, OP_POP, c->parser->previous.line);
+    shape.step_end = body.chunk->len;
+    cw_emit_loop(&body, loop_start);
+
+    cw_patch_jump(&body, exit_jump);
+    cw_emit_byte(body.chunk, OP_POP, c->parser->previous.line);
+    cw_vectorize(&body, &shape);
+    cw_compiler_end(&body);
+
+    /* OP_PARALLEL body count [name op]... */
+    int line = c->parser->previous.line;
+    cw_emit_bytes(c->chunk, OP_PARALLEL, cw_make_constant(c, MAKE_OBJECT(function)), line);
+    cw_emit_byte(c->chunk, (uint8_t)reductions.count, line);
+    for (int i = 0; i < reductions.count; ++i)
+        cw_emit_bytes(c->chunk, cw_identifier_constant(c, &reductions.names[i]), (uint8_t)reductions.ops[i], line);
+
+    /* the combined values replace the range and are assigned in reverse */
+    for (int i = reductions.count - 1; i >= 0; --i)
+    {
+        cw_emit_variable(c, &reductions.names[i], true);
+        cw_emit_byte(c->chunk, OP_POP, line);
+    }
+    return 1;
 }
 
 /* NOTE: make print build in function */
-static int cw_parse_stmt_print(cwRuntime* cw)
+static int cw_parse_stmt_print(cwCompiler* c)
 {
-    cw_parse_expression(cw);
-    cw_consume(cw, TOKEN_SEMICOLON, "Expect terminator after value.");
-    cw_emit_byte(cw->chunk, OP_PRINT, cw->previous.line);
+    cw_parse_expression(c);
+    cw_consume(c, TOKEN_SEMICOLON, "Expect terminator after value.");
+    cw_emit_byte(c->chunk, OP_PRINT, c->parser->previous.line);
+}
+
+static int cw_parse_stmt_return(cwCompiler* c)
+{
+    if (!c->function->name) cw_syntax_error_at(c->parser, &c->parser->previous, "Can't return from top-level code.");
+    if (c->reductions)      cw_syntax_error_at(c->parser, &c->parser->previous, "Can't return from a parallel loop.");
+
+    if (cw_match(c, TOKEN_SEMICOLON))
+    {
+        cw_emit_byte(c->chunk, OP_NULL, c->parser->previous.line);
+    }
+    else
+    {
+        cw_parse_expression(c);
+        cw_consume(c, TOKEN_SEMICOLON, "Expect terminator after return value.");
+    }
+    cw_emit_byte(c->chunk, OP_RETURN, c->parser->previous.line);
+    return 1;
 }
 
 /* NOTE: implement error handling in stmts */
 /* NOTE: break cw_match open */
-int cw_parse_statement(cwRuntime* cw)
+int cw_parse_statement(cwCompiler* c)
 {
-    if (cw_match(cw, TOKEN_SEMICOLON))  return 0;
-    if (cw_match(cw, TOKEN_IF))         return cw_parse_stmt_if(cw);
-    if (cw_match(cw, TOKEN_WHILE))      return cw_parse_stmt_while(cw);
-    if (cw_match(cw, TOKEN_FOR))        return cw_parse_stmt_for(cw);
-    if (cw_match(cw, TOKEN_PRINT))      return cw_parse_stmt_print(cw);
-    if (cw_match(cw, TOKEN_LBRACE))     return cw_parse_stmt_block(cw);
-
-    return cw_parse_stmt_expr(cw);
+    if (cw_match(c, TOKEN_SEMICOLON))  return 0;
+    if (cw_match(c, TOKEN_IF))         return cw_parse_stmt_if(c);
+    if (cw_match(c, TOKEN_WHILE))      return cw_parse_stmt_while(c);
+    if (cw_match(c, TOKEN_FOR))        return cw_parse_stmt_for(c);
+    if (cw_match(c, TOKEN_PARALLEL))   return cw_parse_stmt_parallel(c);
+    if (cw_match(c, TOKEN_PRINT))      return cw_parse_stmt_print(c);
+    if (cw_match(c, TOKEN_RETURN))     return cw_parse_stmt_return(c);
+    if (cw_match(c, TOKEN_LBRACE))     return cw_parse_stmt_block(c);
+
+    return cw_parse_stmt_expr(c);
 }
 
 /* --------------------------| expression |---------------------------------------------- */
-int cw_parse_expression(cwRuntime* cw)
+int cw_parse_expression(cwCompiler* c)
 {
-    cw_parse_precedence(cw, PREC_ASSIGNMENT);
+    cw_parse_precedence(c, PREC_ASSIGNMENT);
     return 1;
 }
\ No newline at end of file
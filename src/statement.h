@@ -3,8 +3,8 @@
 
 #include "common.h"
 
-int cw_parse_expression(cwRuntime* cw);
-int cw_parse_statement(cwRuntime* cw);
-int cw_parse_declaration(cwRuntime* cw);
+int cw_parse_expression(cwCompiler* c);
+int cw_parse_statement(cwCompiler* c);
+int cw_parse_declaration(cwCompiler* c);
 
 #endif /* !CLOCKWORK_STATEMENT_H */
\ No newline at end of file
@@ -19,6 +19,16 @@ void cw_table_free(Table* table)
     cw_table_init(table);
 }
 
+void cw_table_clear(Table* table)
+{
+    for (uint32_t i = 0; i < table->capacity; ++i)
+    {
+        table->entries[i].key = NULL;
+        table->entries[i].val = MAKE_NULL();
+    }
+    table->size = 0;
+}
+
 static uint32_t cw_find_entry(const TableEntry* entries, size_t cap, const cwString* key)
 {
     int32_t tombstone = -1;
@@ -32,7 +42,7 @@ static uint32_t cw_find_entry(const TableEntry* entries, size_t cap, const cwStr
             
             if (tombstone < 0) tombstone = index;
         }
-        else if (entries[index].key == key)
+        else if (cw_str_equal(entries[index].key, key))
         {
             return index;
         }
@@ -98,11 +108,17 @@ bool cw_table_remove(Table* table, cwString* key)
 }
 
 cwValue* cw_table_find(const Table* table, const cwString* key)
+{
+    TableEntry* entry = cw_table_find_entry(table, key);
+    return entry ? &entry->val : NULL;
+}
+
+TableEntry* cw_table_find_entry(const Table* table, const cwString* key)
 {
     if (table->size == 0) return NULL;
 
     uint32_t i = cw_find_entry(table->entries, table->capacity, key);
-    return table->entries[i].key ? &table->entries[i].val : NULL;
+    return table->entries[i].key ? &table->entries[i] : NULL;
 }
 
 bool cw_table_copy(Table* src, Table* dst)
@@ -18,10 +18,12 @@ typedef struct
 
 void cw_table_init(Table* table);
 void cw_table_free(Table* table);
+void cw_table_clear(Table* table); /* removes all entries but keeps the capacity */
 
 bool cw_table_insert(Table* table, cwString* key, cwValue val);
 bool cw_table_remove(Table* table, cwString* key);
 cwValue* cw_table_find(const Table* table, const cwString* key);
+TableEntry* cw_table_find_entry(const Table* table, const cwString* key);
 
 bool cw_table_copy(Table* src, Table* dst);
 cwString* cw_table_find_key(const Table* table, const char* str, size_t len, uint32_t hash);
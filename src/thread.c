@@ -0,0 +1,38 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "thread.h"
+
+#include <sched.h>
+#include <unistd.h>
+
+void cw_mutex_init(cwMutex* mutex)                 { pthread_mutex_init(mutex, NULL); }
+void cw_mutex_free(cwMutex* mutex)                 { pthread_mutex_destroy(mutex); }
+void cw_mutex_lock(cwMutex* mutex)                 { pthread_mutex_lock(mutex); }
+void cw_mutex_unlock(cwMutex* mutex)               { pthread_mutex_unlock(mutex); }
+
+void cw_cond_init(cwCond* cond)                    { pthread_cond_init(cond, NULL); }
+void cw_cond_free(cwCond* cond)                    { pthread_cond_destroy(cond); }
+void cw_cond_wait(cwCond* cond, cwMutex* mutex)    { pthread_cond_wait(cond, mutex); }
+void cw_cond_signal(cwCond* cond)                  { pthread_cond_signal(cond); }
+void cw_cond_broadcast(cwCond* cond)               { pthread_cond_broadcast(cond); }
+
+bool cw_thread_create(cwThread* thread, cwThreadFn fn, void* arg)
+{
+    return pthread_create(thread, NULL, fn, arg) == 0;
+}
+
+void cw_thread_join(cwThread thread)
+{
+    pthread_join(thread, NULL);
+}
+
+void cw_thread_yield(void)
+{
+    sched_yield();
+}
+
+int cw_thread_count(void)
+{
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return count > 0 ? (int)count : 1;
+}
@@ -0,0 +1,45 @@
+#ifndef CLOCKWORK_THREAD_H
+#define CLOCKWORK_THREAD_H
+
+#include <pthread.h>
+#include <stdbool.h>
+
+/* thin wrappers around the threading primitives of the platform */
+typedef pthread_mutex_t cwMutex;
+typedef pthread_cond_t  cwCond;
+typedef pthread_t       cwThread;
+
+typedef void* (*cwThreadFn)(void* arg);
+
+void cw_mutex_init(cwMutex* mutex);
+void cw_mutex_free(cwMutex* mutex);
+void cw_mutex_lock(cwMutex* mutex);
+void cw_mutex_unlock(cwMutex* mutex);
+
+void cw_cond_init(cwCond* cond);
+void cw_cond_free(cwCond* cond);
+void cw_cond_wait(cwCond* cond, cwMutex* mutex);
+void cw_cond_signal(cwCond* cond);
+void cw_cond_broadcast(cwCond* cond);
+
+bool cw_thread_create(cwThread* thread, cwThreadFn fn, void* arg);
+void cw_thread_join(cwThread thread);
+void cw_thread_yield(void);
+int  cw_thread_count(void); /* number of online processors */
+
+/* atomics for values shared between threads */
+#define CW_ATOMIC_LOAD(ptr)         __atomic_load_n((ptr), __ATOMIC_ACQUIRE)
+#define CW_ATOMIC_STORE(ptr, val)   __atomic_store_n((ptr), (val), __ATOMIC_RELEASE)
+#define CW_ATOMIC_ADD(ptr, val)     __atomic_add_fetch((ptr), (val), __ATOMIC_ACQ_REL)
+#define CW_ATOMIC_SUB(ptr, val)     __atomic_sub_fetch((ptr), (val), __ATOMIC_ACQ_REL)
+
+/* sequentially consistent and relaxed variants for lock-free algorithms */
+#define CW_ATOMIC_LOAD_SEQ(ptr)         __atomic_load_n((ptr), __ATOMIC_SEQ_CST)
+#define CW_ATOMIC_STORE_SEQ(ptr, val)   __atomic_store_n((ptr), (val), __ATOMIC_SEQ_CST)
+#define CW_ATOMIC_LOAD_RELAXED(ptr)     __atomic_load_n((ptr), __ATOMIC_RELAXED)
+#define CW_ATOMIC_STORE_RELAXED(ptr, v) __atomic_store_n((ptr), (v), __ATOMIC_RELAXED)
+#define CW_ATOMIC_CAS(ptr, expected, desired) \
+    __atomic_compare_exchange_n((ptr), (expected), (desired), false, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED)
+#define CW_ATOMIC_FENCE()               __atomic_thread_fence(__ATOMIC_SEQ_CST)
+
+#endif /* !CLOCKWORK_THREAD_H */
@@ -0,0 +1,405 @@
+#include "vectorize.h"
+
+#include <string.h>
+
+#include "array.h"
+#include "kernels.h"
+
+void cw_vector_decode(const uint8_t* operands, cwVectorLoop* loop)
+{
+    loop->kind = operands[0];
+    loop->counter = operands[1];
+    loop->flags = operands[2];
+    loop->bound = (cwVectorRef){ operands[3], operands[4] };
+    loop->callee = operands[5];
+    loop->target = (cwVectorRef){ operands[6], operands[7] };
+    loop->x = (cwVectorRef){ operands[8], operands[9] };
+    loop->y = (cwVectorRef){ operands[10], operands[11] };
+    loop->skip = (uint16_t)((operands[12] << 8) | operands[13]);
+}
+
+/* --------------------------| matching |------------------------------------------------ */
+typedef struct
+{
+    const cwChunk* chunk;
+    int pos;
+    int end;
+    int counter;
+} cwCursor;
+
+static bool cw_match_op(cwCursor* cur, uint8_t op)
+{
+    if (cur->pos >= cur->end || cur->chunk->bytes[cur->pos] != op) return false;
+    cur->pos++;
+    return true;
+}
+
+static bool cw_match_operand(cwCursor* cur, uint8_t op, uint8_t* operand)
+{
+    if (cur->pos + 1 >= cur->end || cur->chunk->bytes[cur->pos] != op) return false;
+    *operand = cur->chunk->bytes[cur->pos + 1];
+    cur->pos += 2;
+    return true;
+}
+
+static bool cw_match_counter(cwCursor* cur)
+{
+    uint8_t slot;
+    return cw_match_operand(cur, OP_GET_LOCAL, &slot) && slot == cur->counter;
+}
+
+/* a variable other than the counter */
+static bool cw_match_variable(cwCursor* cur, cwVectorRef* ref)
+{
+    if (cw_match_operand(cur, OP_GET_GLOBAL, &ref->index))
+    {
+        ref->type = VECTOR_REF_GLOBAL;
+        return true;
+    }
+
+    int pos = cur->pos;
+    if (cw_match_operand(cur, OP_GET_LOCAL, &ref->index) && ref->index != cur->counter)
+    {
+        ref->type = VECTOR_REF_LOCAL;
+        return true;
+    }
+    cur->pos = pos;
+    return false;
+}
+
+static bool cw_match_scalar(cwCursor* cur, cwVectorRef* ref)
+{
+    if (cw_match_operand(cur, OP_CONSTANT, &ref->index))
+    {
+        ref->type = VECTOR_REF_CONSTANT;
+        return IS_NUMBER(cur->chunk->constants[ref->index]);
+    }
+    return cw_match_variable(cur, ref);
+}
+
+/* array[counter], the cursor stays where it was if the element does not match */
+static bool cw_match_element(cwCursor* cur, cwVectorRef* array)
+{
+    int pos = cur->pos;
+    if (cw_match_variable(cur, array) && cw_match_counter(cur) && cw_match_op(cur, OP_INDEX_GET)) return true;
+
+    cur->pos = pos;
+    return false;
+}
+
+static bool cw_refs_equal(const cwChunk* chunk, cwVectorRef a, cwVectorRef b)
+{
+    if (a.type != b.type) return false;
+
+    /* names of globals are interned */
+    if (a.type == VECTOR_REF_GLOBAL) return AS_STRING(chunk->constants[a.index]) == AS_STRING(chunk->constants[b.index]);
+    return a.index == b.index;
+}
+
+/* counter < bound, counter <= bound */
+static bool cw_match_condition(cwCursor* cur, cwVectorLoop* loop)
+{
+    if (!cw_match_counter(cur)) return false;
+
+    int pos = cur->pos;
+    uint8_t argc;
+    if (cw_match_operand(cur, OP_GET_GLOBAL, &loop->callee) && cw_match_variable(cur, &loop->bound)
+        && cw_match_operand(cur, OP_CALL, &argc) && argc == 1)
+    {
+        cwString* callee = AS_STRING(cur->chunk->constants[loop->callee]);
+        if (callee->len != 3 || memcmp(callee->raw, "len", 3) != 0) return false;
+        loop->flags |= VECTOR_LENGTH;
+    }
+    else
+    {
+        cur->pos = pos;
+        if (!cw_match_scalar(cur, &loop->bound)) return false;
+    }
+
+    if (cw_match_op(cur, OP_LTEQ))   loop->flags |= VECTOR_INCLUSIVE;
+    else if (!cw_match_op(cur, OP_LT)) return false;
+
+    return cur->pos == cur->end;
+}
+
+/* counter = counter + 1 */
+static bool cw_match_step(cwCursor* cur)
+{
+    uint8_t one, slot;
+    return cw_match_counter(cur)
+        && cw_match_operand(cur, OP_CONSTANT, &one)
+        && IS_INT(cur->chunk->constants[one]) && AS_INT(cur->chunk->constants[one]) == 1
+        && cw_match_op(cur, OP_ADD)
+        && cw_match_operand(cur, OP_SET_LOCAL, &slot) && slot == cur->counter
+        && cw_match_op(cur, OP_POP)
+        && cur->pos == cur->end;
+}
+
+/* s = s + a[i], s = s + a[i] * b[i] */
+static bool cw_match_reduction(cwCursor* cur, cwVectorLoop* loop)
+{
+    cwVectorRef target;
+    if (!cw_match_variable(cur, &loop->target) || !cw_match_element(cur, &loop->x)) return false;
+
+    loop->kind = VECTOR_SUM;
+    if (cw_match_element(cur, &loop->y))
+    {
+        if (!cw_match_op(cur, OP_MULTIPLY)) return false;
+        loop->kind = VECTOR_DOT;
+    }
+
+    if (!cw_match_op(cur, OP_ADD)) return false;
+
+    uint8_t op = loop->target.type == VECTOR_REF_GLOBAL ? OP_SET_GLOBAL : OP_SET_LOCAL;
+    target.type = loop->target.type;
+    return cw_match_operand(cur, op, &target.index) && cw_refs_equal(cur->chunk, loop->target, target)
+        && cw_match_op(cur, OP_POP) && cur->pos == cur->end;
+}
+
+/* c[i] = a[i] + b[i], c[i] = a[i] * b[i], c[i] = a[i] * k, c[i] = k * a[i], c[i] = k */
+static bool cw_match_store(cwCursor* cur, cwVectorLoop* loop)
+{
+    if (!cw_match_variable(cur, &loop->target) || !cw_match_counter(cur)) return false;
+
+    if (cw_match_element(cur, &loop->x))
+    {
+        if (cw_match_element(cur, &loop->y))
+        {
+            if (cw_match_op(cur, OP_ADD))           loop->kind = VECTOR_ADD;
+            else if (cw_match_op(cur, OP_MULTIPLY)) loop->kind = VECTOR_MUL;
+            else return false;
+        }
+        else if (cw_match_scalar(cur, &loop->y) && cw_match_op(cur, OP_MULTIPLY)) loop->kind = VECTOR_SCALE;
+        else return false;
+    }
+    else if (cw_match_scalar(cur, &loop->y))
+    {
+        loop->kind = VECTOR_FILL;
+        if (cw_match_element(cur, &loop->x))
+        {
+            if (!cw_match_op(cur, OP_MULTIPLY)) return false;
+            loop->kind = VECTOR_SCALE;
+        }
+    }
+    else
+    {
+        return false;
+    }
+
+    return cw_match_op(cur, OP_INDEX_SET) && cw_match_op(cur, OP_POP) && cur->pos == cur->end;
+}
+
+static bool cw_match_loop(const cwChunk* chunk, const cwLoopShape* shape, cwVectorLoop* loop)
+{
+    *loop = (cwVectorLoop){ .counter = (uint8_t)shape->counter };
+
+    cwCursor cond = { chunk, shape->start, shape->cond_end, shape->counter };
+    cwCursor step = { chunk, shape->step_start, shape->step_end, shape->counter };
+    if (!cw_match_condition(&cond, loop) || !cw_match_step(&step)) return false;
+
+    cwVectorLoop bounds = *loop;
+    cwCursor body = { chunk, shape->body_start, shape->body_end, shape->counter };
+    if (cw_match_reduction(&body, loop)) return true;
+
+    *loop = bounds;
+    body.pos = shape->body_start;
+    return cw_match_store(&body, loop);
+}
+
+void cw_vectorize(cwCompiler* c, const cwLoopShape* shape)
+{
+    cwChunk* chunk = c->chunk;
+    cwVectorLoop loop;
+    if (c->parser->error || !cw_match_loop(chunk, shape, &loop)) return;
+
+    int skip = chunk->len - shape->start;
+    if (skip > UINT16_MAX) return;
+
+    uint8_t guard[1 + CW_VECTOR_OPERANDS] = {
+        OP_VECTORIZE, loop.kind, loop.counter, loop.flags,
+        loop.bound.type, loop.bound.index, loop.callee,
+        loop.target.type, loop.target.index,
+        loop.x.type, loop.x.index,
+        loop.y.type, loop.y.index,
+        (skip >> 8) & 0xff, skip & 0xff
+    };
+
+    /* the loop only jumps within itself, so it can be moved behind the guard as it is */
+    int line = chunk->lines[shape->start];
+    int len = chunk->len - shape->start;
+    for (size_t i = 0; i < sizeof(guard); ++i) cw_emit_byte(chunk, 0, line);
+
+    memmove(chunk->bytes + shape->start + sizeof(guard), chunk->bytes + shape->start, len);
+    memmove(chunk->lines + shape->start + sizeof(guard), chunk->lines + shape->start, len * sizeof(int));
+    for (size_t i = 0; i < sizeof(guard); ++i)
+    {
+        chunk->bytes[shape->start + i] = guard[i];
+        chunk->lines[shape->start + i] = line;
+    }
+}
+
+/* --------------------------| execution |----------------------------------------------- */
+static bool cw_vector_read(cwRuntime* cw, const cwChunk* chunk, cwValue* slots, cwVectorRef ref, cwValue* value)
+{
+    switch (ref.type)
+    {
+    case VECTOR_REF_CONSTANT: *value = chunk->constants[ref.index]; return true;
+    case VECTOR_REF_LOCAL:    *value = slots[ref.index]; return true;
+    case VECTOR_REF_GLOBAL:
+    {
+        cwValue* global = cw_find_global(cw, AS_STRING(chunk->constants[ref.index]));
+        if (global) *value = *global;
+        return global != NULL;
+    }
+    }
+    return false;
+}
+
+/* an array of a type whose kernels compute exactly what the loop would, covering the range */
+static cwArray* cw_vector_array(cwRuntime* cw, const cwChunk* chunk, cwValue* slots, cwVectorRef ref, int64_t end)
+{
+    cwValue value;
+    if (!cw_vector_read(cw, chunk, slots, ref, &value) || !IS_ARRAY(value)) return NULL;
+
+    /* float64 elements are read as float, which the kernels do not */
+    cwArray* array = AS_ARRAY(value);
+    if (array->type == ARRAY_FLOAT64 || end > array->len) return NULL;
+    return array;
+}
+
+static void* cw_vector_data(cwArray* array, int64_t start)
+{
+    return (char*)array->data + (size_t)start * cw_array_element_size(array->type);
+}
+
+static bool cw_vector_bounds(cwRuntime* cw, const cwChunk* chunk, cwValue* slots, const cwVectorLoop* loop, int64_t* start, int64_t* end)
+{
+    cwValue counter = slots[loop->counter];
+    cwValue bound;
+    if (!IS_INT(counter) || !cw_vector_read(cw, chunk, slots, loop->bound, &bound)) return false;
+
+    if (loop->flags & VECTOR_LENGTH)
+    {
+        /* len must not be shadowed by a global */
+        cwString* name = AS_STRING(chunk->constants[loop->callee]);
+        cwValue* callee = cw_find_global(cw, name);
+        cwValue* builtin = cw_table_find(&cw->engine->builtins, name);
+        if (!callee || !builtin || callee != builtin || !IS_ARRAY(bound)) return false;
+
+        bound = MAKE_INT((int32_t)AS_ARRAY(bound)->len);
+    }
+
+    if (!IS_INT(bound)) return false;
+
+    *start = AS_INT(counter);
+    *end = (int64_t)AS_INT(bound) + ((loop->flags & VECTOR_INCLUSIVE) ? 1 : 0);
+
+    /* empty loops are left to the bytecode */
+    return *start >= 0 && *start < *end;
+}
+
+static bool cw_vector_reduce(cwRuntime* cw, const cwChunk* chunk, cwValue* slots, const cwVectorLoop* loop, int64_t start, int64_t end)
+{
+    cwValue acc;
+    cwArray* x = cw_vector_array(cw, chunk, slots, loop->x, end);
+    if (!x || !cw_vector_read(cw, chunk, slots, loop->target, &acc) || !IS_NUMBER(acc)) return false;
+
+    /* integer sums wrap like the loop, but only as long as the accumulator is an int */
+    if (x->type == ARRAY_INT32 && !IS_INT(acc)) return false;
+
+    const cwKernels* kernels = cw_kernels(x->type);
+    size_t n = (size_t)(end - start);
+    cwValue result;
+    if (loop->kind == VECTOR_DOT)
+    {
+        cwArray* y = cw_vector_array(cw, chunk, slots, loop->y, end);
+        if (!y || y->type != x->type) return false;
+
+        result = kernels->dot(cw_vector_data(x, start), cw_vector_data(y, start), n);
+    }
+    else
+    {
+        result = kernels->sum(cw_vector_data(x, start), n);
+    }
+
+    cw_value_add(&acc, &result);
+    if (loop->target.type == VECTOR_REF_LOCAL) slots[loop->target.index] = acc;
+    else cw_set_global(cw, AS_STRING(chunk->constants[loop->target.index]), acc);
+    return true;
+}
+
+static bool cw_vector_store(cwRuntime* cw, const cwChunk* chunk, cwValue* slots, const cwVectorLoop* loop, int64_t start, int64_t end)
+{
+    cwArray* target = cw_vector_array(cw, chunk, slots, loop->target, end);
+    if (!target || !cw_is_element_writable(cw, MAKE_OBJECT(target))) return false;
+
+    const cwKernels* kernels = cw_kernels(target->type);
+    size_t n = (size_t)(end - start);
+    size_t size = n * cw_array_element_size(target->type);
+    void* dst = cw_vector_data(target, start);
+
+    cwArray* x = NULL;
+    cwArray* y = NULL;
+    cwValue k;
+    if (loop->kind == VECTOR_ADD || loop->kind == VECTOR_MUL)
+    {
+        x = cw_vector_array(cw, chunk, slots, loop->x, end);
+        y = cw_vector_array(cw, chunk, slots, loop->y, end);
+        if (!x || !y || x->type != target->type || y->type != target->type) return false;
+    }
+    else
+    {
+        if (!cw_vector_read(cw, chunk, slots, loop->y, &k) || !IS_NUMBER(k)) return false;
+        if (loop->kind == VECTOR_SCALE)
+        {
+            x = cw_vector_array(cw, chunk, slots, loop->x, end);
+            if (!x || x->type != target->type) return false;
+
+            /* an int array scaled by a float is converted per element by the loop */
+            if (target->type == ARRAY_INT32 && !IS_INT(k)) return false;
+        }
+    }
+
+    /*
+     * Arrays never share their elements, so operands alias only if they are
+     * the same array. Kernels work in place on the target, so an operand that
+     * is not the target is copied into it first; add and mul commute.
+     */
+    if (loop->kind == VECTOR_ADD || loop->kind == VECTOR_MUL)
+    {
+        if (y == target && x != target)
+        {
+            cwArray* swap = x;
+            x = y;
+            y = swap;
+        }
+        if (x != target) memcpy(dst, cw_vector_data(x, start), size);
+
+        if (loop->kind == VECTOR_ADD) kernels->add(dst, cw_vector_data(y, start), n);
+        else                          kernels->mul(dst, cw_vector_data(y, start), n);
+    }
+    else if (loop->kind == VECTOR_SCALE)
+    {
+        if (x != target) memcpy(dst, cw_vector_data(x, start), size);
+        kernels->scale(dst, k, n);
+    }
+    else
+    {
+        kernels->fill(dst, k, n);
+    }
+    return true;
+}
+
+bool cw_vector_loop(cwRuntime* cw, const cwChunk* chunk, cwValue* slots, const cwVectorLoop* loop)
+{
+    int64_t start, end;
+    if (!cw_vector_bounds(cw, chunk, slots, loop, &start, &end)) return false;
+
+    bool done = loop->kind == VECTOR_SUM || loop->kind == VECTOR_DOT
+        ? cw_vector_reduce(cw, chunk, slots, loop, start, end)
+        : cw_vector_store(cw, chunk, slots, loop, start, end);
+
+    /* the counter ends where the loop would have left it */
+    if (done) slots[loop->counter] = MAKE_INT((int32_t)end);
+    return done;
+}
@@ -0,0 +1,83 @@
+#ifndef CLOCKWORK_VECTORIZE_H
+#define CLOCKWORK_VECTORIZE_H
+
+#include "runtime.h"
+
+/* loops that can run as one kernel, for a counter i over the range */
+typedef enum
+{
+    VECTOR_SUM,     /* s = s + a[i] */
+    VECTOR_DOT,     /* s = s + a[i] * b[i] */
+    VECTOR_ADD,     /* c[i] = a[i] + b[i] */
+    VECTOR_MUL,     /* c[i] = a[i] * b[i] */
+    VECTOR_SCALE,   /* c[i] = a[i] * k */
+    VECTOR_FILL     /* c[i] = k */
+} cwVectorKind;
+
+/* operands refer to a constant, a local slot or a global by the constant of its name */
+typedef enum
+{
+    VECTOR_REF_NONE,
+    VECTOR_REF_CONSTANT,
+    VECTOR_REF_LOCAL,
+    VECTOR_REF_GLOBAL
+} cwVectorRefType;
+
+typedef struct
+{
+    uint8_t type;
+    uint8_t index;
+} cwVectorRef;
+
+#define VECTOR_INCLUSIVE 0x01 /* i <= bound instead of i < bound */
+#define VECTOR_LENGTH    0x02 /* the bound is len(bound), called through the global in callee */
+
+/* OP_VECTORIZE kind counter flags bound callee target x y skip */
+#define CW_VECTOR_OPERANDS 14
+
+typedef struct
+{
+    uint8_t kind;
+    uint8_t counter;    /* slot of the loop variable */
+    uint8_t flags;
+    cwVectorRef bound;
+    uint8_t callee;
+    cwVectorRef target; /* accumulator or destination array */
+    cwVectorRef x;
+    cwVectorRef y;      /* second array or scalar operand */
+    uint16_t skip;      /* bytes from the end of the instruction to the end of the loop */
+} cwVectorLoop;
+
+void cw_vector_decode(const uint8_t* operands, cwVectorLoop* loop);
+
+/* byte ranges of a compiled counting loop, see cw_vectorize */
+typedef struct
+{
+    int counter;    /* slot of the loop variable */
+    int start;      /* condition, which the loop jumps back to */
+    int cond_end;   /* jump out of the loop */
+    int step_start; /* increment of the counter including the pop */
+    int step_end;
+    int body_start;
+    int body_end;
+} cwLoopShape;
+
+/*
+ * Looks for a loop that is compiled up to the end of the chunk and consists
+ * of nothing but one of the shapes of cwVectorKind, for a counter that goes
+ * up by one while it is less than a constant, a variable or the length of an
+ * array. Such loops get an OP_VECTORIZE in front, which runs the whole loop
+ * with a kernel from kernels.h and skips it. Whether that is possible is
+ * only known at runtime, so the instruction checks the types, the bounds and
+ * the arrays first and otherwise falls through to the loop as it is.
+ */
+void cw_vectorize(cwCompiler* c, const cwLoopShape* loop);
+
+/*
+ * Runs the loop of an OP_VECTORIZE in the frame with the given slots and
+ * returns true, or false without any effect if the loop has to run as
+ * bytecode. Float reductions add in a different order than the loop.
+ */
+bool cw_vector_loop(cwRuntime* cw, const cwChunk* chunk, cwValue* slots, const cwVectorLoop* loop);
+
+#endif /* !CLOCKWORK_VECTORIZE_H */
@@ -0,0 +1,115 @@
+#include "compiler.h"
+#include "runtime.h"
+#include "snapshot.h"
+
+#include <stdio.h>
+#include <string.h>
+
+/*
+ * cwc compiles clockwork scripts into chunk images and writes them as C
+ * arrays, so they can be linked into an executable (see embedded.h).
+ *
+ * Usage: cwc <output.c> [scripts...]
+ */
+
+static void write_name(FILE* out, const char* path)
+{
+    const char* start = strrchr(path, '/');
+    start = start ? start + 1 : path;
+
+    const char* end = strrchr(start, '.');
+    if (!end) end = start + strlen(start);
+
+    fprintf(out, "\"%.*s\"", (int)(end - start), start);
+}
+
+static bool write_script(FILE* out, cwEngine* engine, const char* path, int index)
+{
+    cwBuffer source;
+    cw_buffer_init(&source);
+
+    if (!cw_read_file(path, &source))
+    {
+        fprintf(stderr, "Could not read file \"%s\".\n", path);
+        cw_buffer_free(&source);
+        return false;
+    }
+
+    /* terminate the source for the scanner */
+    char* src = malloc(source.len + 1);
+    memcpy(src, source.bytes, source.len);
+    src[source.len] = '\0';
+    cw_buffer_free(&source);
+
+    cwBuffer image;
+    cw_buffer_init(&image);
+
+    /* bodies are compiled lazily, the image has to hold all of them */
+    cwFunction* function = cw_compile(engine, src);
+    bool result = function && cw_compile_all(engine, function) && cw_image_write(function, &image);
+    if (result)
+    {
+        fprintf(out, "/* %s */\n", path);
+        fprintf(out, "static const uint8_t cw_embedded_%d[] = {", index);
+        for (size_t i = 0; i < image.len; ++i)
+        {
+            if (i % 16 == 0) fprintf(out, "\n    ");
+            fprintf(out, "0x%02x,", image.bytes[i]);
+        }
+        fprintf(out, "\n};\n\n");
+    }
+    else
+    {
+        fprintf(stderr, "Could not compile \"%s\".\n", path);
+    }
+
+    cw_buffer_free(&image);
+    free(src);
+    return result;
+}
+
+int main(int argc, const char* argv[])
+{
+    if (argc < 2)
+    {
+        fprintf(stderr, "Usage: cwc <output.c> [scripts...]\n");
+        return 1;
+    }
+
+    FILE* out = fopen(argv[1], "w");
+    if (!out)
+    {
+        fprintf(stderr, "Could not open file \"%s\".\n", argv[1]);
+        return 1;
+    }
+
+    /* compiling needs no runtime, only an engine to own the literals */
+    cwEngine engine;
+    cw_engine_init(&engine, NULL);
+
+    fprintf(out, "/* generated by cwc, do not edit */\n");
+    fprintf(out, "#include \"embedded.h\"\n\n");
+
+    int status = 0;
+    for (int i = 2; i < argc && status == 0; ++i)
+    {
+        if (!write_script(out, &engine, argv[i], i - 2)) status = 1;
+    }
+
+    /* the sentinel keeps the array non-empty when nothing is embedded */
+    fprintf(out, "const cwEmbedded cw_embedded[] = {\n");
+    for (int i = 2; i < argc; ++i)
+    {
+        fprintf(out, "    { ");
+        write_name(out, argv[i]);
+        fprintf(out, ", cw_embedded_%d, sizeof(cw_embedded_%d) },\n", i - 2, i - 2);
+    }
+    fprintf(out, "    { NULL, NULL, 0 }\n};\n\n");
+    fprintf(out, "const size_t cw_embedded_count = %d;\n", argc - 2);
+
+    fclose(out);
+    cw_engine_free(&engine);
+
+    if (status != 0) remove(argv[1]);
+    return status;
+}
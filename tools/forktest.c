@@ -0,0 +1,113 @@
+#include "array.h"
+#include "map.h"
+#include "runtime.h"
+
+#include <stdio.h>
+#include <string.h>
+
+/*
+ * forktest runs scripts in forks of a template and checks that the forks
+ * can't modify the maps and arrays of the template (see cw_check_write).
+ *
+ * Usage: forktest
+ */
+
+static const char* setup =
+    "let cfg = {\"n\": 1};"
+    "let arr = float32(3);"
+    "arr[0] = 1;";
+
+/* every script writes to a container of the template */
+static const char* writes[] = {
+    "cfg[\"n\"] = 41;",
+    "cfg[\"s\"] = json_stringify(1);",
+    "let k = \"n\"; cfg[k] = 41;",
+    "remove(cfg, \"n\");",
+    "arr[0] = 99;",
+    "push(arr, 99);",
+    "fill(arr, 99);",
+};
+
+/* containers of the fork itself stay writable */
+static const char* locals =
+    "let m = {};"
+    "m[\"n\"] = cfg[\"n\"];"
+    "let a = float32(3);"
+    "a[0] = arr[0];"
+    "push(a, 2);";
+
+static cwValue* find_global(cwRuntime* cw, const char* name)
+{
+    return cw_find_global(cw, cw_str_copy(cw, name, strlen(name)));
+}
+
+static int check_template(cwRuntime* template)
+{
+    cwValue* cfg = find_global(template, "cfg");
+    cwValue* arr = find_global(template, "arr");
+    cwValue* n = cw_map_find(AS_MAP(*cfg), cw_str_copy(template, "n", 1), NULL);
+
+    int failures = 0;
+    if (!n || !IS_INT(*n) || AS_INT(*n) != 1)
+    {
+        fprintf(stderr, "FAIL: a fork changed cfg[\"n\"] of the template.\n");
+        ++failures;
+    }
+    if (cw_map_find(AS_MAP(*cfg), cw_str_copy(template, "s", 1), NULL))
+    {
+        fprintf(stderr, "FAIL: a fork added cfg[\"s\"] to the template.\n");
+        ++failures;
+    }
+    if (AS_ARRAY(*arr)->len != 3 || AS_FLOAT(cw_array_get(AS_ARRAY(*arr), 0)) != 1.0f)
+    {
+        fprintf(stderr, "FAIL: a fork changed arr of the template.\n");
+        ++failures;
+    }
+    return failures;
+}
+
+int main(void)
+{
+    cwEngine engine;
+    cw_engine_init(&engine, NULL);
+
+    cwRuntime template;
+    cw_init(&template, &engine);
+
+    int failures = 0;
+    if (cw_interpret(&template, setup) != INTERPRET_OK)
+    {
+        fprintf(stderr, "FAIL: could not set up the template.\n");
+        return 1;
+    }
+
+    int count = (int)(sizeof(writes) / sizeof(writes[0]));
+    for (int i = 0; i < count; ++i)
+    {
+        cwRuntime fork;
+        cw_fork(&fork, &template);
+        if (cw_interpret(&fork, writes[i]) != INTERPRET_RUNTIME_ERROR)
+        {
+            fprintf(stderr, "FAIL: the fork could run '%s'.\n", writes[i]);
+            ++failures;
+        }
+        cw_free(&fork);
+    }
+
+    cwRuntime fork;
+    cw_fork(&fork, &template);
+    if (cw_interpret(&fork, locals) != INTERPRET_OK)
+    {
+        fprintf(stderr, "FAIL: the fork could not modify its own containers.\n");
+        ++failures;
+    }
+    cw_free(&fork);
+
+    failures += check_template(&template);
+
+    cw_free(&template);
+    cw_engine_free(&engine);
+
+    if (failures == 0) printf("forktest: %d forks passed.\n", count + 1);
+    return failures ? 1 : 0;
+}